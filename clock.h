@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * @addtogroup syscalls
+ *
+ * POSIX clocks, implemented in time.c.
+ *
+ * @file clock.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_CLOCK_H_
+#define LIKE_POSIX_CLOCK_H_
+
+#include <time.h>
+#include <stdint.h>
+#include "system.h"
+
+#if USE_POSIX_STYLE_IO
+#include "likeposix_config.h"
+#endif
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * enable the cycle counter clock. clock_gettime(), gettimeofday() and time() then read a free
+ * running cycle counter, extended to 64 bits and calibrated against the hardware timer, rather
+ * than calling get_hw_time(). requires FreeRTOS software timers, and a cycle counter, that of
+ * ARMv7-M by default.
+ */
+#ifndef ENABLE_LIKEPOSIX_CYCLE_CLOCK
+#define ENABLE_LIKEPOSIX_CYCLE_CLOCK    0
+#endif
+/**
+ * the nominal cycle counter frequency in Hz, used until the counter has been calibrated.
+ */
+#ifndef CYCLE_CLOCK_HZ
+#define CYCLE_CLOCK_HZ                  configCPU_CLOCK_HZ
+#endif
+/**
+ * how often the clock is brought up to date from the hardware timer, in milliseconds.
+ * must be well within the counter's wrap period, 2^32 / CYCLE_CLOCK_HZ seconds.
+ */
+#ifndef CYCLE_CLOCK_UPDATE_PERIOD
+#define CYCLE_CLOCK_UPDATE_PERIOD       1000
+#endif
+/**
+ * the interval over which the counter frequency is measured against the hardware timer, in seconds.
+ */
+#ifndef CYCLE_CLOCK_CALIBRATION_PERIOD
+#define CYCLE_CLOCK_CALIBRATION_PERIOD  60
+#endif
+/**
+ * starts and reads the free running 32 bit cycle counter, the DWT cycle counter of ARMv7-M by default.
+ */
+#ifndef CYCLE_CLOCK_ENABLE
+#define CYCLE_CLOCK_ENABLE()            do {                                            \
+                                            *(volatile uint32_t*)0xE000EDFC |= 1 << 24; \
+                                            *(volatile uint32_t*)0xE0001000 |= 1;       \
+                                        } while(0)
+#endif
+#ifndef CYCLE_CLOCK_COUNTER
+#define CYCLE_CLOCK_COUNTER()           (*(volatile uint32_t*)0xE0001004)
+#endif
+
+/**
+ * enable times(), clock() and getrusage(), which report the CPU time of the calling task from the
+ * FreeRTOS run time stats. requires configGENERATE_RUN_TIME_STATS and configUSE_TRACE_FACILITY.
+ */
+#ifndef ENABLE_LIKEPOSIX_CPUTIME
+#define ENABLE_LIKEPOSIX_CPUTIME        0
+#endif
+/**
+ * the frequency of portGET_RUN_TIME_COUNTER_VALUE() in Hz, that of cputime_counter() by default.
+ */
+#ifndef CPUTIME_COUNTER_HZ
+#define CPUTIME_COUNTER_HZ              1000000
+#endif
+
+/**
+ * enable timer_create() and the other POSIX timer functions, and timerfd_create(), on FreeRTOS
+ * software timers. requires configUSE_TIMERS, INCLUDE_xTimerPendFunctionCall and
+ * INCLUDE_xTimerGetTimerDaemonTaskHandle. implemented in syscalls.c.
+ */
+#ifndef ENABLE_LIKEPOSIX_TIMERS
+#define ENABLE_LIKEPOSIX_TIMERS         0
+#endif
+
+/**
+ * clock ids, newlib only defines them for targets with POSIX timers.
+ */
+#ifndef CLOCK_REALTIME
+#define CLOCK_REALTIME                  ((clockid_t)1)
+#endif
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC                 ((clockid_t)4)
+#endif
+#ifndef TIMER_ABSTIME
+#define TIMER_ABSTIME                   4       ///< clock_nanosleep() flag, request is an absolute time
+#endif
+
+void clock_init();
+int clock_gettime(clockid_t clock_id, struct timespec* tp);
+int clock_getres(clockid_t clock_id, struct timespec* res);
+int nanosleep(const struct timespec* request, struct timespec* remain);
+int clock_nanosleep(clockid_t clock_id, int flags, const struct timespec* request, struct timespec* remain);
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+uint32_t cputime_counter();
+#endif
+
+struct sigevent;
+struct itimerspec;
+
+int timer_create(clockid_t clock_id, struct sigevent* event, timer_t* timerid);
+int timer_delete(timer_t timerid);
+int timer_settime(timer_t timerid, int flags, const struct itimerspec* value, struct itimerspec* ovalue);
+int timer_gettime(timer_t timerid, struct itimerspec* value);
+int timer_getoverrun(timer_t timerid);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_CLOCK_H_ */
+
+/**
+ * @}
+ */
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * Heap instrumentation.
+ *
+ * When ENABLE_LIKEPOSIX_HEAPTRACE is set, every allocation carries a small header
+ * recording its size, and the task and size bucket it was accounted to, so that it
+ * is credited back correctly when freed, whichever task frees it. Live bytes,
+ * allocation counts and peaks are kept for the whole heap, per task and per size
+ * bucket. With HEAPTRACE_EVENTS set, the most recent allocation events are kept in
+ * a ring buffer along with their caller addresses.
+ *
+ * heaptrace_dump() prints it all, for use from a shell command or a fault handler.
+ * When the option is not set, the hooks compile away to nothing.
+ *
+ * @file heaptrace.c
+ * @{
+ */
+
+#include <string.h>
+#include "syscalls.h"
+#include "heaptrace.h"
+#include "task.h"
+
+#if ENABLE_LIKEPOSIX_HEAPTRACE
+
+#define HEAPTRACE_OTHER         HEAPTRACE_TASKS
+
+#if HEAPTRACE_EVENTS
+/**
+ * allocation event, as held in the ring buffer.
+ */
+typedef struct {
+    void* ptr;              ///< the block
+    void* caller;           ///< the address of the call, see HEAPTRACE_WRAP
+    uint32_t size;          ///< the requested size, 0 for free
+    uint16_t task;          ///< the task slot of the calling task
+    char op;                ///< 'a' for allocate, 'f' for free, 'r' for resize
+} heaptrace_event_t;
+
+static heaptrace_event_t events[HEAPTRACE_EVENTS];
+static unsigned int event_next;
+static unsigned int event_count;
+#endif
+
+static heaptrace_stats_t stats;
+static TaskHandle_t tasks[HEAPTRACE_TASKS];
+
+/**
+ * weak hook, a heap scheme that can report its largest free block may define
+ * "size_t heap_largest_free_block()".
+ */
+extern size_t heap_largest_free_block() __attribute__((weak));
+
+static inline void __count_add(heaptrace_counter_t* counter, size_t size)
+{
+    counter->live += size;
+    counter->count++;
+    counter->total++;
+    if(counter->live > counter->peak)
+        counter->peak = counter->live;
+}
+
+static inline void __count_remove(heaptrace_counter_t* counter, size_t size)
+{
+    counter->live -= size;
+    counter->count--;
+}
+
+/**
+ * @retval  the slot of the calling task, assigning one on first use. called in a critical section.
+ */
+static uint16_t __task_slot()
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    uint16_t i;
+
+    if(!task)
+        return HEAPTRACE_OTHER;
+
+    for(i = 0; i < HEAPTRACE_TASKS; i++)
+    {
+        if(tasks[i] == task)
+            return i;
+        if(!tasks[i])
+        {
+            tasks[i] = task;
+            strncpy(stats.names[i], pcTaskGetTaskName(task), configMAX_TASK_NAME_LEN - 1);
+            return i;
+        }
+    }
+    return HEAPTRACE_OTHER;
+}
+
+static inline uint16_t __bucket(size_t size)
+{
+    uint16_t bucket = 0;
+    while(bucket < HEAPTRACE_BUCKETS - 1 && size > ((size_t)16 << bucket))
+        bucket++;
+    return bucket;
+}
+
+static inline void __event(char op, void* ptr, size_t size, uint16_t task, void* caller)
+{
+#if HEAPTRACE_EVENTS
+    heaptrace_event_t* event = &events[event_next];
+    event->op = op;
+    event->ptr = ptr;
+    event->size = size;
+    event->task = task;
+    event->caller = caller;
+    event_next = (event_next + 1) % HEAPTRACE_EVENTS;
+    if(event_count < HEAPTRACE_EVENTS)
+        event_count++;
+#else
+    (void)op;
+    (void)ptr;
+    (void)size;
+    (void)task;
+    (void)caller;
+#endif
+}
+
+/**
+ * accounts a new allocation.
+ *
+ * @param   raw is the block allocated, HEAPTRACE_HEADER_SIZE bytes larger than requested, may be NULL.
+ * @param   size is the requested size.
+ * @param   caller is the address the allocation was requested from.
+ * @retval  the pointer to return to the caller, or NULL if raw was NULL.
+ */
+void* heaptrace_alloc(void* raw, size_t size, void* caller)
+{
+    heaptrace_header_t* header = (heaptrace_header_t*)raw;
+    void* ptr;
+
+    if(!raw)
+        return NULL;
+
+    ptr = (unsigned char*)raw + HEAPTRACE_HEADER_SIZE;
+    header->size = size;
+    header->bucket = __bucket(size);
+
+    taskENTER_CRITICAL();
+    header->task = __task_slot();
+    __count_add(&stats.heap, size);
+    __count_add(&stats.tasks[header->task], size);
+    __count_add(&stats.buckets[header->bucket], size);
+    __event('a', ptr, size, header->task, caller);
+    taskEXIT_CRITICAL();
+
+    return ptr;
+}
+
+/**
+ * accounts a block being freed.
+ *
+ * @param   ptr is the pointer returned by heaptrace_alloc(), may be NULL.
+ * @param   caller is the address free() was called from.
+ * @retval  the block to free, or NULL if ptr was NULL.
+ */
+void* heaptrace_free(void* ptr, void* caller)
+{
+    heaptrace_header_t* header;
+
+    if(!ptr)
+        return NULL;
+
+    header = (heaptrace_header_t*)((unsigned char*)ptr - HEAPTRACE_HEADER_SIZE);
+
+    taskENTER_CRITICAL();
+    __count_remove(&stats.heap, header->size);
+    __count_remove(&stats.tasks[header->task], header->size);
+    __count_remove(&stats.buckets[header->bucket], header->size);
+    __event('f', ptr, 0, __task_slot(), caller);
+    taskEXIT_CRITICAL();
+
+    return header;
+}
+
+/**
+ * accounts a block that was resized in place. it stays with the task and bucket it was allocated in.
+ */
+void heaptrace_resize(void* ptr, size_t size, void* caller)
+{
+    heaptrace_header_t* header = (heaptrace_header_t*)((unsigned char*)ptr - HEAPTRACE_HEADER_SIZE);
+
+    taskENTER_CRITICAL();
+    stats.heap.live += size - header->size;
+    stats.tasks[header->task].live += size - header->size;
+    stats.buckets[header->bucket].live += size - header->size;
+    if(stats.heap.live > stats.heap.peak)
+        stats.heap.peak = stats.heap.live;
+    if(stats.tasks[header->task].live > stats.tasks[header->task].peak)
+        stats.tasks[header->task].peak = stats.tasks[header->task].live;
+    if(stats.buckets[header->bucket].live > stats.buckets[header->bucket].peak)
+        stats.buckets[header->bucket].peak = stats.buckets[header->bucket].live;
+    header->size = size;
+    __event('r', ptr, size, __task_slot(), caller);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * copies the heap usage counters.
+ */
+void heaptrace_stats(heaptrace_stats_t* s)
+{
+    taskENTER_CRITICAL();
+    *s = stats;
+    taskEXIT_CRITICAL();
+
+    strcpy(s->names[HEAPTRACE_OTHER], "other");
+    s->free = xPortGetFreeHeapSize();
+    s->largest = heap_largest_free_block ? heap_largest_free_block() : 0;
+}
+
+/**
+ * prints the heap usage counters, and the recent events if HEAPTRACE_EVENTS is set.
+ */
+void heaptrace_dump(FILE* stream)
+{
+    heaptrace_stats_t s;
+    int i;
+
+    heaptrace_stats(&s);
+
+    fprintf(stream, "heap: live %u peak %u count %u total %u free %u largest %u\n",
+            (unsigned int)s.heap.live, (unsigned int)s.heap.peak, s.heap.count, s.heap.total,
+            (unsigned int)s.free, (unsigned int)s.largest);
+
+    for(i = 0; i <= HEAPTRACE_TASKS; i++)
+    {
+        if(s.tasks[i].total)
+            fprintf(stream, "task %-*s live %u peak %u count %u total %u\n", configMAX_TASK_NAME_LEN, s.names[i],
+                    (unsigned int)s.tasks[i].live, (unsigned int)s.tasks[i].peak, s.tasks[i].count, s.tasks[i].total);
+    }
+
+    for(i = 0; i < HEAPTRACE_BUCKETS; i++)
+    {
+        if(s.buckets[i].total)
+            fprintf(stream, "size %s%-6u live %u peak %u count %u total %u\n", i == HEAPTRACE_BUCKETS - 1 ? ">" : "<=",
+                    i == HEAPTRACE_BUCKETS - 1 ? 16u << (i - 1) : 16u << i,
+                    (unsigned int)s.buckets[i].live, (unsigned int)s.buckets[i].peak, s.buckets[i].count, s.buckets[i].total);
+    }
+
+#if HEAPTRACE_EVENTS
+    {
+        heaptrace_event_t event;
+        unsigned int count;
+        unsigned int n;
+
+        taskENTER_CRITICAL();
+        count = event_count;
+        n = (event_next + HEAPTRACE_EVENTS - event_count) % HEAPTRACE_EVENTS;
+        taskEXIT_CRITICAL();
+
+        // oldest first, events logged while printing may overwrite some of these
+        for(; count > 0; count--, n = (n + 1) % HEAPTRACE_EVENTS)
+        {
+            taskENTER_CRITICAL();
+            event = events[n];
+            taskEXIT_CRITICAL();
+            fprintf(stream, "%c %p %6u task %-*s from %p\n", event.op, event.ptr, (unsigned int)event.size,
+                    configMAX_TASK_NAME_LEN, event.task == HEAPTRACE_OTHER ? "other" : s.names[event.task], event.caller);
+        }
+    }
+#endif
+}
+
+#endif
+
+/**
+ * @}
+ */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * @file heaptrace.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_HEAPTRACE_H_
+#define LIKE_POSIX_HEAPTRACE_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "likeposix_config.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * enable heap instrumentation in malloc(), calloc(), realloc() and free().
+ */
+#ifndef ENABLE_LIKEPOSIX_HEAPTRACE
+#define ENABLE_LIKEPOSIX_HEAPTRACE      0
+#endif
+/**
+ * the number of tasks accounted separately, allocations by further tasks,
+ * or made before the scheduler starts, are accounted to "other".
+ */
+#ifndef HEAPTRACE_TASKS
+#define HEAPTRACE_TASKS                 8
+#endif
+/**
+ * the number of size buckets, bucket n holds allocations of up to 16 << n bytes,
+ * the last bucket holds everything larger.
+ */
+#ifndef HEAPTRACE_BUCKETS
+#define HEAPTRACE_BUCKETS               8
+#endif
+/**
+ * the length of the ring buffer of recent allocation events, 0 disables event tracing.
+ */
+#ifndef HEAPTRACE_EVENTS
+#define HEAPTRACE_EVENTS                0
+#endif
+/**
+ * set when the application is linked with -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc.
+ * the calls then reach syscalls.c directly, and the trace records the address they were made from.
+ * otherwise they reach it through newlib, and the address recorded is inside newlib's malloc(),
+ * free(), calloc() or realloc(), the same for every call site.
+ */
+#ifndef HEAPTRACE_WRAP
+#define HEAPTRACE_WRAP                  0
+#endif
+
+#if ENABLE_LIKEPOSIX_HEAPTRACE
+
+#include "FreeRTOS.h"
+
+/**
+ * heap usage counters, for a task, a size bucket, or the whole heap.
+ */
+typedef struct {
+    size_t live;            ///< bytes currently allocated
+    size_t peak;            ///< the highest value live has reached
+    unsigned int count;     ///< the number of allocations currently live
+    unsigned int total;     ///< the number of allocations made
+} heaptrace_counter_t;
+
+/**
+ * heap usage snapshot.
+ */
+typedef struct {
+    heaptrace_counter_t heap;                       ///< the whole heap
+    heaptrace_counter_t tasks[HEAPTRACE_TASKS + 1]; ///< per task, the last is "other"
+    char names[HEAPTRACE_TASKS + 1][configMAX_TASK_NAME_LEN]; ///< the task names
+    heaptrace_counter_t buckets[HEAPTRACE_BUCKETS]; ///< per size bucket
+    size_t free;            ///< free heap, as reported by the heap scheme
+    size_t largest;         ///< the largest free block, if the heap scheme provides heap_largest_free_block(), or 0
+} heaptrace_stats_t;
+
+/**
+ * header placed ahead of every allocation while instrumentation is enabled.
+ */
+typedef struct {
+    uint32_t size;          ///< the requested size
+    uint16_t task;          ///< the task slot the allocation is accounted to
+    uint16_t bucket;        ///< the size bucket the allocation is accounted to
+} heaptrace_header_t;
+
+#define HEAPTRACE_HEADER_SIZE       ((sizeof(heaptrace_header_t) + (portBYTE_ALIGNMENT - 1)) & ~((size_t)portBYTE_ALIGNMENT - 1))
+
+void* heaptrace_alloc(void* raw, size_t size, void* caller);
+void* heaptrace_free(void* ptr, void* caller);
+void heaptrace_resize(void* ptr, size_t size, void* caller);
+void heaptrace_stats(heaptrace_stats_t* stats);
+void heaptrace_dump(FILE* stream);
+
+#else
+
+#define HEAPTRACE_HEADER_SIZE       0
+
+#define heaptrace_alloc(raw, size, caller)      (raw)
+#define heaptrace_free(ptr, caller)             (ptr)
+#define heaptrace_resize(ptr, size, caller)
+
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_HEAPTRACE_H_ */
+
+/**
+ * @}
+ */
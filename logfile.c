@@ -0,0 +1,695 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * @addtogroup syscalls
+ *
+ * Append-only log files.
+ *
+ * All descriptors opened on the same log file share one logfile_t. Each write is
+ * copied into the shared record buffer under the log lock, so records from
+ * different tasks never interleave or overwrite each other. Each log file has two
+ * record buffers. When the one being filled is full it is handed to the log task,
+ * which writes it to FatFs while writers carry on filling the other. Writers never
+ * wait for the card, a record that finds both buffers full fails with EAGAIN. Buffers
+ * are sized so that every full buffer written ends on a sector boundary.
+ *
+ * The log task also writes out partly filled buffers and syncs the file every
+ * LOGFILE_FLUSH_PERIOD milliseconds. When a log file grows past LOGFILE_ROTATE_SIZE
+ * bytes, or gets older than LOGFILE_ROTATE_AGE seconds, the log task rotates it to
+ * <name>.1 (and <name>.1 to <name>.2 etc). Writers keep using the same descriptors
+ * across a rotation. If the new file cannot be opened, it is retried on every flush,
+ * and buffered records wait for it.
+ *
+ * @file logfile.c
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "syscalls.h"
+#include "semphr.h"
+#include "task.h"
+#include "logfile.h"
+#include "cutensils.h"
+
+#undef errno
+extern int errno;
+
+#if ENABLE_LIKEPOSIX_LOGFILES
+
+/**
+ * log file definition, shared by all descriptors open on the same file.
+ *
+ * fill, limit and active belong to the holder of lock. pending, done and size are
+ * also changed by the log task, and are read and written in critical sections.
+ * the file belongs to the holder of file_lock.
+ */
+struct _logfile_t {
+    int refs;                               ///< the number of descriptors open on the log file, 0 means the slot is free
+    int used;                               ///< set while the slot holds a log file, changed with file_lock held
+    int open;                               ///< set while file is open, cleared when a rotation failed to open the new file
+    int dirty;                              ///< records have been written since the file was last synced
+    int failed;                             ///< an error has been reported, cleared on the next successful write
+    char name[LOGFILE_PATH_LENGTH];         ///< full path of the log file
+    FIL file;                               ///< the log file
+    time_t started;                         ///< time at which the current file was opened or rotated
+    unsigned int size;                      ///< the bytes in the current file, and in the pending buffer
+    unsigned int fill;                      ///< the number of bytes held in the active buffer
+    unsigned int limit;                     ///< fill level at which the active buffer is handed over, on a sector boundary
+    unsigned int pending;                   ///< the number of bytes in the other buffer, waiting to be written, 0 if none
+    unsigned int done;                      ///< the number of pending bytes already written
+    int active;                             ///< index of the buffer being filled
+    SemaphoreHandle_t lock;                 ///< serializes appends to the log file
+    SemaphoreHandle_t file_lock;            ///< serializes access to file
+#if ENABLE_LIKEPOSIX_STATIC
+    StaticSemaphore_t lock_buffer;          ///< storage for lock
+    StaticSemaphore_t file_lock_buffer;     ///< storage for file_lock
+#endif
+    unsigned char buffer[2][LOGFILE_BUFFER_SIZE];  ///< record buffers
+};
+
+static logfile_t logtab[LOGFILE_TABLE_LENGTH];
+static SemaphoreHandle_t logtab_lock;
+static TaskHandle_t logfile_handle;
+#if ENABLE_LIKEPOSIX_STATIC
+static StaticSemaphore_t logtab_lock_buffer;
+static StaticTask_t logfile_task_buffer;
+static StackType_t logfile_task_stack[LOGFILE_TASK_STACK];
+#endif
+
+#define LOGFILE_WAIT        (2000/portTICK_RATE_MS)
+
+#define lock_logtab()       (xSemaphoreTake(logtab_lock, LOGFILE_WAIT) == pdTRUE)
+#define unlock_logtab()     xSemaphoreGive(logtab_lock)
+#define lock_log(log)       (xSemaphoreTake(log->lock, LOGFILE_WAIT) == pdTRUE)
+#define unlock_log(log)     xSemaphoreGive(log->lock)
+#define lock_file(log)      (xSemaphoreTake(log->file_lock, LOGFILE_WAIT) == pdTRUE)
+#define unlock_file(log)    xSemaphoreGive(log->file_lock)
+
+/**
+ * reports an error once, until the next successful write.
+ */
+#define __logfile_error(log, what)  do {                                                            \
+                                        if(!log->failed)                                            \
+                                            log_error(NULL, "failed to " what " %s", log->name);    \
+                                        log->failed = 1;                                            \
+                                    } while(0)
+
+static void logfile_task(void* arg);
+
+/**
+ * initialises log file state and starts the log task, called by init_likeposix().
+ */
+void logfile_init()
+{
+    if(logtab_lock == NULL)
+    {
+#if ENABLE_LIKEPOSIX_STATIC
+        logtab_lock = xSemaphoreCreateMutexStatic(&logtab_lock_buffer);
+#else
+        logtab_lock = xSemaphoreCreateMutex();
+#endif
+        assert_true(logtab_lock);
+    }
+
+    if(logfile_handle == NULL)
+    {
+#if ENABLE_LIKEPOSIX_STATIC
+        logfile_handle = xTaskCreateStatic(logfile_task, "logfile", LOGFILE_TASK_STACK, NULL,
+                                           LOGFILE_TASK_PRIORITY, logfile_task_stack, &logfile_task_buffer);
+#else
+        xTaskCreate(logfile_task, "logfile", LOGFILE_TASK_STACK, NULL, LOGFILE_TASK_PRIORITY, &logfile_handle);
+#endif
+        assert_true(logfile_handle);
+    }
+}
+
+/**
+ * @retval  the fill level at which a buffer ends on a sector boundary, for a file of the given size.
+ */
+static inline unsigned int __logfile_limit(unsigned int size)
+{
+    return LOGFILE_BUFFER_SIZE - (size % LOGFILE_BUFFER_SIZE);
+}
+
+/**
+ * makes the active buffer pending, and starts filling the other one.
+ * called with the log lock held, never waits.
+ *
+ * @retval  0 on success, -1 if the other buffer is still pending.
+ */
+static int __logfile_swap(logfile_t* log)
+{
+    int swapped;
+
+    taskENTER_CRITICAL();
+    swapped = log->pending == 0;
+    if(swapped)
+    {
+        log->pending = log->fill;
+        log->done = 0;
+        log->size += log->fill;
+        log->active ^= 1;
+        log->limit = __logfile_limit(log->size);
+    }
+    taskEXIT_CRITICAL();
+
+    if(!swapped)
+        return EOF;
+
+    log->fill = 0;
+    return 0;
+}
+
+/**
+ * opens the log file again after a rotation failed to, called with the file lock held.
+ *
+ * @retval 0 on success, -1 on error.
+ */
+static int __logfile_reopen(logfile_t* log)
+{
+    if(f_open(&log->file, (const TCHAR*)log->name, FA_WRITE|FA_OPEN_ALWAYS) != FR_OK)
+        return EOF;
+
+    if(f_lseek(&log->file, f_size(&log->file)) != FR_OK)
+    {
+        f_close(&log->file);
+        return EOF;
+    }
+
+    taskENTER_CRITICAL();
+    log->size += f_size(&log->file);
+    taskEXIT_CRITICAL();
+    log->open = 1;
+    return 0;
+}
+
+/**
+ * writes the pending buffer out to the log file, called with the file lock held.
+ *
+ * @retval 0 if no buffer is left pending, -1 on error.
+ */
+static int __logfile_drain(logfile_t* log)
+{
+    const unsigned char* buffer;
+    unsigned int count;
+    UINT n = 0;
+    FRESULT res;
+
+    taskENTER_CRITICAL();
+    buffer = log->buffer[log->active ^ 1] + log->done;
+    count = log->pending - log->done;
+    taskEXIT_CRITICAL();
+
+    if(count == 0)
+        return 0;
+
+    if(!log->open && __logfile_reopen(log) != 0)
+    {
+        __logfile_error(log, "reopen");
+        return EOF;
+    }
+
+    res = f_write(&log->file, buffer, (UINT)count, &n);
+
+    taskENTER_CRITICAL();
+    log->done += n;
+    if(log->done == log->pending)
+    {
+        log->pending = 0;
+        log->done = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    if(n > 0)
+        log->dirty = 1;
+    if(res != FR_OK || n != count)
+    {
+        __logfile_error(log, "write");
+        return EOF;
+    }
+
+    log->failed = 0;
+    return 0;
+}
+
+/**
+ * writes out the pending buffer, then the partly filled active buffer, called with the file lock held.
+ *
+ * @param   wait is the time in ticks to wait for a writer to let go of the active buffer.
+ *          with a wait of 0 the active buffer is left to the next flush if a writer is busy with it.
+ * @retval  0 on success, -1 on error, or if the active buffer could not be written in time.
+ */
+static int __logfile_flush(logfile_t* log, TickType_t wait)
+{
+    if(__logfile_drain(log) != 0)
+        return EOF;
+
+    if(xSemaphoreTake(log->lock, wait) != pdTRUE)
+        return wait ? EOF : 0;
+    if(log->fill > 0)
+        __logfile_swap(log);
+    unlock_log(log);
+
+    return __logfile_drain(log);
+}
+
+/**
+ * closes the current log file, shifts the rotated files along by one,
+ * and starts a new empty log file. called with the file lock held.
+ *
+ * @retval 0 on success, -1 on error, in which case opening the new file is retried on the next flush.
+ */
+static int __logfile_rotate(logfile_t* log)
+{
+    char from[LOGFILE_PATH_LENGTH];
+    char to[LOGFILE_PATH_LENGTH];
+    unsigned int size = f_size(&log->file);
+    int i;
+
+    f_close(&log->file);
+    log->open = 0;
+    log->dirty = 0;
+
+    taskENTER_CRITICAL();
+    log->size -= size;
+    taskEXIT_CRITICAL();
+
+    for(i = LOGFILE_ROTATE_KEEP; i > 0; i--)
+    {
+        snprintf(to, sizeof(to), "%s.%d", log->name, i);
+        if(i == 1)
+            snprintf(from, sizeof(from), "%s", log->name);
+        else
+            snprintf(from, sizeof(from), "%s.%d", log->name, i - 1);
+
+        if(i == LOGFILE_ROTATE_KEEP)
+            f_unlink((const TCHAR*)to);
+        f_rename((const TCHAR*)from, (const TCHAR*)to);
+    }
+
+    time(&log->started);
+
+    if(f_open(&log->file, (const TCHAR*)log->name, FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+    {
+        __logfile_error(log, "rotate");
+        return EOF;
+    }
+    log->open = 1;
+    return 0;
+}
+
+/**
+ * @retval  1 if the log file is due to be rotated, otherwise 0.
+ */
+static int __logfile_rotate_due(logfile_t* log)
+{
+    time_t now;
+
+    if(!log->open || f_size(&log->file) == 0)
+        return 0;
+
+    if(LOGFILE_ROTATE_SIZE && f_size(&log->file) >= LOGFILE_ROTATE_SIZE)
+        return 1;
+
+    if(LOGFILE_ROTATE_AGE)
+    {
+        time(&now);
+        if(now - log->started >= LOGFILE_ROTATE_AGE)
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * writes out the buffer a writer handed over, or on the periodic pass flushes and syncs the
+ * log file, retrying opening it if a rotation failed to. rotates the file when it is due.
+ * called by the log task, with the file lock held.
+ */
+static void __logfile_service(logfile_t* log, int periodic)
+{
+    if(periodic)
+    {
+        if(__logfile_flush(log, 0) == 0 && !log->open && __logfile_reopen(log) != 0)
+            __logfile_error(log, "reopen");
+        if(log->open && log->dirty && f_sync(&log->file) == FR_OK)
+            log->dirty = 0;
+    }
+    else
+        __logfile_drain(log);
+
+    if(__logfile_rotate_due(log))
+        __logfile_rotate(log);
+}
+
+/**
+ * writes buffers out as writers hand them over, and every LOGFILE_FLUSH_PERIOD milliseconds
+ * flushes and syncs every log file. log files are rotated here, so that writers never wait
+ * for a rotation.
+ */
+static void logfile_task(void* arg)
+{
+    TickType_t period = LOGFILE_FLUSH_PERIOD/portTICK_RATE_MS;
+    TickType_t last = xTaskGetTickCount();
+    logfile_t* log;
+    int periodic;
+    int i;
+    (void)arg;
+
+    for(;;)
+    {
+        ulTaskNotifyTake(pdTRUE, period);
+
+        periodic = xTaskGetTickCount() - last >= period;
+        if(periodic)
+            last = xTaskGetTickCount();
+
+        for(i = 0; i < LOGFILE_TABLE_LENGTH; i++)
+        {
+            log = &logtab[i];
+            if(log->file_lock && lock_file(log))
+            {
+                if(log->used)
+                    __logfile_service(log, periodic);
+                unlock_file(log);
+            }
+        }
+    }
+}
+
+/**
+ * opens a log file for appending, or adds a reference to it if it is already open.
+ *
+ * with O_CREAT and O_EXCL the file must not exist, and must not be open already.
+ * with O_TRUNC the file is truncated, a log file that is already open cannot be.
+ *
+ * @param   name is the full path of the log file.
+ * @param   flags are the flags given to open().
+ * @retval  a pointer to the log file, or NULL on error.
+ */
+logfile_t* logfile_open(const char* name, int flags)
+{
+    logfile_t* log = NULL;
+    logfile_t* slot = NULL;
+    BYTE mode = FA_WRITE|FA_OPEN_ALWAYS;
+    int exclusive = (flags & (O_CREAT|O_EXCL)) == (O_CREAT|O_EXCL);
+    int i;
+
+    // leave room for the rotation suffix
+    if(!name || strlen(name) + 4 > LOGFILE_PATH_LENGTH)
+        return NULL;
+
+    if(exclusive)
+        mode = FA_WRITE|FA_CREATE_NEW;
+    else if(flags & O_TRUNC)
+        mode = FA_WRITE|FA_CREATE_ALWAYS;
+
+    if(lock_logtab())
+    {
+        for(i = 0; i < LOGFILE_TABLE_LENGTH; i++)
+        {
+            if(logtab[i].refs > 0 && !strcmp(logtab[i].name, name))
+            {
+                if(!exclusive && !(flags & O_TRUNC))
+                {
+                    log = &logtab[i];
+                    log->refs++;
+                }
+                slot = NULL;
+                break;
+            }
+            if(!slot && logtab[i].refs == 0)
+                slot = &logtab[i];
+        }
+
+        if(!log && slot)
+        {
+            if(!slot->lock)
+            {
+#if ENABLE_LIKEPOSIX_STATIC
+                slot->lock = xSemaphoreCreateMutexStatic(&slot->lock_buffer);
+                slot->file_lock = xSemaphoreCreateMutexStatic(&slot->file_lock_buffer);
+#else
+                slot->lock = xSemaphoreCreateMutex();
+                slot->file_lock = xSemaphoreCreateMutex();
+#endif
+            }
+
+            if(slot->lock && slot->file_lock && lock_file(slot))
+            {
+                if(f_open(&slot->file, (const TCHAR*)name, mode) == FR_OK)
+                {
+                    if(f_lseek(&slot->file, f_size(&slot->file)) == FR_OK)
+                    {
+                        strcpy(slot->name, name);
+                        time(&slot->started);
+                        slot->size = f_size(&slot->file);
+                        slot->fill = 0;
+                        slot->limit = __logfile_limit(slot->size);
+                        slot->pending = 0;
+                        slot->done = 0;
+                        slot->active = 0;
+                        slot->open = 1;
+                        slot->dirty = 0;
+                        slot->failed = 0;
+                        slot->used = 1;
+                        slot->refs = 1;
+                        log = slot;
+                    }
+                    else
+                        f_close(&slot->file);
+                }
+                unlock_file(slot);
+            }
+        }
+        unlock_logtab();
+    }
+
+    return log;
+}
+
+/**
+ * appends a record to the log file. the record is written as a whole,
+ * it will not be interleaved with records written through other descriptors.
+ *
+ * writes never wait for the card. if the record does not fit in the active buffer while
+ * the other is still waiting for the log task, nothing is written and errno is set to
+ * EAGAIN. a record longer than both buffers can hold is written in part, and the count
+ * written is returned.
+ *
+ * @retval  the number of bytes written, or -1 on error.
+ */
+int logfile_write(logfile_t* log, const char* buffer, unsigned int count)
+{
+    unsigned int n;
+    int written = EOF;
+    int swapped = 0;
+
+    if(lock_log(log))
+    {
+        // pending is only ever cleared behind our back, if it is clear the first swap cannot fail
+        if(count > log->limit - log->fill && log->pending)
+            errno = EAGAIN;
+        else
+        {
+            written = 0;
+            while(count > 0)
+            {
+                if(log->fill == log->limit)
+                {
+                    if(__logfile_swap(log) != 0)
+                        break;
+                    swapped = 1;
+                }
+
+                n = log->limit - log->fill;
+                if(n > count)
+                    n = count;
+
+                memcpy(log->buffer[log->active] + log->fill, buffer, n);
+                log->fill += n;
+                buffer += n;
+                count -= n;
+                written += n;
+            }
+
+            // hand a full buffer over straight away
+            if(log->fill == log->limit && __logfile_swap(log) == 0)
+                swapped = 1;
+        }
+        unlock_log(log);
+    }
+
+    if(swapped)
+        xTaskNotifyGive(logfile_handle);
+
+    return written;
+}
+
+/**
+ * writes any buffered records to the disk.
+ *
+ * @retval  0 on success, -1 on error.
+ */
+int logfile_sync(logfile_t* log)
+{
+    int res = EOF;
+
+    if(lock_file(log))
+    {
+        if(__logfile_flush(log, LOGFILE_WAIT) == 0 && log->open && f_sync(&log->file) == FR_OK)
+        {
+            log->dirty = 0;
+            res = 0;
+        }
+        unlock_file(log);
+    }
+
+    return res;
+}
+
+/**
+ * @retval  the size of the log file, including buffered records.
+ */
+unsigned int logfile_size(logfile_t* log)
+{
+    unsigned int size = 0;
+
+    if(lock_log(log))
+    {
+        taskENTER_CRITICAL();
+        size = log->size + log->fill;
+        taskEXIT_CRITICAL();
+        unlock_log(log);
+    }
+
+    return size;
+}
+
+/**
+ * drops a reference to the log file, the file is flushed and closed
+ * when the last reference is dropped.
+ *
+ * @retval  0 on success, -1 on error.
+ */
+int logfile_close(logfile_t* log)
+{
+    int res = EOF;
+
+    if(lock_logtab())
+    {
+        res = 0;
+        if(--log->refs == 0)
+        {
+            if(lock_file(log))
+            {
+                if(__logfile_flush(log, LOGFILE_WAIT) != 0)
+                    res = EOF;
+                if(log->open && f_close(&log->file) != FR_OK)
+                    res = EOF;
+                log->open = 0;
+                log->used = 0;
+                unlock_file(log);
+            }
+            else
+            {
+                // the file is still open, keep the slot from being reused
+                log->refs++;
+                res = EOF;
+            }
+        }
+        unlock_logtab();
+    }
+
+    return res;
+}
+
+static int logfile_fte_write(filtab_entry_t* fte, const char* buffer, int count)
+{
+    return logfile_write((logfile_t*)fte->ctx, buffer, count);
+}
+
+/**
+ * log files may only be appended to, seeking just reports the end of the file.
+ */
+static int logfile_fte_lseek(filtab_entry_t* fte, int offset, int whence)
+{
+    (void)offset;
+    (void)whence;
+    return logfile_size((logfile_t*)fte->ctx);
+}
+
+static int logfile_fte_fstat(filtab_entry_t* fte, struct stat* st)
+{
+    st->st_size = logfile_size((logfile_t*)fte->ctx);
+    return 0;
+}
+
+static int logfile_fte_fsync(filtab_entry_t* fte)
+{
+    return logfile_sync((logfile_t*)fte->ctx);
+}
+
+static int logfile_fte_close(filtab_entry_t* fte)
+{
+    return logfile_close((logfile_t*)fte->ctx);
+}
+
+static int logfile_fte_poll(filtab_entry_t* fte)
+{
+    (void)fte;
+    return VFS_POLLOUT;
+}
+
+/**
+ * descriptor operations for files opened as log files, see fatfs_open() in syscalls.c.
+ */
+const vfs_ops_t logfile_ops = {
+    .read = NULL,
+    .write = logfile_fte_write,
+    .lseek = logfile_fte_lseek,
+    .fstat = logfile_fte_fstat,
+    .fsync = logfile_fte_fsync,
+    .close = logfile_fte_close,
+    .poll = logfile_fte_poll,
+};
+
+#endif
+
+/**
+ * @}
+ */
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * @addtogroup syscalls
+ *
+ * @file logfile.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_LOGFILE_H_
+#define LIKE_POSIX_LOGFILE_H_
+
+#include "likeposix_config.h"
+#include "vfs.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * enable append-only log file handling for files opened write only with O_APPEND under LOGFILE_DIRECTORY.
+ * only these are appended to atomically from several descriptors. O_RDWR|O_APPEND there, and O_APPEND
+ * on any other FatFs file, append at the end of the file as that descriptor last saw it, appends made
+ * through other descriptors on the same file may be overwritten.
+ */
+#ifndef ENABLE_LIKEPOSIX_LOGFILES
+#define ENABLE_LIKEPOSIX_LOGFILES       0
+#endif
+/**
+ * files opened write only with O_APPEND under this directory are treated as log files.
+ */
+#ifndef LOGFILE_DIRECTORY
+#define LOGFILE_DIRECTORY               "/var/log/"
+#endif
+/**
+ * the maximum number of log files open at once, shared between all descriptors.
+ */
+#ifndef LOGFILE_TABLE_LENGTH
+#define LOGFILE_TABLE_LENGTH            2
+#endif
+/**
+ * size of each of the two record buffers held per log file, must be a multiple of the sector size.
+ */
+#ifndef LOGFILE_BUFFER_SIZE
+#define LOGFILE_BUFFER_SIZE             512
+#endif
+/**
+ * the log task writes out buffered records and syncs every log file this often, in milliseconds.
+ */
+#ifndef LOGFILE_FLUSH_PERIOD
+#define LOGFILE_FLUSH_PERIOD            1000
+#endif
+/**
+ * the log task stack size in words, and priority.
+ */
+#ifndef LOGFILE_TASK_STACK
+#define LOGFILE_TASK_STACK              512
+#endif
+#ifndef LOGFILE_TASK_PRIORITY
+#define LOGFILE_TASK_PRIORITY           (tskIDLE_PRIORITY + 1)
+#endif
+/**
+ * rotate a log file when it grows beyond this many bytes, 0 disables size based rotation.
+ */
+#ifndef LOGFILE_ROTATE_SIZE
+#define LOGFILE_ROTATE_SIZE             (256 * 1024)
+#endif
+/**
+ * rotate a log file when it is older than this many seconds, 0 disables age based rotation.
+ */
+#ifndef LOGFILE_ROTATE_AGE
+#define LOGFILE_ROTATE_AGE              0
+#endif
+/**
+ * the number of rotated files to keep, named <name>.1 to <name>.N, oldest last.
+ */
+#ifndef LOGFILE_ROTATE_KEEP
+#define LOGFILE_ROTATE_KEEP             2
+#endif
+/**
+ * maximum length of a log file path, including the rotation suffix.
+ */
+#ifndef LOGFILE_PATH_LENGTH
+#define LOGFILE_PATH_LENGTH             48
+#endif
+
+#if ENABLE_LIKEPOSIX_LOGFILES
+
+#if (LOGFILE_BUFFER_SIZE % 512) != 0
+#error LOGFILE_BUFFER_SIZE must be a multiple of 512
+#endif
+
+typedef struct _logfile_t logfile_t;
+
+void logfile_init();
+logfile_t* logfile_open(const char* name, int flags);
+int logfile_write(logfile_t* log, const char* buffer, unsigned int count);
+int logfile_sync(logfile_t* log);
+unsigned int logfile_size(logfile_t* log);
+int logfile_close(logfile_t* log);
+
+extern const vfs_ops_t logfile_ops;
+
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_LOGFILE_H_ */
+
+/**
+ * @}
+ */
@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * Caching resolver, in front of the lwIP resolver.
+ *
+ * gethostbyname(), gethostbyname_r() and getaddrinfo() look a name up in the static host
+ * table read from RESOLVER_HOSTS_FILE, then in the cache, and only ask lwIP when neither
+ * has it. Answers are cached for RESOLVER_POSITIVE_TTL seconds, failures the DNS server
+ * answered for RESOLVER_NEGATIVE_TTL seconds. The record TTLs aren't available through the lwIP API, lwIP's
+ * own DNS table, which honours them up to DNS_MAX_TTL, sits behind the cache. Numeric
+ * addresses are passed straight to lwIP.
+ *
+ * getaddrinfo() answers a hit by handing lwIP the address in numeric form, so that its
+ * results are still allocated by lwIP, and freed with lwip_freeaddrinfo().
+ *
+ * getaddrinfo_a() queues requests for the resolver task, created on first use, so that
+ * a task setting up a connection needn't block on the network. The requests are linked
+ * through the gaicb itself, so that gai_cancel() can take one off the queue, after which
+ * the resolver task never touches it.
+ *
+ * @file netdb.c
+ * @{
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include "syscalls.h"
+#include "semphr.h"
+#include "netdb.h"
+#include "lwip/dns.h"
+#include "cutensils.h"
+
+#if ENABLE_LIKEPOSIX_RESOLVER
+
+#if ENABLE_LIKEPOSIX_STATIC
+#error ENABLE_LIKEPOSIX_RESOLVER creates its task and queue on the heap, it cannot be used with ENABLE_LIKEPOSIX_STATIC
+#endif
+
+/**
+ * the longest numeric address, INET6_ADDRSTRLEN.
+ */
+#define RESOLVER_ADDRESS_LENGTH         46
+
+/**
+ * a name in the static host table or the cache.
+ */
+typedef struct {
+    char name[RESOLVER_NAME_LENGTH];        ///< the host name, empty if the entry is unused
+    char address[RESOLVER_ADDRESS_LENGTH];  ///< the address in numeric form, empty if the lookup failed
+    int family;                             ///< the family of the address in the host table, the family asked for in the cache
+    TickType_t added;                       ///< tick count at which a cache entry was added
+    TickType_t ttl;                         ///< the lifetime of a cache entry, in ticks
+} resolver_entry_t;
+
+/**
+ * the hostent gethostbyname() returns on a hit, and the storage it points into.
+ */
+typedef struct {
+    char* addr_list[2];
+    char* aliases[1];
+    uint32_t addr;
+} hostent_helper_t;
+
+static resolver_entry_t hosts[RESOLVER_HOSTS_LENGTH];
+static resolver_entry_t cache[RESOLVER_CACHE_LENGTH];
+static char hosts_loaded;
+static SemaphoreHandle_t resolver_lock;
+static TaskHandle_t resolver_handle;
+static struct gaicb* resolver_queue;            ///< the requests waiting for the resolver task, oldest first
+static int resolver_queued;
+static struct hostent hostent_result;
+static char hostent_buffer[sizeof(hostent_helper_t) + sizeof(void*) + RESOLVER_NAME_LENGTH];
+
+#define lock_resolver()     (xSemaphoreTake(resolver_lock, 2000/portTICK_RATE_MS) == pdTRUE)
+#define unlock_resolver()   xSemaphoreGive(resolver_lock)
+
+/**
+ * initialises the resolver, called by init_likeposix().
+ */
+void resolver_init()
+{
+    if(resolver_lock == NULL)
+    {
+        resolver_lock = xSemaphoreCreateMutex();
+        assert_true(resolver_lock);
+    }
+}
+
+/**
+ * empties the cache, and has the static host table read again on the next lookup.
+ */
+void resolver_flush()
+{
+    if(lock_resolver())
+    {
+        memset(cache, 0, sizeof(cache));
+        hosts_loaded = 0;
+        unlock_resolver();
+    }
+}
+
+/**
+ * @retval  AF_INET or AF_INET6 if name is a numeric address, otherwise 0.
+ */
+static int __numeric_family(const char* name)
+{
+    unsigned char addr[16];
+
+    if(lwip_inet_pton(AF_INET, name, addr) == 1)
+        return AF_INET;
+#if LWIP_IPV6
+    if(lwip_inet_pton(AF_INET6, name, addr) == 1)
+        return AF_INET6;
+#endif
+    return 0;
+}
+
+/**
+ * reads the static host table, with the resolver locked.
+ * lines hold an address followed by one or more names, # starts a comment.
+ */
+static void __load_hosts()
+{
+    char line[128];
+    char* address;
+    char* name;
+    char* save;
+    char* comment;
+    int family;
+    int i = 0;
+    FILE* f;
+
+    memset(hosts, 0, sizeof(hosts));
+
+    f = fopen(RESOLVER_HOSTS_FILE, "r");
+    if(!f)
+        return;
+
+    while(i < RESOLVER_HOSTS_LENGTH && fgets(line, sizeof(line), f))
+    {
+        comment = strchr(line, '#');
+        if(comment)
+            *comment = '\0';
+
+        address = strtok_r(line, " \t\r\n", &save);
+        if(!address || strlen(address) >= RESOLVER_ADDRESS_LENGTH || !(family = __numeric_family(address)))
+            continue;
+
+        while(i < RESOLVER_HOSTS_LENGTH && (name = strtok_r(NULL, " \t\r\n", &save)))
+        {
+            if(strlen(name) >= RESOLVER_NAME_LENGTH)
+                continue;
+            strcpy(hosts[i].name, name);
+            strcpy(hosts[i].address, address);
+            hosts[i].family = family;
+            i++;
+        }
+    }
+
+    fclose(f);
+}
+
+/**
+ * looks a name up in the static host table, then the cache.
+ *
+ * @param   address is set to the address in numeric form, on a hit.
+ * @retval  1 on a hit, 0 if the name is cached as failed, -1 if it is not known.
+ */
+static int __lookup(const char* name, int family, char* address)
+{
+    TickType_t now = xTaskGetTickCount();
+    int res = -1;
+    int i;
+
+    if(!lock_resolver())
+        return -1;
+
+    if(!hosts_loaded)
+    {
+        __load_hosts();
+        hosts_loaded = 1;
+    }
+
+    for(i = 0; i < RESOLVER_HOSTS_LENGTH && res == -1; i++)
+    {
+        if(hosts[i].name[0] && (family == AF_UNSPEC || family == hosts[i].family) && !strcasecmp(hosts[i].name, name))
+        {
+            strcpy(address, hosts[i].address);
+            res = 1;
+        }
+    }
+
+    for(i = 0; i < RESOLVER_CACHE_LENGTH && res == -1; i++)
+    {
+        if(cache[i].name[0] && cache[i].family == family && !strcasecmp(cache[i].name, name))
+        {
+            if((TickType_t)(now - cache[i].added) < cache[i].ttl)
+            {
+                strcpy(address, cache[i].address);
+                res = address[0] ? 1 : 0;
+            }
+            else
+                cache[i].name[0] = '\0';
+        }
+    }
+
+    unlock_resolver();
+    return res;
+}
+
+/**
+ * caches the outcome of a lookup, replacing the entry nearest to expiry when the cache is full.
+ *
+ * @param   address is the address in numeric form, or "" if the lookup failed.
+ * @param   ttl is the lifetime of the entry in seconds, 0 not to cache it.
+ */
+static void __store(const char* name, int family, const char* address, unsigned int ttl)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t left;
+    TickType_t least = portMAX_DELAY;
+    resolver_entry_t* entry = NULL;
+    int i;
+
+    if(!ttl || strlen(name) >= RESOLVER_NAME_LENGTH || !lock_resolver())
+        return;
+
+    for(i = 0; i < RESOLVER_CACHE_LENGTH; i++)
+    {
+        if(!cache[i].name[0] || (cache[i].family == family && !strcasecmp(cache[i].name, name)))
+        {
+            entry = &cache[i];
+            break;
+        }
+        left = (TickType_t)(now - cache[i].added) < cache[i].ttl ? cache[i].ttl - (TickType_t)(now - cache[i].added) : 0;
+        if(left < least)
+        {
+            least = left;
+            entry = &cache[i];
+        }
+    }
+
+    if(entry)
+    {
+        strcpy(entry->name, name);
+        strcpy(entry->address, address);
+        entry->family = family;
+        entry->added = now;
+        entry->ttl = (TickType_t)(ttl * (1000 / portTICK_RATE_MS));
+    }
+
+    unlock_resolver();
+}
+
+/**
+ * caches a successful lookup made by lwIP.
+ */
+static void __store_result(const char* name, int family, int addrtype, const void* addr)
+{
+    char address[RESOLVER_ADDRESS_LENGTH];
+
+    if(lwip_inet_ntop(addrtype, addr, address, sizeof(address)))
+        __store(name, family, address, RESOLVER_POSITIVE_TTL);
+}
+
+/**
+ * caches a failed lookup made by lwIP, if the DNS server answered it.
+ *
+ * lwIP reports a name that doesn't exist, a timeout and a lost link alike. it only gives up
+ * on an unanswered query after several DNS_TMR_INTERVAL periods, and fails at once when no
+ * DNS server is set, so a failure that came back within one period, with a server set, is
+ * the server's answer. any other failure is asked again on the next lookup.
+ *
+ * @param   started is the tick count at which the lookup was passed to lwIP.
+ */
+static void __store_failure(const char* name, int family, TickType_t started)
+{
+    const ip_addr_t* server = dns_getserver(0);
+
+    if((TickType_t)(xTaskGetTickCount() - started) < DNS_TMR_INTERVAL/portTICK_RATE_MS &&
+        server && !ip_addr_isany(server))
+        __store(name, family, "", RESOLVER_NEGATIVE_TTL);
+}
+
+/**
+ * fills in a hostent for an IPv4 address, in buf, as gethostbyname_r() does.
+ *
+ * @retval  0 on success, or ERANGE if buf is too small.
+ */
+static int __fill_hostent(struct hostent* host, const char* name, const char* address, char* buf, size_t buflen)
+{
+    size_t pad = (sizeof(void*) - ((uintptr_t)buf & (sizeof(void*) - 1))) & (sizeof(void*) - 1);
+    hostent_helper_t* helper = (hostent_helper_t*)(buf + pad);
+    char* hostname = (char*)(helper + 1);
+
+    if(buflen < pad + sizeof(hostent_helper_t) + strlen(name) + 1)
+        return ERANGE;
+
+    lwip_inet_pton(AF_INET, address, &helper->addr);
+    helper->addr_list[0] = (char*)&helper->addr;
+    helper->addr_list[1] = NULL;
+    helper->aliases[0] = NULL;
+    strcpy(hostname, name);
+
+    host->h_name = hostname;
+    host->h_aliases = helper->aliases;
+    host->h_addrtype = AF_INET;
+    host->h_length = sizeof(helper->addr);
+    host->h_addr_list = helper->addr_list;
+    return 0;
+}
+
+/**
+ * resolves a host name to an IPv4 address, not reentrant.
+ */
+struct hostent* gethostbyname(const char* name)
+{
+    char address[RESOLVER_ADDRESS_LENGTH];
+    struct hostent* host;
+    TickType_t started;
+
+    if(!name || __numeric_family(name))
+        return lwip_gethostbyname(name);
+
+    switch(__lookup(name, AF_INET, address))
+    {
+        case 1:
+            if(__fill_hostent(&hostent_result, name, address, hostent_buffer, sizeof(hostent_buffer)) == 0)
+                return &hostent_result;
+            break;
+        case 0:
+#if LWIP_DNS_API_DECLARE_H_ERRNO
+            h_errno = HOST_NOT_FOUND;
+#endif
+            return NULL;
+    }
+
+    started = xTaskGetTickCount();
+    host = lwip_gethostbyname(name);
+    if(host)
+        __store_result(name, AF_INET, AF_INET, host->h_addr_list[0]);
+    else
+        __store_failure(name, AF_INET, started);
+    return host;
+}
+
+/**
+ * resolves a host name to an IPv4 address, into a buffer supplied by the caller.
+ */
+int gethostbyname_r(const char* name, struct hostent* ret, char* buf, size_t buflen, struct hostent** result, int* h_errnop)
+{
+    char address[RESOLVER_ADDRESS_LENGTH];
+    TickType_t started;
+    int err;
+
+    if(!name || !ret || !buf || !result || !h_errnop || __numeric_family(name))
+        return lwip_gethostbyname_r(name, ret, buf, buflen, result, h_errnop);
+
+    switch(__lookup(name, AF_INET, address))
+    {
+        case 1:
+            *h_errnop = __fill_hostent(ret, name, address, buf, buflen);
+            *result = *h_errnop ? NULL : ret;
+            return *h_errnop ? -1 : 0;
+        case 0:
+            *h_errnop = HOST_NOT_FOUND;
+            *result = NULL;
+            return -1;
+    }
+
+    started = xTaskGetTickCount();
+    err = lwip_gethostbyname_r(name, ret, buf, buflen, result, h_errnop);
+    if(err == 0)
+        __store_result(name, AF_INET, AF_INET, ret->h_addr_list[0]);
+    else if(*h_errnop == HOST_NOT_FOUND)
+        __store_failure(name, AF_INET, started);
+    return err;
+}
+
+/**
+ * resolves a host and service name. AI_CANONNAME lookups bypass the cache,
+ * lwIP reports the name it was given as the canonical name.
+ */
+int getaddrinfo(const char* nodename, const char* servname, const struct addrinfo* hints, struct addrinfo** res)
+{
+    char address[RESOLVER_ADDRESS_LENGTH];
+    int family = hints ? hints->ai_family : AF_UNSPEC;
+    const struct sockaddr* sa;
+    TickType_t started;
+    int err;
+
+    if(!nodename || !res || __numeric_family(nodename) || (hints && (hints->ai_flags & AI_CANONNAME)))
+        return lwip_getaddrinfo(nodename, servname, hints, res);
+
+    switch(__lookup(nodename, family, address))
+    {
+        case 1:
+            return lwip_getaddrinfo(address, servname, hints, res);
+        case 0:
+            return EAI_FAIL;
+    }
+
+    started = xTaskGetTickCount();
+    err = lwip_getaddrinfo(nodename, servname, hints, res);
+    if(err == 0)
+    {
+        sa = (*res)->ai_addr;
+        if(sa->sa_family == AF_INET)
+            __store_result(nodename, family, AF_INET, &((const struct sockaddr_in*)sa)->sin_addr);
+#if LWIP_IPV6
+        else if(sa->sa_family == AF_INET6)
+            __store_result(nodename, family, AF_INET6, &((const struct sockaddr_in6*)sa)->sin6_addr);
+#endif
+    }
+    else if(err == EAI_FAIL)
+        __store_failure(nodename, family, started);
+
+    return err;
+}
+
+void freeaddrinfo(struct addrinfo* ai)
+{
+    lwip_freeaddrinfo(ai);
+}
+
+/**
+ * resolves the queued getaddrinfo_a() requests.
+ */
+static void resolver_task(void* arg)
+{
+    struct gaicb* req;
+    gai_notify_t notify;
+    int err;
+
+    (void)arg;
+
+    for(;;)
+    {
+        taskENTER_CRITICAL();
+        req = resolver_queue;
+        if(req)
+        {
+            resolver_queue = req->__next;
+            resolver_queued--;
+            req->__running = 1;
+        }
+        taskEXIT_CRITICAL();
+
+        if(!req)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        err = getaddrinfo(req->ar_name, req->ar_service, req->ar_request, &req->ar_result);
+        notify = req->__notify;
+
+        taskENTER_CRITICAL();
+        req->__running = 0;
+        req->__return = err;
+        taskEXIT_CRITICAL();
+
+        if(notify)
+            notify(req);
+    }
+}
+
+/**
+ * creates the resolver task, on first use.
+ *
+ * @retval  1 if the resolver task is running, otherwise 0.
+ */
+static int __start_resolver()
+{
+    TaskHandle_t handle;
+
+    if(resolver_handle)
+        return 1;
+
+    if(lock_resolver())
+    {
+        if(!resolver_handle && xTaskCreate(resolver_task, "resolver", RESOLVER_TASK_STACK, NULL, RESOLVER_TASK_PRIORITY, &handle) == pdPASS)
+            resolver_handle = handle;
+        unlock_resolver();
+    }
+
+    return resolver_handle != NULL;
+}
+
+/**
+ * adds a request to the end of the queue.
+ *
+ * @retval  1 if it was queued, 0 if RESOLVER_QUEUE_LENGTH requests are waiting already.
+ */
+static int __queue_request(struct gaicb* req)
+{
+    struct gaicb** r;
+    int queued = 0;
+
+    req->__next = NULL;
+    taskENTER_CRITICAL();
+    if(resolver_queued < RESOLVER_QUEUE_LENGTH)
+    {
+        for(r = &resolver_queue; *r; r = &(*r)->__next);
+        *r = req;
+        resolver_queued++;
+        queued = 1;
+    }
+    taskEXIT_CRITICAL();
+    return queued;
+}
+
+/**
+ * resolves a list of host and service names, as getaddrinfo() would, in the manner of the
+ * GNU getaddrinfo_a().
+ *
+ * with GAI_WAIT the requests are resolved before getaddrinfo_a() returns. with GAI_NOWAIT they
+ * are queued for the resolver task, and notify, if not NULL, is called in the resolver task as
+ * each completes. gai_error() returns EAI_INPROGRESS until then, and the outcome of getaddrinfo()
+ * after. a request must stay valid until it completes, or, with notify, until notify has returned.
+ *
+ * **this is a non standard function**
+ *
+ * @param   list holds nitems requests, NULL entries are skipped.
+ * @retval  0 if all the requests were resolved or queued, or EAI_AGAIN if some could not be
+ *          queued, those requests complete with EAI_AGAIN.
+ */
+int getaddrinfo_a(int mode, struct gaicb* list[], int nitems, gai_notify_t notify)
+{
+    int res = 0;
+    int queued = 0;
+    int i;
+
+    if(mode == GAI_NOWAIT && !__start_resolver())
+        return EAI_AGAIN;
+
+    for(i = 0; i < nitems; i++)
+    {
+        if(!list[i])
+            continue;
+
+        list[i]->ar_result = NULL;
+        list[i]->__running = 0;
+        list[i]->__notify = notify;
+
+        if(mode == GAI_WAIT)
+            list[i]->__return = getaddrinfo(list[i]->ar_name, list[i]->ar_service, list[i]->ar_request, &list[i]->ar_result);
+        else
+        {
+            list[i]->__return = EAI_INPROGRESS;
+            if(__queue_request(list[i]))
+                queued = 1;
+            else
+            {
+                list[i]->__return = EAI_AGAIN;
+                res = EAI_AGAIN;
+            }
+        }
+    }
+
+    if(queued)
+        xTaskNotifyGive(resolver_handle);
+    return res;
+}
+
+/**
+ * @retval  EAI_INPROGRESS if the request has not completed, otherwise the result of getaddrinfo().
+ */
+int gai_error(struct gaicb* req)
+{
+    return req->__return;
+}
+
+/**
+ * cancels a request queued by getaddrinfo_a(), that the resolver task hasn't started on.
+ * the request is taken off the queue, so it may be freed once canceled.
+ *
+ * @retval  EAI_CANCELED if the request was canceled, EAI_NOTCANCELED if it is being
+ *          resolved, or EAI_ALLDONE if it has completed.
+ */
+int gai_cancel(struct gaicb* req)
+{
+    struct gaicb** r;
+    int res;
+
+    taskENTER_CRITICAL();
+    if(req->__return != EAI_INPROGRESS)
+        res = EAI_ALLDONE;
+    else if(req->__running)
+        res = EAI_NOTCANCELED;
+    else
+    {
+        for(r = &resolver_queue; *r && *r != req; r = &(*r)->__next);
+        if(*r)
+        {
+            *r = req->__next;
+            resolver_queued--;
+        }
+        res = req->__return = EAI_CANCELED;
+    }
+    taskEXIT_CRITICAL();
+
+    return res;
+}
+
+#endif
+
+/**
+ * @}
+ */
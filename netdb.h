@@ -30,11 +30,149 @@
  *
  */
 
+/**
+ * @addtogroup syscalls
+ *
+ * @file netdb.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_NETDB_H_
+#define LIKE_POSIX_NETDB_H_
+
+#include "likeposix_config.h"
 #include "lwip/netdb.h"
 
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * enable the caching resolver in front of the lwIP resolver, see netdb.c.
+ */
+#ifndef ENABLE_LIKEPOSIX_RESOLVER
+#define ENABLE_LIKEPOSIX_RESOLVER       0
+#endif
+/**
+ * the number of names the resolver cache holds, successful and failed lookups alike.
+ */
+#ifndef RESOLVER_CACHE_LENGTH
+#define RESOLVER_CACHE_LENGTH           8
+#endif
+/**
+ * the number of seconds a successful lookup is cached for.
+ */
+#ifndef RESOLVER_POSITIVE_TTL
+#define RESOLVER_POSITIVE_TTL           300
+#endif
+/**
+ * the number of seconds a name the DNS server answered as not found is cached for, 0 disables negative caching.
+ */
+#ifndef RESOLVER_NEGATIVE_TTL
+#define RESOLVER_NEGATIVE_TTL           10
+#endif
+/**
+ * the maximum length of a host name held by the resolver, including the terminating null.
+ */
+#ifndef RESOLVER_NAME_LENGTH
+#define RESOLVER_NAME_LENGTH            64
+#endif
+/**
+ * the static host table, read on the first lookup, lines of the form "address name [alias...]".
+ */
+#ifndef RESOLVER_HOSTS_FILE
+#define RESOLVER_HOSTS_FILE             "/etc/network/hosts"
+#endif
+/**
+ * the number of names the static host table holds, aliases included.
+ */
+#ifndef RESOLVER_HOSTS_LENGTH
+#define RESOLVER_HOSTS_LENGTH           8
+#endif
+/**
+ * the number of getaddrinfo_a() requests that may be waiting for the resolver task.
+ */
+#ifndef RESOLVER_QUEUE_LENGTH
+#define RESOLVER_QUEUE_LENGTH           4
+#endif
+/**
+ * the resolver task stack size in words, and priority.
+ */
+#ifndef RESOLVER_TASK_STACK
+#define RESOLVER_TASK_STACK             384
+#endif
+#ifndef RESOLVER_TASK_PRIORITY
+#define RESOLVER_TASK_PRIORITY          (tskIDLE_PRIORITY + 1)
+#endif
+
+#if ENABLE_LIKEPOSIX_RESOLVER
+
+/**
+ * getaddrinfo_a() modes.
+ */
+#define GAI_WAIT            0       ///< resolve the requests before returning
+#define GAI_NOWAIT          1       ///< queue the requests for the resolver task
+
+/**
+ * getaddrinfo_a() results, lwIP uses values from 200.
+ */
+#ifndef EAI_AGAIN
+#define EAI_AGAIN           220     ///< the request queue is full
+#endif
+#define EAI_INPROGRESS      221     ///< the request has not completed yet
+#define EAI_CANCELED        222     ///< the request was canceled
+#define EAI_NOTCANCELED     223     ///< the request is being resolved, too late to cancel it
+#define EAI_ALLDONE         224     ///< the request has already completed
+
+struct gaicb;
+
+/**
+ * called in the resolver task as each getaddrinfo_a() request completes.
+ */
+typedef void (*gai_notify_t)(struct gaicb* req);
+
+/**
+ * a getaddrinfo_a() request, the arguments and result of getaddrinfo().
+ * the request and the strings it points to must stay valid until it completes.
+ */
+struct gaicb {
+    const char* ar_name;                ///< the node name
+    const char* ar_service;             ///< the service name, may be NULL
+    const struct addrinfo* ar_request;  ///< the hints, may be NULL
+    struct addrinfo* ar_result;         ///< the result, to be freed with freeaddrinfo()
+    int __return;                       ///< private, see gai_error()
+    int __running;                      ///< private, set while the resolver task works on the request
+    gai_notify_t __notify;              ///< private
+    struct gaicb* __next;               ///< private, the next request waiting for the resolver task
+};
+
+void resolver_init();
+void resolver_flush();
+struct hostent* gethostbyname(const char* name);
+int gethostbyname_r(const char* name, struct hostent* ret, char* buf, size_t buflen, struct hostent** result, int* h_errnop);
+int getaddrinfo(const char* nodename, const char* servname, const struct addrinfo* hints, struct addrinfo** res);
+void freeaddrinfo(struct addrinfo* ai);
+int getaddrinfo_a(int mode, struct gaicb* list[], int nitems, gai_notify_t notify);
+int gai_error(struct gaicb* req);
+int gai_cancel(struct gaicb* req);
+
+#else
+
 #define gethostbyname(name) lwip_gethostbyname(name)
 #define gethostbyname_r(name, ret, buf, buflen, result, h_errnop) \
        lwip_gethostbyname_r(name, ret, buf, buflen, result, h_errnop)
 #define freeaddrinfo(addrinfo) lwip_freeaddrinfo(addrinfo)
 #define getaddrinfo(nodname, servname, hints, res) \
        lwip_getaddrinfo(nodname, servname, hints, res)
+
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_NETDB_H_ */
+
+/**
+ * @}
+ */
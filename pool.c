@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * Fixed size object pools.
+ *
+ * Used in place of the heap when ENABLE_LIKEPOSIX_STATIC is set. Allocating and
+ * freeing are O(1), and an empty pool is detected without entering a critical section.
+ *
+ * @file pool.c
+ * @{
+ */
+
+#include "syscalls.h"
+#include "pool.h"
+
+/**
+ * builds the free list of a pool.
+ *
+ * @param   objects is an array of count objects, each of size bytes, at least sizeof(void*).
+ */
+void pool_init(pool_t* pool, void* objects, size_t size, unsigned int count)
+{
+    unsigned char* object = (unsigned char*)objects + size * count;
+
+    pool->free = NULL;
+    pool->available = count;
+    while(count-- > 0)
+    {
+        object -= size;
+        *(void**)object = pool->free;
+        pool->free = object;
+    }
+}
+
+/**
+ * @retval  a free object, or NULL if the pool is exhausted.
+ */
+void* pool_alloc(pool_t* pool)
+{
+    void* object;
+
+    if(!pool->free)
+        return NULL;
+
+    taskENTER_CRITICAL();
+    object = pool->free;
+    if(object)
+    {
+        pool->free = *(void**)object;
+        pool->available--;
+    }
+    taskEXIT_CRITICAL();
+
+    return object;
+}
+
+/**
+ * returns an object to its pool.
+ */
+void pool_free(pool_t* pool, void* object)
+{
+    if(!object)
+        return;
+
+    taskENTER_CRITICAL();
+    *(void**)object = pool->free;
+    pool->free = object;
+    pool->available++;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * Read only filesystem image.
+ *
+ * The image is generated on the host by tools/mkromfs.py, from a directory tree such
+ * as base_fs, and is linked into flash as the array romfs_image. Every directory is a
+ * table of fixed size entries sorted by name, so each path component is found by a
+ * binary search. File data is stored contiguously and word aligned, reads copy
+ * straight out of flash, and romfs_map() gives direct access to a file's data
+ * with no copy at all.
+ *
+ * @file romfs.c
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include "syscalls.h"
+#include "romfs.h"
+#include "cutensils.h"
+
+#if ENABLE_LIKEPOSIX_ROMFS
+
+/**
+ * an open file in the image, the file table entry type of the backend.
+ */
+typedef struct {
+    filtab_entry_t fte;             ///< the common entry, must be the first member
+    const romfs_entry_t* entry;     ///< the file
+    unsigned int pos;               ///< the file position
+} romfs_file_t;
+
+#define ROMFS_DIRECTORY_LENGTH      (sizeof(ROMFS_DIRECTORY) - 1)
+
+#define __romfs_ptr(offset)         (romfs_image + (offset))
+#define __romfs_table(dirent)       ((const romfs_entry_t*)__romfs_ptr((dirent)->offset + sizeof(uint32_t)))
+#define __romfs_name(dirent)        ((const char*)__romfs_ptr((dirent)->name))
+
+static romfs_entry_t root;
+static const vfs_ops_t romfs_ops;
+
+/**
+ * checks the image header, called by init_likeposix().
+ *
+ * @retval 0 if the image is valid, or -1 if not, in which case it is not mounted.
+ */
+int romfs_init()
+{
+    const romfs_header_t* header = (const romfs_header_t*)romfs_image;
+
+    if(header->magic != ROMFS_MAGIC || header->version != ROMFS_VERSION)
+    {
+        log_error(NULL, "invalid romfs image");
+        return EOF;
+    }
+
+    root.name = 0;
+    root.type = ROMFS_TYPE_DIR;
+    root.offset = header->root;
+    root.size = *(const uint32_t*)__romfs_ptr(header->root);
+    return 0;
+}
+
+/**
+ * binary search of a directory table for the name given by the first length characters of name.
+ */
+static const romfs_entry_t* __romfs_find(const romfs_entry_t* dir, const char* name, size_t length)
+{
+    const romfs_entry_t* table = __romfs_table(dir);
+    const char* entry_name;
+    int lo = 0;
+    int hi = (int)dir->size - 1;
+    int mid;
+    int cmp;
+
+    while(lo <= hi)
+    {
+        mid = (lo + hi) / 2;
+        entry_name = __romfs_name(&table[mid]);
+        cmp = strncmp(entry_name, name, length);
+        if(cmp == 0 && entry_name[length] != '\0')
+            cmp = 1;
+
+        if(cmp == 0)
+            return &table[mid];
+        if(cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return NULL;
+}
+
+/**
+ * @retval the image entry for a path under ROMFS_DIRECTORY, or NULL if it doesnt exist.
+ *          the mount directory itself resolves to the root directory.
+ */
+static const romfs_entry_t* __romfs_lookup(const char* path)
+{
+    const romfs_entry_t* entry = &root;
+    const char* end;
+
+    if(path[ROMFS_DIRECTORY_LENGTH - 1] == '\0')
+        return entry;
+    path += ROMFS_DIRECTORY_LENGTH;
+
+    while(*path)
+    {
+        if(*path == '/')
+        {
+            path++;
+            continue;
+        }
+        if(entry->type != ROMFS_TYPE_DIR)
+            return NULL;
+
+        end = strchr(path, '/');
+        if(!end)
+            end = path + strlen(path);
+
+        entry = __romfs_find(entry, path, end - path);
+        if(!entry)
+            return NULL;
+        path = end;
+    }
+
+    return entry;
+}
+
+/**
+ * gives direct access to the data of a file in the image.
+ *
+ * @param   path is the full path of the file, starting with ROMFS_DIRECTORY.
+ * @param   size is set to the size of the file, may be NULL.
+ * @retval  a pointer to the file data in flash, or NULL if the file doesnt exist.
+ */
+const void* romfs_map(const char* path, unsigned int* size)
+{
+    const romfs_entry_t* entry;
+
+    if(!path || strncmp(path, ROMFS_DIRECTORY, ROMFS_DIRECTORY_LENGTH) || root.type != ROMFS_TYPE_DIR)
+        return NULL;
+
+    entry = __romfs_lookup(path);
+    if(!entry || entry->type != ROMFS_TYPE_FILE)
+        return NULL;
+
+    if(size)
+        *size = entry->size;
+    return __romfs_ptr(entry->offset);
+}
+
+/**
+ * opens a file in the image, read only.
+ */
+static int romfs_open(filtab_entry_t* fte, const char* path, int flags, int length)
+{
+    const romfs_entry_t* entry;
+    romfs_file_t* file = (romfs_file_t*)fte;
+    (void)length;
+
+    if((flags & FWRITE) || (flags & O_CREAT))
+        return EOF;
+
+    entry = __romfs_lookup(path);
+    if(!entry || entry->type != ROMFS_TYPE_FILE)
+        return EOF;
+
+    file->entry = entry;
+    file->pos = 0;
+    fte->mode = S_IFREG;
+    fte->ops = &romfs_ops;
+    return 0;
+}
+
+static int romfs_read(filtab_entry_t* fte, char* buffer, int count)
+{
+    romfs_file_t* file = (romfs_file_t*)fte;
+
+    if(file->pos >= file->entry->size)
+        return 0;
+    if((unsigned int)count > file->entry->size - file->pos)
+        count = file->entry->size - file->pos;
+
+    memcpy(buffer, __romfs_ptr(file->entry->offset + file->pos), count);
+    file->pos += count;
+    return count;
+}
+
+static int romfs_lseek(filtab_entry_t* fte, int offset, int whence)
+{
+    romfs_file_t* file = (romfs_file_t*)fte;
+
+    if(whence == SEEK_CUR)
+        offset += file->pos;
+    else if(whence == SEEK_END)
+        offset += file->entry->size;
+
+    if(offset < 0)
+        return EOF;
+
+    file->pos = offset;
+    return offset;
+}
+
+static int romfs_fstat(filtab_entry_t* fte, struct stat* st)
+{
+    st->st_size = ((romfs_file_t*)fte)->entry->size;
+    return 0;
+}
+
+static int romfs_close(filtab_entry_t* fte)
+{
+    (void)fte;
+    return 0;
+}
+
+static int romfs_poll(filtab_entry_t* fte)
+{
+    (void)fte;
+    return VFS_POLLIN;
+}
+
+static const vfs_ops_t romfs_ops = {
+    .read = romfs_read,
+    .write = NULL,
+    .lseek = romfs_lseek,
+    .fstat = romfs_fstat,
+    .fsync = NULL,
+    .close = romfs_close,
+    .poll = romfs_poll,
+};
+
+static int romfs_stat(const char* path, struct stat* st)
+{
+    const romfs_entry_t* entry = __romfs_lookup(path);
+
+    if(!entry)
+        return EOF;
+
+    if(entry->type == ROMFS_TYPE_DIR)
+    {
+        st->st_size = 0;
+        st->st_mode = S_IFDIR;
+    }
+    else
+    {
+        st->st_size = entry->size;
+        st->st_mode = S_IFREG;
+    }
+    return 0;
+}
+
+static int romfs_opendir(dir_entry_t* dir, const char* path)
+{
+    const romfs_entry_t* entry = __romfs_lookup(path);
+
+    if(!entry || entry->type != ROMFS_TYPE_DIR)
+        return EOF;
+
+    dir->ctx = (void*)entry;
+    dir->index = 0;
+    return 0;
+}
+
+static int romfs_readdir(dir_entry_t* dir, struct dirent* ent)
+{
+    const romfs_entry_t* entry = (const romfs_entry_t*)dir->ctx;
+    const romfs_entry_t* item;
+
+    if((unsigned int)dir->index >= entry->size)
+        return EOF;
+
+    item = &__romfs_table(entry)[dir->index++];
+    strncpy(ent->d_name, __romfs_name(item), sizeof(ent->d_name) - 1);
+    ent->d_name[sizeof(ent->d_name) - 1] = '\0';
+    ent->d_type = item->type == ROMFS_TYPE_DIR ? DT_DIR : DT_REG;
+    return 0;
+}
+
+const vfs_fs_t romfs_fs = {
+    .prefix = ROMFS_DIRECTORY,
+    .entry_size = sizeof(romfs_file_t),
+    .open = romfs_open,
+    .stat = romfs_stat,
+    .unlink = NULL,
+    .rename = NULL,
+    .mkdir = NULL,
+    .opendir = romfs_opendir,
+    .readdir = romfs_readdir,
+    .closedir = NULL,
+};
+
+#endif
+
+/**
+ * @}
+ */
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * @file romfs.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_ROMFS_H_
+#define LIKE_POSIX_ROMFS_H_
+
+#include "likeposix_config.h"
+#include "vfs.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * enable the read only filesystem image, mounted at ROMFS_DIRECTORY.
+ * the image is generated from a directory tree by tools/mkromfs.py, and linked into flash.
+ */
+#ifndef ENABLE_LIKEPOSIX_ROMFS
+#define ENABLE_LIKEPOSIX_ROMFS          0
+#endif
+/**
+ * location where the read only filesystem image is mounted.
+ * set to "/" to serve every absolute path from the image, for boards without an SD card.
+ */
+#ifndef ROMFS_DIRECTORY
+#define ROMFS_DIRECTORY                 "/romfs/"
+#endif
+
+#define ROMFS_MAGIC                     0x464d4f52  ///< "ROMF", little endian
+#define ROMFS_VERSION                   1
+#define ROMFS_TYPE_FILE                 1
+#define ROMFS_TYPE_DIR                  2
+
+/**
+ * image header, at offset 0 of the image. all offsets are from the start of the image,
+ * all values are little endian.
+ */
+typedef struct {
+    uint32_t magic;         ///< ROMFS_MAGIC
+    uint32_t version;       ///< ROMFS_VERSION
+    uint32_t size;          ///< the size of the image in bytes
+    uint32_t root;          ///< offset of the root directory table
+} romfs_header_t;
+
+/**
+ * directory table entry. a directory table is a uint32_t entry count followed by
+ * the entries, sorted by name in strcmp() order.
+ */
+typedef struct {
+    uint32_t name;          ///< offset of the null terminated entry name
+    uint32_t type;          ///< ROMFS_TYPE_FILE or ROMFS_TYPE_DIR
+    uint32_t offset;        ///< offset of the file data, or of the directory table
+    uint32_t size;          ///< the file size in bytes, or the number of entries in the directory
+} romfs_entry_t;
+
+#if ENABLE_LIKEPOSIX_ROMFS
+
+/**
+ * the image, defined in the source file generated by tools/mkromfs.py.
+ */
+extern const unsigned char romfs_image[];
+
+extern const vfs_fs_t romfs_fs;
+
+int romfs_init();
+const void* romfs_map(const char* path, unsigned int* size);
+
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_ROMFS_H_ */
+
+/**
+ * @}
+ */
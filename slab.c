@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * Size class allocator.
+ *
+ * Small allocations are served from fixed size object pools, one per size class,
+ * each with its own free list. Allocating and freeing are O(1), and small short lived
+ * objects no longer fragment the FreeRTOS heap. The pools are carved from a single
+ * block taken from the heap by slab_init(), early on, before the heap fragments.
+ *
+ * An allocation is served from the smallest class it fits, or the next larger one
+ * if that class is exhausted. Allocations that fit no class, or that are made before
+ * slab_init(), go to pvPortMalloc() as before.
+ *
+ * @file slab.c
+ * @{
+ */
+
+#include <string.h>
+#include "syscalls.h"
+#include "slab.h"
+#include "cutensils.h"
+
+#if ENABLE_LIKEPOSIX_SLAB
+
+/**
+ * a free object, the link is held in the object itself.
+ */
+typedef struct _slab_free_t {
+    struct _slab_free_t* next;
+} slab_free_t;
+
+static const unsigned int slab_sizes[] = SLAB_CLASS_SIZES;
+static const unsigned int slab_counts[] = SLAB_CLASS_COUNTS;
+
+#define SLAB_CLASS_COUNT        (sizeof(slab_sizes) / sizeof(slab_sizes[0]))
+
+static unsigned char* slab_base[SLAB_CLASS_COUNT + 1];  ///< the start of each pool, then the end of the last
+static slab_free_t* slab_freelist[SLAB_CLASS_COUNT];
+static slab_usage_t slab_stats[SLAB_CLASS_COUNT];
+
+/**
+ * allocates the pools and builds their free lists, called by init_likeposix().
+ */
+void slab_init()
+{
+    unsigned int c, i;
+    size_t total = 0;
+    unsigned char* pool;
+
+    if(slab_base[0])
+        return;
+
+    assert_true(sizeof(slab_sizes) == sizeof(slab_counts));
+
+    for(c = 0; c < SLAB_CLASS_COUNT; c++)
+    {
+        assert_true((slab_sizes[c] % portBYTE_ALIGNMENT) == 0);
+        assert_true(c == 0 || slab_sizes[c] > slab_sizes[c-1]);
+        total += slab_sizes[c] * slab_counts[c];
+    }
+
+    pool = pvPortMalloc(total);
+    assert_true(pool);
+
+    for(c = 0; c < SLAB_CLASS_COUNT; c++)
+    {
+        slab_base[c] = pool;
+        slab_stats[c].size = slab_sizes[c];
+        slab_stats[c].count = slab_counts[c];
+        slab_freelist[c] = NULL;
+        for(i = slab_counts[c]; i > 0; i--)
+        {
+            slab_free_t* obj = (slab_free_t*)(pool + (i - 1) * slab_sizes[c]);
+            obj->next = slab_freelist[c];
+            slab_freelist[c] = obj;
+        }
+        pool += slab_sizes[c] * slab_counts[c];
+    }
+    slab_base[SLAB_CLASS_COUNT] = pool;
+}
+
+/**
+ * @retval  an object of at least size bytes, or NULL if none is available.
+ */
+void* slab_alloc(size_t size)
+{
+    slab_free_t* obj = NULL;
+    unsigned int c;
+
+    if(!slab_base[0] || size == 0)
+        return NULL;
+
+    taskENTER_CRITICAL();
+    for(c = 0; c < SLAB_CLASS_COUNT; c++)
+    {
+        if(size > slab_sizes[c])
+            continue;
+
+        obj = slab_freelist[c];
+        if(obj)
+        {
+            slab_freelist[c] = obj->next;
+            if(++slab_stats[c].used > slab_stats[c].peak)
+                slab_stats[c].peak = slab_stats[c].used;
+            break;
+        }
+        slab_stats[c].fallback++;
+    }
+    taskEXIT_CRITICAL();
+
+    return obj;
+}
+
+/**
+ * @retval  the class of the pool ptr lies in, or -1 if it was not allocated by slab_alloc().
+ */
+static inline int __slab_class(void* ptr)
+{
+    int c;
+
+    if((unsigned char*)ptr < slab_base[0] || (unsigned char*)ptr >= slab_base[SLAB_CLASS_COUNT])
+        return -1;
+
+    for(c = 0; (unsigned char*)ptr >= slab_base[c + 1]; c++);
+    return c;
+}
+
+/**
+ * @retval  1 if ptr was allocated by slab_alloc(), 0 otherwise.
+ */
+int slab_owns(void* ptr)
+{
+    return __slab_class(ptr) != -1;
+}
+
+/**
+ * returns an object allocated by slab_alloc() to its free list.
+ */
+void slab_free(void* ptr)
+{
+    int c = __slab_class(ptr);
+    slab_free_t* obj = (slab_free_t*)ptr;
+
+    if(c == -1)
+        return;
+
+    taskENTER_CRITICAL();
+    obj->next = slab_freelist[c];
+    slab_freelist[c] = obj;
+    slab_stats[c].used--;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @retval  the usable size of an object allocated by slab_alloc(), or 0 if ptr was not.
+ */
+size_t slab_size(void* ptr)
+{
+    int c = __slab_class(ptr);
+    return c == -1 ? 0 : slab_sizes[c];
+}
+
+/**
+ * @retval  the number of size classes.
+ */
+int slab_classes()
+{
+    return SLAB_CLASS_COUNT;
+}
+
+/**
+ * copies the usage counters of a size class.
+ */
+void slab_usage(int cls, slab_usage_t* usage)
+{
+    if(cls < 0 || cls >= (int)SLAB_CLASS_COUNT)
+        return;
+
+    taskENTER_CRITICAL();
+    *usage = slab_stats[cls];
+    taskEXIT_CRITICAL();
+}
+
+#endif
+
+/**
+ * @}
+ */
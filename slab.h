@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+
+/**
+ * @addtogroup syscalls
+ *
+ * @file slab.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_SLAB_H_
+#define LIKE_POSIX_SLAB_H_
+
+#include <stddef.h>
+#include "likeposix_config.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * enable the size class allocator for small allocations made through malloc(), calloc() and realloc().
+ */
+#ifndef ENABLE_LIKEPOSIX_SLAB
+#define ENABLE_LIKEPOSIX_SLAB           0
+#endif
+/**
+ * object sizes of each class, in ascending order. each must be a multiple of portBYTE_ALIGNMENT.
+ */
+#ifndef SLAB_CLASS_SIZES
+#define SLAB_CLASS_SIZES                {16, 32, 64, 128}
+#endif
+/**
+ * the number of objects in each class, the pools are allocated in one block by slab_init().
+ * the defaults, 6.5 KB of pools, cover the peak use of each class in tests/slab_bench.
+ */
+#ifndef SLAB_CLASS_COUNTS
+#define SLAB_CLASS_COUNTS               {32, 32, 32, 24}
+#endif
+
+#if ENABLE_LIKEPOSIX_SLAB
+
+/**
+ * size class usage counters.
+ */
+typedef struct {
+    unsigned int size;      ///< the object size of the class
+    unsigned int count;     ///< the number of objects in the class
+    unsigned int used;      ///< the number of objects allocated
+    unsigned int peak;      ///< the highest value used has reached
+    unsigned int fallback;  ///< allocations of this class that fell through to a larger class or the heap
+} slab_usage_t;
+
+void slab_init();
+void* slab_alloc(size_t size);
+int slab_owns(void* ptr);
+void slab_free(void* ptr);
+size_t slab_size(void* ptr);
+int slab_classes();
+void slab_usage(int cls, slab_usage_t* usage);
+
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_SLAB_H_ */
+
+/**
+ * @}
+ */
@@ -31,8 +31,54 @@
  */
 
 #include "syscalls.h"
+#include <time.h>
 #include "lwip/sockets.h"
 
+/**
+ * enable recv_zerocopy(), which reads received data in place in the lwIP buffers.
+ * requires lwIP 2.1 or later.
+ */
+#ifndef ENABLE_LIKEPOSIX_ZEROCOPY
+#define ENABLE_LIKEPOSIX_ZEROCOPY   0
+#endif
+
+/**
+ * enable write coalescing on stream sockets, with MSG_MORE and TCP_CORK. up to SOCKET_CORK_SIZE
+ * bytes are held per socket, and sent at the latest SOCKET_CORK_TIMEOUT milliseconds after the
+ * first of them was written. requires lwIP 2.1 or later, and FreeRTOS software timers.
+ */
+#ifndef ENABLE_LIKEPOSIX_CORK
+#define ENABLE_LIKEPOSIX_CORK       0
+#endif
+#ifndef SOCKET_CORK_SIZE
+#define SOCKET_CORK_SIZE            1460
+#endif
+#ifndef SOCKET_CORK_TIMEOUT
+#define SOCKET_CORK_TIMEOUT         200
+#endif
+
+/**
+ * enable recvmmsg() and sendmmsg(). requires lwIP 2.1 or later.
+ */
+#ifndef ENABLE_LIKEPOSIX_MMSG
+#define ENABLE_LIKEPOSIX_MMSG       0
+#endif
+
+/**
+ * the longest a blocking connect() waits, in milliseconds, on a socket without SO_SNDTIMEO set.
+ * 0 waits until lwIP gives up.
+ */
+#ifndef SOCKET_CONNECT_TIMEOUT
+#define SOCKET_CONNECT_TIMEOUT      0
+#endif
+
+#if ENABLE_LIKEPOSIX_CORK && !defined(TCP_CORK)
+/**
+ * IPPROTO_TCP level option, lwIP doesn't have it, setsockopt() handles it.
+ */
+#define TCP_CORK                    0x10
+#endif
+
 #if ENABLE_LIKEPOSIX_SOCKETS
 
 int socket(int namespace, int style, int protocol);
@@ -51,6 +97,35 @@ int recvfrom(int socket, void *buffer, size_t size, int flags, struct sockaddr *
 int send(int socket, const void *buffer, size_t size, int flags);
 int sendto(int socket, const void *buffer, size_t size, int flags, struct sockaddr *addr, socklen_t length);
 int ioctlsocket(int socket, int cmd, void* argp);
+
+#if ENABLE_LIKEPOSIX_MMSG
+/**
+ * a message for recvmmsg() and sendmmsg().
+ */
+struct mmsghdr {
+    struct msghdr msg_hdr;  ///< the message
+    unsigned int msg_len;   ///< set to the number of bytes received or sent
+};
+
+int recvmmsg(int socket, struct mmsghdr* msgvec, unsigned int vlen, int flags, struct timespec* timeout);
+int sendmmsg(int socket, struct mmsghdr* msgvec, unsigned int vlen, int flags);
+#endif
+
+#if ENABLE_LIKEPOSIX_ZEROCOPY
+/**
+ * data received by recv_zerocopy(), held in the lwIP buffers it arrived in.
+ * the members are private.
+ */
+typedef struct {
+    void* buf;          ///< the received pbuf chain, or netbuf for datagram sockets
+    void* next;         ///< the next segment to return from recv_zerocopy_next()
+    int datagram;       ///< set if buf is a netbuf
+} recv_zerocopy_t;
+
+int recv_zerocopy(int socket, recv_zerocopy_t* zc, int flags);
+const void* recv_zerocopy_next(recv_zerocopy_t* zc, size_t* length);
+void recv_zerocopy_release(recv_zerocopy_t* zc);
+#endif
 #else
 
 #define accept(a,b,c)         lwip_accept(a,b,c)
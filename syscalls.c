@@ -41,7 +41,7 @@
  *
  * The API given on the newlib site was used as a basis: https://sourceware.org/newlib/
  *
- * The implementation of _realloc_r was taken from Stefano Oliveri's syscalls_minimal.c
+ * The implementation of _realloc_r was originally taken from Stefano Oliveri's syscalls_minimal.c
  *
  * The result is Device, File and Socket IO, all avaliable under an almost standard C
  * API, including open, close, read, write, fsync, flseek, etc.
@@ -55,10 +55,12 @@
  * The following system calls are available:
  *
  * int open(const char *name, int flags, int mode)
+ * int open_encoded(const char* name, int flags, int accepted, int* encoding)
  * int close(int file)
  * int write(int file, char *buffer, unsigned int count)
  * int read(int file, char *buffer, int count)
  * int fsync(int file)
+ * int fcntl(int file, int cmd, ...)
  * int fstat(int file, struct stat *st)
  * int stat(char *file, struct stat *st)
  * int isatty(int file)
@@ -76,6 +78,20 @@
  * time_t time(time_t* time)
  * unsigned int sleep(unsigned int secs)
  * int usleep(useconds_t usecs)
+ * int poll(struct pollfd* fds, nfds_t nfds, int timeout)
+ * int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout)
+ * int epoll_create(int size)
+ * int epoll_create1(int flags)
+ * int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+ * int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout)
+ * int timer_create(clockid_t clock_id, struct sigevent* event, timer_t* timerid) (ENABLE_LIKEPOSIX_TIMERS)
+ * int timer_delete(timer_t timerid)
+ * int timer_settime(timer_t timerid, int flags, const struct itimerspec* value, struct itimerspec* ovalue)
+ * int timer_gettime(timer_t timerid, struct itimerspec* value)
+ * int timer_getoverrun(timer_t timerid)
+ * int timerfd_create(int clock_id, int flags)
+ * int timerfd_settime(int fd, int flags, const struct itimerspec* new_value, struct itimerspec* old_value)
+ * int timerfd_gettime(int fd, struct itimerspec* curr_value)
  *
  * termios functions supported:
  *
@@ -107,6 +123,14 @@
  * int send(int socket, const void *buffer, size_t size, int flags);
  * int sendto(int socket, const void *buffer, size_t size, int flags, struct sockaddr *addr, socklen_t length);
  * int ioctlsocket(int socket, int cmd, void* argp);
+ * int recvmmsg(int socket, struct mmsghdr* msgvec, unsigned int vlen, int flags, struct timespec* timeout); (ENABLE_LIKEPOSIX_MMSG)
+ * int sendmmsg(int socket, struct mmsghdr* msgvec, unsigned int vlen, int flags);
+ * int recv_zerocopy(int socket, recv_zerocopy_t* zc, int flags); (ENABLE_LIKEPOSIX_ZEROCOPY)
+ * const void* recv_zerocopy_next(recv_zerocopy_t* zc, size_t* length);
+ * void recv_zerocopy_release(recv_zerocopy_t* zc);
+ *
+ * socket calls don't take the file table lock, see closesocket() for what that means
+ * when a socket is closed while another task is using it.
  *
  * @file syscalls.c
  * @{
@@ -123,8 +147,39 @@
 //#include <errno.h>
 #include <time.h>
 #include <string.h>
+#include <limits.h>
+#include <stdarg.h>
+#include "poll.h"
+#include "sys/epoll.h"
+#include "sys/timerfd.h"
 #include "syscalls.h"
+#include "vfs.h"
+#include "logfile.h"
+#include "tmpfs.h"
+#include "romfs.h"
+#include "netdb.h"
+#include "clock.h"
+#include "slab.h"
+#include "heaptrace.h"
+#include "pool.h"
 #include "cutensils.h"
+#if ENABLE_LIKEPOSIX_SOCKETS && (ENABLE_LIKEPOSIX_SOCKET_EVENTS || ENABLE_LIKEPOSIX_ZEROCOPY)
+#include "lwip/priv/sockets_priv.h"
+#endif
+#if ENABLE_LIKEPOSIX_SOCKETS && ENABLE_LIKEPOSIX_CORK
+#include "semphr.h"
+#endif
+#if (ENABLE_LIKEPOSIX_SOCKETS && ENABLE_LIKEPOSIX_CORK) || ENABLE_LIKEPOSIX_TIMERS
+#include "timers.h"
+#endif
+#if ENABLE_LIKEPOSIX_TIMERS
+#include <signal.h>
+#endif
+#if ENABLE_LIKEPOSIX_SOCKETS && ENABLE_LIKEPOSIX_ZEROCOPY
+#include "lwip/api.h"
+#include "lwip/pbuf.h"
+#include "lwip/err.h"
+#endif
 #include "strutils.h"
 #include "systime.h"
 
@@ -138,15 +193,156 @@ typedef struct A_BLOCK_LINK
 } xBlockLink;
 
 /**
- * filetable entry definition
+ * the size of the block header that precedes each allocation, as in heap_2.c / heap_4.c
+ * of FreeRTOS V8. older heap_2 versions padded the header a whole alignment unit further,
+ * if so, define HEAP_BLOCK_HEADER_SIZE in likeposix_config.h.
+ *
+ * realloc() reads the size of a block from this header, so the FreeRTOS port must use
+ * heap_2.c or heap_4.c. heap_1.c cannot free, and heap_3.c and heap_5.c lay their blocks
+ * out differently, realloc() would copy the wrong number of bytes with them.
+ */
+#ifndef HEAP_BLOCK_HEADER_SIZE
+#define HEAP_BLOCK_HEADER_SIZE          ((sizeof(xBlockLink) + (portBYTE_ALIGNMENT - 1)) & ~((size_t)portBYTE_ALIGNMENT - 1))
+#endif
+
+/**
+ * the bit heap_4 sets in xBlockSize of allocated blocks.
+ */
+#define heapBLOCK_ALLOCATED_BIT         ((size_t)1 << ((sizeof(size_t) * 8) - 1))
+
+/**
+ * FatFs file table entry, the only descriptor type that holds a FIL.
+ */
+typedef struct {
+    filtab_entry_t entry;   ///< common header, must be the first member
+    FIL file;               ///< regular file
+#if ENABLE_LIKEPOSIX_FASTSEEK
+    DWORD* clmt;            ///< cluster link map table, built on the first seek of a large read only file
+    char clmt_tried;        ///< set once an attempt has been made to build clmt
+#endif
+} fatfs_entry_t;
+
+#define __fatfs(fte)                    ((fatfs_entry_t*)(fte))
+#define __device(fte)                   ((dev_ioctl_t*)(fte)->ctx)
+
+/**
+ * @retval  the device interface of a device descriptor, or NULL for other descriptor types.
+ */
+static inline dev_ioctl_t* __get_device(filtab_entry_t* fte)
+{
+    return (fte && fte->mode == S_IFIFO) ? __device(fte) : NULL;
+}
+
+#if ENABLE_LIKEPOSIX_EPOLL
+/**
+ * epoll instance file table entry. epoll instances have no file type, their mode is 0.
+ */
+typedef struct {
+    filtab_entry_t entry;   ///< common header, must be the first member
+    epoll_watch_t* ready;   ///< registrations that may have events to report, oldest first
+    epoll_watch_t* last;    ///< the last registration in the ready list
+#if ENABLE_LIKEPOSIX_SOCKETS && !ENABLE_LIKEPOSIX_SOCKET_EVENTS
+    epoll_watch_t* sockets; ///< the socket registrations, checked on every scan without socket events
+#endif
+} epoll_entry_t;
+
+/**
+ * a descriptor registered with an epoll instance.
+ */
+struct _epoll_watch_t {
+    epoll_watch_t* next;        ///< the next registration on the same descriptor
+    epoll_watch_t* ready_next;  ///< the next registration in the instance ready list
+    epoll_entry_t* epoll;       ///< the instance
+    filtab_entry_t* fte;        ///< the registered descriptor
+    uint32_t events;            ///< the events of interest, and EPOLLET, EPOLLONESHOT
+    epoll_data_t data;          ///< returned with the events
+    char queued;                ///< set while the registration is in the ready list
+#if ENABLE_LIKEPOSIX_SOCKETS && !ENABLE_LIKEPOSIX_SOCKET_EVENTS
+    epoll_watch_t* socket_next; ///< the next socket registration with the same instance
+#endif
+};
+
+/**
+ * the events a registration reports, 0 if it is disabled after EPOLLONESHOT.
+ */
+#define __watch_events(watch)           ((watch)->events & ~(EPOLLET|EPOLLONESHOT))
+#endif
+
+#if ENABLE_LIKEPOSIX_SOCKETS
+typedef struct _accept_slots_t accept_slots_t;
+typedef struct _socket_cork_t socket_cork_t;
+
+/**
+ * socket file table entry.
  */
 typedef struct {
-	dev_ioctl_t* device;	///< pointer to the device interface
-    int mode;               ///< the the mode under which the device was opened
-	int flags;				///< the the mode under which the device was opened
-	FIL file;				///< regular file, or device interface file
-	unsigned int size;		///< size, used only for queues
-}filtab_entry_t;
+    filtab_entry_t entry;       ///< common header, must be the first member
+#if ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+    accept_slots_t* slots;      ///< on a listening socket, the entries reserved for its connections
+    accept_slots_t* owner;      ///< on an accepted socket, the reservation the entry was drawn from
+#endif
+#if ENABLE_LIKEPOSIX_CORK
+    socket_cork_t* cork;        ///< the write coalescing buffer, allocated on first use
+#endif
+} socket_entry_t;
+
+#define __socket(fte)                   ((socket_entry_t*)(fte))
+#define __socket_fd(fte)                ((int)(intptr_t)(fte)->ctx)     ///< the lwIP socket number
+
+#if ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+/**
+ * the entries listen() reserves for the connections accepted on a listening socket.
+ * it is freed once the listening socket and every connection drawn from it are closed.
+ */
+struct _accept_slots_t {
+    pool_t pool;                ///< the free entries
+    int refs;                   ///< the listening socket, plus one per entry in use
+    socket_entry_t objects[];   ///< the entries
+};
+
+/**
+ * drops a reference to a reservation, with the file table locked.
+ */
+static inline void __put_slots(accept_slots_t* slots)
+{
+    if(--slots->refs == 0)
+        vPortFree(slots);
+}
+#endif
+#endif
+
+/**
+ * a task sleeping in select(), poll() or epoll_wait(), woken by vfs_notify().
+ */
+typedef struct _vfs_waiter_t {
+    TaskHandle_t task;
+    const void* key;            ///< the epoll instance waited on, or NULL in select() and poll()
+    struct _vfs_waiter_t* next;
+#if VFS_NOTIFY_INDEX < 0
+    SemaphoreHandle_t wake;     ///< given to wake the task
+#if configSUPPORT_STATIC_ALLOCATION
+    StaticSemaphore_t wake_buffer;
+#endif
+#endif
+} vfs_waiter_t;
+
+/**
+ * wake and sleep on the notification value at VFS_NOTIFY_INDEX, or on the waiter's own
+ * semaphore, so that waiting in select(), poll() and epoll_wait() leaves the notification
+ * value the application uses alone.
+ */
+#if VFS_NOTIFY_INDEX < 0
+#define __wake_waiter(waiter)                       xSemaphoreGive((waiter)->wake)
+#define __wake_waiter_from_isr(waiter, woken)       xSemaphoreGiveFromISR((waiter)->wake, woken)
+#define __sleep_waiter(waiter, ticks)               xSemaphoreTake((waiter)->wake, ticks)
+#else
+#if VFS_NOTIFY_INDEX >= configTASK_NOTIFICATION_ARRAY_ENTRIES
+#error VFS_NOTIFY_INDEX must be less than configTASK_NOTIFICATION_ARRAY_ENTRIES
+#endif
+#define __wake_waiter(waiter)                       xTaskNotifyGiveIndexed((waiter)->task, VFS_NOTIFY_INDEX)
+#define __wake_waiter_from_isr(waiter, woken)       vTaskNotifyGiveIndexedFromISR((waiter)->task, VFS_NOTIFY_INDEX, woken)
+#define __sleep_waiter(waiter, ticks)               ulTaskNotifyTakeIndexed(VFS_NOTIFY_INDEX, pdTRUE, ticks)
+#endif
 
 /**
  * file table definition.
@@ -155,7 +351,12 @@ typedef struct {
 	int count;									///< the number of open files, 0 means nothing open yet
 	filtab_entry_t* tab[FILE_TABLE_LENGTH];		///< the file table
 	dev_ioctl_t* devtab[DEVICE_TABLE_LENGTH];	///< the device table
+	const vfs_fs_t* mounts[VFS_MOUNT_TABLE_LENGTH];	///< the mounted backends
 	SemaphoreHandle_t lock;                     ///< file table lock.
+	vfs_waiter_t* waiters;                      ///< the tasks sleeping in select() or poll()
+#if ENABLE_LIKEPOSIX_SOCKETS
+	volatile uint32_t sockets[FILE_TABLE_LENGTH];	///< socket translation, read without the lock, see __lookup_socket()
+#endif
 }_filtab_t;
 
 /**
@@ -165,6 +366,58 @@ typedef struct {
 
 #define DEFAULT_DEVICE_TIMEOUT          1000
 
+/**
+ * enable FatFs fast seek on large read only files, requires _USE_FASTSEEK in ffconf.h.
+ */
+#ifndef ENABLE_LIKEPOSIX_FASTSEEK
+#define ENABLE_LIKEPOSIX_FASTSEEK       0
+#endif
+/**
+ * files smaller than this are not worth building a cluster link map table for.
+ */
+#ifndef FASTSEEK_MIN_FILE_SIZE
+#define FASTSEEK_MIN_FILE_SIZE          (64 * 1024)
+#endif
+/**
+ * the maximum length of a cluster link map table, in DWORD items.
+ */
+#ifndef FASTSEEK_MAX_CLMT_LENGTH
+#define FASTSEEK_MAX_CLMT_LENGTH        64
+#endif
+
+#if ENABLE_LIKEPOSIX_SOCKETS && ENABLE_LIKEPOSIX_CORK && !(configUSE_TIMERS && INCLUDE_xTimerPendFunctionCall)
+#error ENABLE_LIKEPOSIX_CORK requires configUSE_TIMERS and INCLUDE_xTimerPendFunctionCall to be set in FreeRTOSConfig.h
+#endif
+
+#if ENABLE_LIKEPOSIX_TIMERS && !(configUSE_TIMERS && INCLUDE_xTimerPendFunctionCall && INCLUDE_xTimerGetTimerDaemonTaskHandle)
+#error ENABLE_LIKEPOSIX_TIMERS requires configUSE_TIMERS, INCLUDE_xTimerPendFunctionCall and INCLUDE_xTimerGetTimerDaemonTaskHandle to be set in FreeRTOSConfig.h
+#endif
+
+#if ENABLE_LIKEPOSIX_FASTSEEK && !_USE_FASTSEEK
+#error ENABLE_LIKEPOSIX_FASTSEEK requires _USE_FASTSEEK to be set in ffconf.h
+#endif
+
+#if ENABLE_LIKEPOSIX_STATIC
+#if !configSUPPORT_STATIC_ALLOCATION
+#error ENABLE_LIKEPOSIX_STATIC requires configSUPPORT_STATIC_ALLOCATION to be set in FreeRTOSConfig.h
+#endif
+#if ENABLE_LIKEPOSIX_FASTSEEK
+#error ENABLE_LIKEPOSIX_FASTSEEK allocates cluster link map tables from the heap, it cannot be used with ENABLE_LIKEPOSIX_STATIC
+#endif
+#if ENABLE_LIKEPOSIX_TMPFS
+#error ENABLE_LIKEPOSIX_TMPFS holds file data on the heap, it cannot be used with ENABLE_LIKEPOSIX_STATIC
+#endif
+#if ENABLE_LIKEPOSIX_CORK
+#error ENABLE_LIKEPOSIX_CORK allocates its buffers from the heap, it cannot be used with ENABLE_LIKEPOSIX_STATIC
+#endif
+#if ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+#error ENABLE_LIKEPOSIX_ACCEPT_SLOTS allocates its reservations from the heap, it cannot be used with ENABLE_LIKEPOSIX_STATIC, where all entries are preallocated
+#endif
+#if ENABLE_LIKEPOSIX_TIMERS
+#error ENABLE_LIKEPOSIX_TIMERS allocates its timers from the heap, it cannot be used with ENABLE_LIKEPOSIX_STATIC
+#endif
+#endif
+
 #define lock_filtab()                   (xSemaphoreTake(filtab.lock, 2000/portTICK_RATE_MS) == pdTRUE)
 #define unlock_filtab()                 xSemaphoreGive(filtab.lock)
 
@@ -175,1156 +428,4128 @@ char **__environ = __env;
 extern unsigned int _heap;
 extern unsigned int _eheap;
 caddr_t heap = NULL;
-static const unsigned short heapSTRUCT_SIZE	=
- 		( sizeof( xBlockLink ) + portBYTE_ALIGNMENT -
- 		( sizeof( xBlockLink ) % portBYTE_ALIGNMENT ) );
+static const size_t heapSTRUCT_SIZE = HEAP_BLOCK_HEADER_SIZE;
 static _filtab_t filtab;
 struct dirent _dirent;
 
+#if ENABLE_LIKEPOSIX_SOCKETS
 /**
- * to make STDIO work with serial IO,
- * please define "void phy_putc(char c)" somewhere
+ * socket translation words, filtab.sockets, hold the lwIP socket number plus 1 in the low
+ * 16 bits, 0 when the slot isn't a socket, and the slot generation in the high 16 bits,
+ * advanced each time the slot is given to a socket. they are written with the file table
+ * locked, and read without it in a single aligned 32 bit access.
  */
-extern void phy_putc(char c) __attribute__((weak));
-extern char phy_getc() __attribute__((weak));
+#define SOCKET_MAP_FD_MASK              0x0000ffffu
+#define SOCKET_MAP_GENERATION           0x00010000u
 
 /**
- * initialses likeposix state.
+ * translates a descriptor to its lwIP socket, without taking the file table lock,
+ * so that socket calls that block in lwIP don't hold up the other tasks.
+ *
+ * @param   word is set to the translation word, to pass to __check_socket().
+ * @retval  the lwIP socket number, or -1 if file is not an open socket.
  */
-void init_likeposix()
+static inline int __lookup_socket(int file, uint32_t* word)
 {
-    if(filtab.lock == NULL)
+    file -= FILE_TABLE_OFFSET;
+    if(file < 0 || file >= FILE_TABLE_LENGTH)
+        return EOF;
+    *word = filtab.sockets[file];
+    return (int)(*word & SOCKET_MAP_FD_MASK) - 1;
+}
+
+/**
+ * checks the result of an lwIP call made on a socket translated by __lookup_socket().
+ * if the descriptor was closed while the call was in progress, the call fails with EBADF,
+ * whatever lwIP returned.
+ *
+ * this doesn't make closing a socket that another task is using safe. lwIP gives the
+ * number of a closed socket to the next new socket at once, so the call may have been
+ * made on that socket, as a call racing with close() and open() may use the wrong file
+ * on any POSIX system.
+ */
+static inline int __check_socket(int file, uint32_t word, int res)
+{
+    if(filtab.sockets[file - FILE_TABLE_OFFSET] != word)
     {
-        filtab.lock = xSemaphoreCreateMutex();
-        assert_true(filtab.lock);
+        errno = EBADF;
+        return EOF;
     }
+    return res;
 }
+#endif
 
+#if ENABLE_LIKEPOSIX_STATIC
 /**
- * @param	file is a file pointer to an open device file.
- * @retval 	the file table entry for a given file descriptor,
- * 			or NULL if the file descriptor was not valid, or the file was not open.
+ * the static configuration, all structures the syscall layer would otherwise allocate
+ * from the heap, sized from likeposix_config.h.
  */
-inline filtab_entry_t* __get_entry(int file)
+typedef struct {
+    filtab_entry_t entry;
+    void* payload[2];       ///< room for the state of a socket, device or other small backend
+} small_entry_t;
+
+static small_entry_t fte_objects[FILE_TABLE_LENGTH];
+static fatfs_entry_t fatfs_objects[FATFS_FILE_TABLE_LENGTH];
+static dir_entry_t dir_objects[DIR_TABLE_LENGTH];
+static dev_ioctl_t dev_objects[DEVICE_TABLE_LENGTH];
+static StaticQueue_t dev_queues[DEVICE_TABLE_LENGTH][2];
+static uint8_t dev_queue_storage[DEVICE_TABLE_LENGTH][2][DEVICE_QUEUE_LENGTH];
+static StaticSemaphore_t filtab_lock_buffer;
+static pool_t fte_pool;
+static pool_t fatfs_pool;
+static pool_t dir_pool;
+#if ENABLE_LIKEPOSIX_EPOLL
+static epoll_watch_t watch_objects[EPOLL_WATCH_TABLE_LENGTH];
+static pool_t watch_pool;
+#define EPOLL_STATIC_FOOTPRINT          sizeof(watch_objects)
+#else
+#define EPOLL_STATIC_FOOTPRINT          0
+#endif
+
+#define LIKEPOSIX_STATIC_FOOTPRINT      (sizeof(fte_objects) + sizeof(fatfs_objects) + sizeof(dir_objects) + sizeof(dev_objects) + \
+                                         sizeof(dev_queues) + sizeof(dev_queue_storage) + EPOLL_STATIC_FOOTPRINT)
+
+#if LIKEPOSIX_STATIC_MAX_BYTES
+_Static_assert(LIKEPOSIX_STATIC_FOOTPRINT <= LIKEPOSIX_STATIC_MAX_BYTES,
+                "the static file, directory and device tables exceed LIKEPOSIX_STATIC_MAX_BYTES");
+#endif
+
+/**
+ * small entries, for sockets, devices etc, and FatFs entries come from separate pools.
+ */
+static inline filtab_entry_t* __alloc_fte(size_t size)
 {
-	if(!filtab.count || (filtab.count > FILE_TABLE_LENGTH))
-		return NULL;
+    if(size <= sizeof(small_entry_t))
+        return (filtab_entry_t*)pool_alloc(&fte_pool);
+    if(size <= sizeof(fatfs_entry_t))
+        return (filtab_entry_t*)pool_alloc(&fatfs_pool);
+    return NULL;
+}
 
-	file -= FILE_TABLE_OFFSET;
-	if(file >= 0)
-	{
-		return  filtab.tab[file];
-	}
-	return NULL;
+static inline void __free_fte(filtab_entry_t* fte)
+{
+    if((void*)fte >= (void*)fatfs_objects && (void*)fte < (void*)(fatfs_objects + FATFS_FILE_TABLE_LENGTH))
+        pool_free(&fatfs_pool, fte);
+    else
+        pool_free(&fte_pool, fte);
 }
 
+#define __alloc_dir()                   ((dir_entry_t*)pool_alloc(&dir_pool))
+#define __free_dir(dir)                 pool_free(&dir_pool, dir)
+#define __alloc_watch()                 ((epoll_watch_t*)pool_alloc(&watch_pool))
+#define __free_watch(watch)             pool_free(&watch_pool, watch)
+#else
+#define __alloc_fte(size)               ((filtab_entry_t*)pvPortMalloc(size))
+#define __free_fte(fte)                 vPortFree(fte)
+#define __alloc_dir()                   ((dir_entry_t*)malloc(sizeof(dir_entry_t)))
+#define __free_dir(dir)                 free(dir)
+#define __alloc_watch()                 ((epoll_watch_t*)pvPortMalloc(sizeof(epoll_watch_t)))
+#define __free_watch(watch)             vPortFree(watch)
+#endif
+
+#if ENABLE_LIKEPOSIX_ENCODED_VARIANTS
 /**
- * deletes the structures of a file table entry...
+ * variant lookup cache, holds the outcome of recent attempts to open <name>.gz.
+ * entries are keyed by a hash of the variant path, a hash collision only costs a
+ * failed open or a missed variant, never the wrong file.
  */
-inline void __delete_filtab_item(filtab_entry_t* fte)
+static struct {
+    uint32_t hash;          ///< hash of the variant path, 0 if the entry is unused
+    char exists;            ///< set if the variant was opened successfully
+} encoded_cache[ENCODED_VARIANT_CACHE_LENGTH];
+static unsigned int encoded_cache_next;
+static unsigned int encoded_cache_generation;   ///< incremented whenever the cache is invalidated
+#endif
+
+static const vfs_fs_t fatfs_fs;
+static const vfs_fs_t devfs_fs;
+
+#if ENABLE_LIKEPOSIX_ENCODED_VARIANTS
+/**
+ * empties the variant lookup cache, called with the file table locked whenever a file
+ * may have been created, removed or renamed.
+ */
+static inline void __encoded_invalidate()
 {
-    if((fte->mode == S_IFREG) || (fte->mode == S_IFIFO))
-    {
-        // #1 close the file
-        f_close(&fte->file);
-        // # 2 remove pipe
-        if(fte->device)
-        {
-            // remove read & write queues
-            if(fte->device->pipe.read)
-                vQueueDelete(fte->device->pipe.read);
-            if(fte->device->pipe.write)
-                vQueueDelete(fte->device->pipe.write);
-        }
-    }
-#if ENABLE_LIKEPOSIX_SOCKETS
-    else if(fte->mode == S_IFSOCK)
+    memset(encoded_cache, 0, sizeof(encoded_cache));
+    encoded_cache_generation++;
+}
+#endif
+
+/**
+ * to make STDIO work with serial IO,
+ * please define "void phy_putc(char c)" somewhere
+ */
+extern void phy_putc(char c) __attribute__((weak));
+extern char phy_getc() __attribute__((weak));
+
+/**
+ * to let realloc() grow blocks in place, the heap scheme may define
+ * "int heap_grow(void* ptr, size_t size)" - it should extend the block at ptr
+ * to at least size usable bytes by merging the free block that follows it,
+ * returning 0 on success or -1 if that isnt possible.
+ *
+ * none of the FreeRTOS heap schemes define it, their free lists are private to
+ * heap_2.c and heap_4.c, so it can only be added to a copy of one of those.
+ * without it realloc() still returns the same block while the new size fits in it,
+ * and otherwise allocates a new one and copies.
+ */
+extern int heap_grow(void* ptr, size_t size) __attribute__((weak));
+
+/**
+ * initialses likeposix state.
+ */
+void init_likeposix()
+{
+    if(filtab.lock == NULL)
     {
-        int fd = (int)fte->device;
-        if(fd != -1)
-            lwip_close(fd);
+#if ENABLE_LIKEPOSIX_STATIC
+        pool_init(&fte_pool, fte_objects, sizeof(small_entry_t), FILE_TABLE_LENGTH);
+        pool_init(&fatfs_pool, fatfs_objects, sizeof(fatfs_entry_t), FATFS_FILE_TABLE_LENGTH);
+        pool_init(&dir_pool, dir_objects, sizeof(dir_entry_t), DIR_TABLE_LENGTH);
+#if ENABLE_LIKEPOSIX_EPOLL
+        pool_init(&watch_pool, watch_objects, sizeof(epoll_watch_t), EPOLL_WATCH_TABLE_LENGTH);
+#endif
+        filtab.lock = xSemaphoreCreateMutexStatic(&filtab_lock_buffer);
+#else
+        filtab.lock = xSemaphoreCreateMutex();
+#endif
+        assert_true(filtab.lock);
+
+#if ENABLE_LIKEPOSIX_SLAB
+        slab_init();
+#endif
+
+        vfs_mount(&fatfs_fs);
+        vfs_mount(&devfs_fs);
+#if ENABLE_LIKEPOSIX_TMPFS
+        tmpfs_init();
+        vfs_mount(&tmpfs_fs);
+#endif
+#if ENABLE_LIKEPOSIX_ROMFS
+        if(romfs_init() == 0)
+            vfs_mount(&romfs_fs);
+#endif
     }
+#if ENABLE_LIKEPOSIX_LOGFILES
+    logfile_init();
+#endif
+#if ENABLE_LIKEPOSIX_RESOLVER
+    resolver_init();
+#endif
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+    clock_init();
 #endif
-	// #3 delete file table node
-	vPortFree(fte);
 }
 
 /**
- * create a new file stat structure.
- *
- * does not enter the structure in to the file table...
+ * mounts a backend at the path prefix given in fs->prefix.
  *
- * if mode contains S_IFREG, the file number returned operates on a regular file, as per the conditions
- * given in flags.
- *
- * if mode contains S_IFIFO, the file number returned operates on a pair of queues, rather than a file.
- *  - if flags contains FREAD, then a read queue of length bytes becomes available to the read() function.
- *  - if flags contains FWRITE, then a write queue of length bytes becomes available to the write() function.
- *  - the opposing ends of the queues may be interfaced to a device in a device driver module...
- *
- * @param 	fdes is a pointer to a raw file table entry, which doesnt have to be pre initialized.
- * @param	name is the name of the file, or device file to open.
- * @param	flags may be a combination of one of O_RDONLY, O_WRONLY, or O_RDWR,
- * 			and any of O_APPEND | O_CREAT | O_TRUNC | O_NONBLOCK
- * @param 	mode is one of S_IFDIR | S_IFCHR | S_IFBLK | S_IFREG | S_IFLNK | S_IFSOCK | S_IFIFO.
- * 			only S_IFREG and S_IFIFO are supported.
+ * paths are resolved to the mount with the longest matching prefix, so a backend
+ * mounted at "/tmp/" takes precedence over the FatFs root, mounted at "".
  *
- * @retval 0 on success, -1 on failure.
+ * @param   fs is the backend to mount, it must remain valid for as long as it is mounted.
+ * @retval  0 on success, or -1 if the mount table is full.
  */
-inline int __create_filtab_item(filtab_entry_t** fdes, const char* name, int flags, int mode, int length)
+int vfs_mount(const vfs_fs_t* fs)
 {
-	if(!name)
-		return EOF;
-
-	int file = EOF;
-	BYTE ff_flags = 0;
-
-	// create new file table node
-	filtab_entry_t* fte = (filtab_entry_t*)pvPortMalloc(sizeof(filtab_entry_t));
-
-	if(fte)
-	{
-		fte->mode = mode;
-		fte->device = NULL;
-		fte->flags = flags+1;
-		fte->size = length;
+    int res = EOF;
+    int i;
 
-		/**********************************
-		 * create file
-		 **********************************/
+    if(lock_filtab())
+    {
+        for(i = 0; i < VFS_MOUNT_TABLE_LENGTH; i++)
+        {
+            if(filtab.mounts[i] == NULL)
+            {
+                filtab.mounts[i] = fs;
+                res = 0;
+                break;
+            }
+        }
+        unlock_filtab();
+    }
 
-		if(fte->mode == S_IFREG)
-		{
-			if(fte->flags&FREAD)
-				ff_flags |= FA_READ;
-			if(fte->flags&FWRITE)
-				ff_flags |= FA_WRITE;
+    return res;
+}
 
-			if(fte->flags&O_CREAT)
-			{
-				if(fte->flags&O_TRUNC)
-					ff_flags |= FA_CREATE_ALWAYS;
-				else
-					ff_flags |= FA_OPEN_ALWAYS;
-			}
-			else
-				ff_flags |= FA_OPEN_EXISTING;
+/**
+ * @retval  the mounted backend that serves the specified path, or NULL if there is none.
+ *          the mount prefix matches paths that start with it, and the prefix itself without
+ *          its trailing slash, so that "/tmp" resolves to the backend mounted at "/tmp/".
+ */
+static const vfs_fs_t* __resolve(const char* path)
+{
+    const vfs_fs_t* fs = NULL;
+    size_t longest = 0;
+    size_t length;
+    int i;
 
-			// TODO can we used this flag? FA_CREATE_NEW
-		}
+    if(!path)
+        return NULL;
 
-		if(f_open(&fte->file, (const TCHAR*)name, (BYTE)ff_flags) == FR_OK)
-		{
-			if(fte->mode == S_IFREG)
-			{
-				file = 0;
-				if(fte->flags&O_APPEND)
-					f_lseek(&fte->file, f_size(&fte->file));
-			}
-			else if(fte->mode == S_IFIFO)
-			{
-				/**********************************
-				 * create data pipe
-				 **********************************/
-
-				// fetch device interface index
-				unsigned char buf[DEVICED_INTERFACE_FILE_SIZE];
-				int devindex;
-				unsigned int n = 0;
-
-				// read device index (buf[0])
-				f_read(&fte->file, buf, (UINT)DEVICED_INTERFACE_FILE_SIZE, (UINT*)&n);
-				devindex = (int)buf[0];
-
-				if(n > 0 && devindex < DEVICE_TABLE_LENGTH)
-					fte->device = filtab.devtab[devindex];
-
-				// populate "pipe", timeout values
-				if(fte->device)
-				{
-				    if(fte->flags & O_NONBLOCK)
-				        fte->device->timeout = 0;
-				    else
-				        fte->device->timeout = DEFAULT_DEVICE_TIMEOUT/portTICK_RATE_MS;
-
-					// create write device queue
-					char write_q = 1;
-					fte->device->pipe.write = NULL;
-					if(fte->flags&FWRITE)
-					{
-						fte->device->pipe.write = xQueueCreate(fte->size, 1);
-						write_q = fte->device->pipe.write ? 1 : 0;
-					}
-
-					// create read device queue
-					char read_q = 1;
-					fte->device->pipe.read = NULL;
-					if(fte->flags&FREAD)
-					{
-						fte->device->pipe.read = xQueueCreate(fte->size, 1);
-						read_q = fte->device->pipe.read ? 1 : 0;
-					}
-
-					if(read_q && write_q)
-						file = 0;
-				}
-			}
-		}
+    for(i = 0; i < VFS_MOUNT_TABLE_LENGTH && filtab.mounts[i]; i++)
+    {
+        length = strlen(filtab.mounts[i]->prefix);
 
-		if(file == 0)
-		{
-			// on success ...
-			*fdes = fte;
-		}
-		else
-		{
-			// on error...
-			__delete_filtab_item(fte);
-		}
-	}
+        if(!strncmp(path, filtab.mounts[i]->prefix, length) ||
+            (length > 0 && filtab.mounts[i]->prefix[length-1] == '/' &&
+            !strncmp(path, filtab.mounts[i]->prefix, length-1) && path[length-1] == '\0'))
+        {
+            if(!fs || length > longest)
+            {
+                fs = filtab.mounts[i];
+                longest = length;
+            }
+        }
+    }
 
-	return file;
+    return fs;
 }
 
+#if ENABLE_LIKEPOSIX_EPOLL
 /**
- * put a file table entry into file table.
- *
- * @param 	fte is a pointer to a file table entry, which NEEDS to have been pre initialized.
- * @retval 	the file number if successful, or -1 on error.
+ * adds a registration to the ready list of its instance, unless it is there already or disabled.
+ * call in a critical section.
  */
-inline int __insert_entry(filtab_entry_t* fte)
+static void __queue_watch(epoll_watch_t* watch)
 {
-	int file;
-	for(file = 0; file < FILE_TABLE_LENGTH; file++)
-	{
-		if(filtab.tab[file] == NULL)
-		{
-			filtab.tab[file] = fte;
-			filtab.count++;
-			return file + FILE_TABLE_OFFSET;
-		}
-	}
+    if(watch->queued || !__watch_events(watch))
+        return;
 
-	return EOF;
+    watch->queued = 1;
+    watch->ready_next = NULL;
+    if(watch->epoll->last)
+        watch->epoll->last->ready_next = watch;
+    else
+        watch->epoll->ready = watch;
+    watch->epoll->last = watch;
 }
 
 /**
- * remove a file table entry from the file table.
- *
- * @param	file is a file pointer to a device file.
- * @retval  0 if successful, or -1 on error.
+ * removes a registration from the ready list of its instance. call in a critical section.
  */
-inline int __remove_entry(int file)
+static void __unqueue_watch(epoll_watch_t* watch)
 {
-	if(!filtab.count || (filtab.count > FILE_TABLE_LENGTH))
+    epoll_watch_t** w;
+    epoll_watch_t* previous = NULL;
+
+    if(!watch->queued)
+        return;
+
+    for(w = &watch->epoll->ready; *w; previous = *w, w = &(*w)->ready_next)
+    {
+        if(*w == watch)
+        {
+            *w = watch->ready_next;
+            if(watch->epoll->last == watch)
+                watch->epoll->last = previous;
+            break;
+        }
+    }
+    watch->queued = 0;
+}
+
+#if ENABLE_LIKEPOSIX_SOCKETS && !ENABLE_LIKEPOSIX_SOCKET_EVENTS
+/**
+ * adds a new socket registration to its instance's socket list, with the file table locked.
+ */
+static void __link_socket_watch(epoll_watch_t* watch)
+{
+    if(watch->fte->mode == S_IFSOCK)
+    {
+        watch->socket_next = watch->epoll->sockets;
+        watch->epoll->sockets = watch;
+    }
+}
+
+/**
+ * removes a registration that is being freed from its instance's socket list, with the file table locked.
+ */
+static void __unlink_socket_watch(epoll_watch_t* watch)
+{
+    epoll_watch_t** w;
+
+    for(w = &watch->epoll->sockets; *w; w = &(*w)->socket_next)
+    {
+        if(*w == watch)
+        {
+            *w = watch->socket_next;
+            break;
+        }
+    }
+}
+#else
+#define __link_socket_watch(watch)
+#define __unlink_socket_watch(watch)
+#endif
+#endif
+
+/**
+ * wakes the tasks in select() and poll(), and those in epoll_wait() on an instance with
+ * registrations in its ready list. call in a critical section.
+ */
+static void __wake_waiters(int from_isr, BaseType_t* woken)
+{
+    vfs_waiter_t* waiter;
+
+    for(waiter = filtab.waiters; waiter; waiter = waiter->next)
+    {
+#if ENABLE_LIKEPOSIX_EPOLL
+        if(waiter->key && !((const epoll_entry_t*)waiter->key)->ready)
+            continue;
+#endif
+        if(from_isr)
+            __wake_waiter_from_isr(waiter, woken);
+        else
+            __wake_waiter(waiter);
+    }
+}
+
+/**
+ * queues the epoll registrations on a descriptor, and wakes the waiting tasks.
+ * call in a critical section, fte may be NULL.
+ */
+static void __notify_entry(filtab_entry_t* fte, int from_isr, BaseType_t* woken)
+{
+#if ENABLE_LIKEPOSIX_EPOLL
+    epoll_watch_t* watch;
+
+    for(watch = fte ? fte->watches : NULL; watch; watch = watch->next)
+        __queue_watch(watch);
+#else
+    (void)fte;
+#endif
+    __wake_waiters(from_isr, woken);
+}
+
+/**
+ * wakes the tasks sleeping in select() and poll(), so that they check their descriptors again.
+ */
+void vfs_notify()
+{
+    taskENTER_CRITICAL();
+    __notify_entry(NULL, 0, NULL);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * vfs_notify() for interrupt handlers.
+ *
+ * @param   woken is set to pdTRUE if a task was woken that should run before the
+ *          interrupted one, as for the other FromISR functions.
+ */
+void vfs_notify_from_isr(BaseType_t* woken)
+{
+    UBaseType_t state = taskENTER_CRITICAL_FROM_ISR();
+    __notify_entry(NULL, 1, woken);
+    taskEXIT_CRITICAL_FROM_ISR(state);
+}
+
+/**
+ * reports that a descriptor may have become ready, or has been closed. wakes the tasks in
+ * select() and poll(), and those in epoll_wait() on an instance the descriptor is registered with.
+ */
+void vfs_notify_entry(filtab_entry_t* fte)
+{
+    taskENTER_CRITICAL();
+    __notify_entry(fte, 0, NULL);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * vfs_notify_entry() for device drivers, called from interrupt handlers after putting data
+ * in pipe.read, or taking data from pipe.write.
+ */
+void vfs_notify_device_from_isr(dev_ioctl_t* device, BaseType_t* woken)
+{
+    UBaseType_t state = taskENTER_CRITICAL_FROM_ISR();
+    __notify_entry(device->fte, 1, woken);
+    taskEXIT_CRITICAL_FROM_ISR(state);
+}
+
+/**
+ * @param	file is a file pointer to an open device file.
+ * @retval 	the file table entry for a given file descriptor,
+ * 			or NULL if the file descriptor was not valid, or the file was not open.
+ */
+inline filtab_entry_t* __get_entry(int file)
+{
+	if(!filtab.count || (filtab.count > FILE_TABLE_LENGTH))
+		return NULL;
+
+	file -= FILE_TABLE_OFFSET;
+	if(file >= 0 && file < FILE_TABLE_LENGTH)
+	{
+		return  filtab.tab[file];
+	}
+	return NULL;
+}
+
+/**
+ * deletes the structures of a file table entry...
+ */
+inline void __delete_filtab_item(filtab_entry_t* fte)
+{
+#if ENABLE_LIKEPOSIX_EPOLL
+    epoll_watch_t* watch;
+
+    // #0 remove the descriptor from the epoll instances it is registered with
+    while(fte->watches)
+    {
+        taskENTER_CRITICAL();
+        watch = fte->watches;
+        fte->watches = watch->next;
+        __unqueue_watch(watch);
+        taskEXIT_CRITICAL();
+        __unlink_socket_watch(watch);
+        __free_watch(watch);
+    }
+#endif
+    // #1 release the backend resources
+    if(fte->ops && fte->ops->close)
+        fte->ops->close(fte);
+#if ENABLE_LIKEPOSIX_SOCKETS && ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+    // accepted sockets go back to the reservation of their listening socket
+    if(fte->mode == S_IFSOCK && __socket(fte)->owner)
+    {
+        accept_slots_t* owner = __socket(fte)->owner;
+        pool_free(&owner->pool, fte);
+        __put_slots(owner);
+        return;
+    }
+#endif
+	// #2 delete file table node
+	__free_fte(fte);
+}
+
+/**
+ * create a new file table entry.
+ *
+ * does not enter the structure in to the file table, and does not open anything -
+ * that is up to the backend, which populates the entry and sets its ops.
+ *
+ * @param	flags may be a combination of one of O_RDONLY, O_WRONLY, or O_RDWR,
+ * 			and any of O_APPEND | O_CREAT | O_TRUNC | O_NONBLOCK
+ * @param	size is the size of the entry, sizeof(filtab_entry_t) or the backend's entry_size.
+ * @retval  the new entry, zeroed apart from flags, or NULL on failure.
+ */
+inline filtab_entry_t* __create_filtab_item(int flags, size_t size)
+{
+	// create new file table node
+	filtab_entry_t* fte = __alloc_fte(size);
+
+	if(fte)
+	{
+		memset(fte, 0, size);
+		fte->flags = flags+1;
+	}
+
+	return fte;
+}
+
+/**
+ * put a file table entry into file table.
+ *
+ * @param 	fte is a pointer to a file table entry, which NEEDS to have been pre initialized.
+ * @retval 	the file number if successful, or -1 on error.
+ */
+inline int __insert_entry(filtab_entry_t* fte)
+{
+	int file;
+	for(file = 0; file < FILE_TABLE_LENGTH; file++)
+	{
+		if(filtab.tab[file] == NULL)
+		{
+			filtab.tab[file] = fte;
+			filtab.count++;
+			return file + FILE_TABLE_OFFSET;
+		}
+	}
+
+	return EOF;
+}
+
+/**
+ * remove a file table entry from the file table.
+ *
+ * @param	file is a file pointer to a device file.
+ * @retval  0 if successful, or -1 on error.
+ */
+inline int __remove_entry(int file)
+{
+	if(!filtab.count || (filtab.count > FILE_TABLE_LENGTH))
+		return EOF;
+
+	filtab.tab[file-FILE_TABLE_OFFSET] = NULL;
+#if ENABLE_LIKEPOSIX_SOCKETS
+	// unmap any socket before it is closed, keeping the generation
+	filtab.sockets[file-FILE_TABLE_OFFSET] &= ~SOCKET_MAP_FD_MASK;
+#endif
+	filtab.count--;
+	return 0;
+}
+
+/**********************************
+ * FatFs regular files
+ **********************************/
+
+#if ENABLE_LIKEPOSIX_FASTSEEK
+/**
+ * builds the FatFs cluster link map table for a file, so that seeks no longer follow
+ * the FAT chain from the start of the file.
+ *
+ * only done once per file table entry, for read only files of at least FASTSEEK_MIN_FILE_SIZE
+ * bytes - FatFs cannot grow a file while in fast seek mode.
+ * the table is sized to fit the file exactly, up to FASTSEEK_MAX_CLMT_LENGTH items,
+ * and is freed along with the file table entry.
+ */
+static void __build_clmt(filtab_entry_t* fte)
+{
+    fatfs_entry_t* entry = __fatfs(fte);
+    DWORD probe[1];
+    DWORD length;
+
+    entry->clmt_tried = 1;
+
+    if((fte->flags & FWRITE) || (f_size(&entry->file) < FASTSEEK_MIN_FILE_SIZE))
+        return;
+
+    // measure the table size required, FatFs writes it into item 0
+    probe[0] = 1;
+    entry->file.cltbl = probe;
+    f_lseek(&entry->file, CREATE_LINKMAP);
+    entry->file.cltbl = NULL;
+    length = probe[0];
+
+    if(length > FASTSEEK_MAX_CLMT_LENGTH)
+        return;
+
+    entry->clmt = (DWORD*)pvPortMalloc(length * sizeof(DWORD));
+    if(entry->clmt)
+    {
+        entry->clmt[0] = length;
+        entry->file.cltbl = entry->clmt;
+        if(f_lseek(&entry->file, CREATE_LINKMAP) != FR_OK)
+        {
+            entry->file.cltbl = NULL;
+            vPortFree(entry->clmt);
+            entry->clmt = NULL;
+        }
+    }
+}
+#endif
+
+static int fatfs_read(filtab_entry_t* fte, char* buffer, int count)
+{
+    int n = 0;
+    if(f_read(&__fatfs(fte)->file, (void*)buffer, (UINT)count, (UINT*)&n) != FR_OK && n == 0)
+        n = EOF;
+    return n;
+}
+
+/**
+ * with O_APPEND every write goes to the end of the file, wherever the descriptor was seeked to.
+ * appends through other descriptors on the same file are not seen, each has its own FIL,
+ * see logfile.h for files that several tasks append to.
+ */
+static int fatfs_write(filtab_entry_t* fte, const char* buffer, int count)
+{
+    int n = EOF;
+    if((fte->flags & O_APPEND) && f_lseek(&__fatfs(fte)->file, f_size(&__fatfs(fte)->file)) != FR_OK)
+        return EOF;
+    if(f_write(&__fatfs(fte)->file, (const void*)buffer, (UINT)count, (UINT*)&n) != FR_OK)
+        n = EOF;
+    return n;
+}
+
+/**
+ * when ENABLE_LIKEPOSIX_FASTSEEK is set, the first seek on a large read only file
+ * builds a cluster link map table, making that seek and all following ones O(1).
+ */
+static int fatfs_lseek(filtab_entry_t* fte, int offset, int whence)
+{
+    if(whence == SEEK_CUR)
+        offset = f_tell(&__fatfs(fte)->file) + offset;
+    else if(whence == SEEK_END)
+        offset = f_size(&__fatfs(fte)->file) + offset;
+
+#if ENABLE_LIKEPOSIX_FASTSEEK
+    if(!__fatfs(fte)->clmt_tried && ((DWORD)offset != f_tell(&__fatfs(fte)->file)))
+        __build_clmt(fte);
+#endif
+
+    if(offset < 0 || f_lseek(&__fatfs(fte)->file, offset) != FR_OK)
+        return EOF;
+    return f_tell(&__fatfs(fte)->file);
+}
+
+static int fatfs_fstat(filtab_entry_t* fte, struct stat* st)
+{
+    st->st_size = f_size(&__fatfs(fte)->file);
+    return 0;
+}
+
+static int fatfs_fsync(filtab_entry_t* fte)
+{
+    return f_sync(&__fatfs(fte)->file) == FR_OK ? 0 : EOF;
+}
+
+static int fatfs_close(filtab_entry_t* fte)
+{
+    int res = f_close(&__fatfs(fte)->file) == FR_OK ? 0 : EOF;
+#if ENABLE_LIKEPOSIX_FASTSEEK
+    if(__fatfs(fte)->clmt)
+        vPortFree(__fatfs(fte)->clmt);
+#endif
+    return res;
+}
+
+static int fatfs_poll(filtab_entry_t* fte)
+{
+    (void)fte;
+    return VFS_POLLIN|VFS_POLLOUT;
+}
+
+static const vfs_ops_t fatfs_ops = {
+    .read = fatfs_read,
+    .write = fatfs_write,
+    .lseek = fatfs_lseek,
+    .fstat = fatfs_fstat,
+    .fsync = fatfs_fsync,
+    .close = fatfs_close,
+    .poll = fatfs_poll,
+};
+
+#if ENABLE_LIKEPOSIX_LOGFILES
+/**
+ * @retval	1 if an open with these flags attaches to a shared log file, that is
+ * 			write only with O_APPEND under LOGFILE_DIRECTORY, otherwise 0.
+ */
+static int __is_logfile(const char* name, int flags)
+{
+	return ((flags & (FREAD|FWRITE)) == FWRITE) &&
+			(flags & O_APPEND) &&
+			(startswith(name, LOGFILE_DIRECTORY) == 0);
+}
+
+/**
+ * log file descriptors hold no FIL, the log file has its own.
+ */
+static size_t fatfs_entry_size(const char* name, int flags)
+{
+	return __is_logfile(name, flags) ? sizeof(filtab_entry_t) : sizeof(fatfs_entry_t);
+}
+#endif
+
+/**
+ * opens a regular file on the FatFs volume.
+ *
+ * files opened write only with O_APPEND under LOGFILE_DIRECTORY are attached to
+ * a shared log file instead, when ENABLE_LIKEPOSIX_LOGFILES is set.
+ */
+static int fatfs_open(filtab_entry_t* fte, const char* name, int flags, int length)
+{
+	BYTE ff_flags = 0;
+	(void)length;
+
+	fte->mode = S_IFREG;
+
+#if ENABLE_LIKEPOSIX_LOGFILES
+	if(__is_logfile(name, flags))
+	{
+		fte->ctx = logfile_open(name, flags);
+		if(!fte->ctx)
+			return EOF;
+		fte->ops = &logfile_ops;
+		return 0;
+	}
+#endif
+
+	if(flags&FREAD)
+		ff_flags |= FA_READ;
+	if(flags&FWRITE)
+		ff_flags |= FA_WRITE;
+
+	if(flags&O_CREAT)
+	{
+		if(flags&O_TRUNC)
+			ff_flags |= FA_CREATE_ALWAYS;
+		else
+			ff_flags |= FA_OPEN_ALWAYS;
+	}
+	else
+		ff_flags |= FA_OPEN_EXISTING;
+
+	// TODO can we used this flag? FA_CREATE_NEW
+
+	if(f_open(&__fatfs(fte)->file, (const TCHAR*)name, (BYTE)ff_flags) != FR_OK)
 		return EOF;
 
-	filtab.tab[file-FILE_TABLE_OFFSET] = NULL;
-	filtab.count--;
-	return 0;
+	fte->ops = &fatfs_ops;
+	if(flags&O_APPEND)
+		f_lseek(&__fatfs(fte)->file, f_size(&__fatfs(fte)->file));
+
+	return 0;
+}
+
+static int fatfs_stat(const char* path, struct stat* st)
+{
+    FILINFO info;
+
+    info.lfname = NULL;
+    info.lfsize = 0;
+
+    if(f_stat((const TCHAR*)path, &info) != FR_OK)
+        return EOF;
+
+    st->st_size = info.fsize;
+    st->st_mode = (info.fattrib & AM_DIR) ? S_IFDIR : S_IFREG;
+    return 0;
+}
+
+static int fatfs_unlink(const char* path)
+{
+    return f_unlink((const TCHAR*)path) == FR_OK ? 0 : EOF;
+}
+
+static int fatfs_rename(const char* oldpath, const char* newpath)
+{
+    return f_rename((const TCHAR*)oldpath, (const TCHAR*)newpath) == FR_OK ? 0 : EOF;
+}
+
+static int fatfs_mkdir(const char* path)
+{
+    return f_mkdir((const TCHAR*)path) == FR_OK ? 0 : EOF;
+}
+
+static int fatfs_opendir(dir_entry_t* dir, const char* path)
+{
+    return f_opendir(&dir->dir, (const TCHAR*)path) == FR_OK ? 0 : EOF;
+}
+
+static int fatfs_readdir(dir_entry_t* dir, struct dirent* ent)
+{
+    FILINFO info;
+
+    info.lfname = ent->d_name;
+    info.lfsize = sizeof(ent->d_name);
+
+    if(f_readdir(&dir->dir, &info) != FR_OK || !info.fname[0])
+        return EOF;
+
+    if(ent->d_name[0] == '\0')
+        strcpy(ent->d_name, info.fname);
+
+    if(info.fattrib & AM_DIR)
+        ent->d_type = DT_DIR;
+
+    return 0;
+}
+
+static const vfs_fs_t fatfs_fs = {
+    .prefix = "",
+    .entry_size = sizeof(fatfs_entry_t),
+#if ENABLE_LIKEPOSIX_LOGFILES
+    .entry_size_of = fatfs_entry_size,
+#endif
+    .open = fatfs_open,
+    .stat = fatfs_stat,
+    .unlink = fatfs_unlink,
+    .rename = fatfs_rename,
+    .mkdir = fatfs_mkdir,
+    .opendir = fatfs_opendir,
+    .readdir = fatfs_readdir,
+    .closedir = NULL,
+};
+
+/**********************************
+ * device files
+ **********************************/
+
+static int dev_read(filtab_entry_t* fte, char* buffer, int count)
+{
+    dev_ioctl_t* device = __device(fte);
+    unsigned int timeout = (fte->flags & O_NONBLOCK) ? 0 : device->timeout;
+    int n;
+
+    for(n = 0; n < count; n++)
+    {
+        if(xQueueReceive(device->pipe.read, buffer++, timeout) != pdTRUE)
+            break;
+        timeout = 0;
+    }
+    // other descriptors on the queue, and epoll registrations, see it change
+    if(n > 0)
+        vfs_notify_entry(fte);
+    return n;
+}
+
+static int dev_write(filtab_entry_t* fte, const char* buffer, int count)
+{
+    dev_ioctl_t* device = __device(fte);
+    unsigned int timeout = (fte->flags & O_NONBLOCK) ? 0 : device->timeout;
+    int n;
+
+    for(n = 0; n < count; n++)
+    {
+        if(xQueueSend(device->pipe.write, buffer++, timeout) != pdTRUE)
+            break;
+        timeout = 0;
+    }
+    // enable the physical device to write
+    if(device->write_enable)
+        device->write_enable(device);
+    if(n > 0)
+        vfs_notify_entry(fte);
+    return n;
+}
+
+/**
+ * st_size is set to the queue length.
+ */
+static int dev_fstat(filtab_entry_t* fte, struct stat* st)
+{
+    dev_ioctl_t* device = __device(fte);
+    QueueHandle_t queue = device->pipe.read ? device->pipe.read : device->pipe.write;
+    st->st_size = queue ? uxQueueMessagesWaiting(queue) + uxQueueSpacesAvailable(queue) : 0;
+    return 0;
+}
+
+/**
+ * disables device IO, then removes the pipe.
+ */
+static int dev_close(filtab_entry_t* fte)
+{
+    dev_ioctl_t* device = __device(fte);
+
+    taskENTER_CRITICAL();
+    device->fte = NULL;
+    taskEXIT_CRITICAL();
+
+    if(device->close)
+        device->close(device);
+
+    // remove read & write queues
+    if(device->pipe.read)
+        vQueueDelete(device->pipe.read);
+    if(device->pipe.write)
+        vQueueDelete(device->pipe.write);
+    device->pipe.read = NULL;
+    device->pipe.write = NULL;
+    return 0;
+}
+
+static int dev_poll(filtab_entry_t* fte)
+{
+    dev_ioctl_t* device = __device(fte);
+    int events = 0;
+
+    if(device->pipe.read && uxQueueMessagesWaiting(device->pipe.read) > 0)
+        events |= VFS_POLLIN;
+    if(device->pipe.write && uxQueueSpacesAvailable(device->pipe.write) > 0)
+        events |= VFS_POLLOUT;
+    return events;
+}
+
+static const vfs_ops_t dev_ops = {
+    .read = dev_read,
+    .write = dev_write,
+    .lseek = NULL,
+    .fstat = dev_fstat,
+    .fsync = NULL,
+    .close = dev_close,
+    .poll = dev_poll,
+};
+
+/**
+ * opens a device file.
+ *
+ * the device file holds an index into filtab.devtab, written by install_device().
+ * a pair of queues of length bytes is created, for FREAD and/or FWRITE, these
+ * are the "pipe" through which the device driver and the application communicate.
+ */
+static int dev_open(filtab_entry_t* fte, const char* name, int flags, int length)
+{
+	FIL f;
+	unsigned char buf[DEVICED_INTERFACE_FILE_SIZE];
+	unsigned int n = 0;
+	dev_ioctl_t* device = NULL;
+
+	fte->mode = S_IFIFO;
+
+	// fetch device interface index
+	if(f_open(&f, (const TCHAR*)name, FA_READ|FA_OPEN_EXISTING) != FR_OK)
+		return EOF;
+	// read device index (buf[0])
+	f_read(&f, buf, (UINT)DEVICED_INTERFACE_FILE_SIZE, (UINT*)&n);
+	f_close(&f);
+
+	if(n > 0 && buf[0] < DEVICE_TABLE_LENGTH)
+		device = filtab.devtab[buf[0]];
+	if(!device)
+		return EOF;
+
+	// populate "pipe", timeout values. O_NONBLOCK is held in fte->flags, per descriptor
+	device->timeout = DEFAULT_DEVICE_TIMEOUT/portTICK_RATE_MS;
+
+	device->pipe.write = NULL;
+	device->pipe.read = NULL;
+#if ENABLE_LIKEPOSIX_STATIC
+	if(length <= 0 || length > DEVICE_QUEUE_LENGTH)
+		length = DEVICE_QUEUE_LENGTH;
+	// create write device queue
+	if(flags&FWRITE)
+		device->pipe.write = xQueueCreateStatic(length, 1, dev_queue_storage[buf[0]][0], &dev_queues[buf[0]][0]);
+	// create read device queue
+	if(flags&FREAD)
+		device->pipe.read = xQueueCreateStatic(length, 1, dev_queue_storage[buf[0]][1], &dev_queues[buf[0]][1]);
+#else
+	// create write device queue
+	if(flags&FWRITE)
+		device->pipe.write = xQueueCreate(length, 1);
+	// create read device queue
+	if(flags&FREAD)
+		device->pipe.read = xQueueCreate(length, 1);
+#endif
+
+	if(((flags&FWRITE) && !device->pipe.write) || ((flags&FREAD) && !device->pipe.read))
+	{
+		if(device->pipe.read)
+			vQueueDelete(device->pipe.read);
+		if(device->pipe.write)
+			vQueueDelete(device->pipe.write);
+		device->pipe.read = NULL;
+		device->pipe.write = NULL;
+		return EOF;
+	}
+
+	fte->ctx = device;
+	fte->ops = &dev_ops;
+	taskENTER_CRITICAL();
+	device->fte = fte;
+	taskEXIT_CRITICAL();
+
+	// call device open
+	if(device->open)
+		device->open(device);
+	// enable reading
+	if((flags & FREAD) && device->read_enable)
+		device->read_enable(device);
+	// writing is enabled in _write()...
+
+	return 0;
+}
+
+static int dev_stat(const char* path, struct stat* st)
+{
+    if(fatfs_stat(path, st) != 0)
+        return EOF;
+
+    if(st->st_mode == S_IFREG)
+    {
+        st->st_mode = S_IFIFO;
+        st->st_size = 0;
+    }
+    return 0;
+}
+
+static const vfs_fs_t devfs_fs = {
+    .prefix = DEVICE_INTERFACE_DIRECTORY,
+    .entry_size = sizeof(filtab_entry_t),
+    .open = dev_open,
+    .stat = dev_stat,
+    .unlink = fatfs_unlink,
+    .rename = fatfs_rename,
+    .mkdir = fatfs_mkdir,
+    .opendir = fatfs_opendir,
+    .readdir = fatfs_readdir,
+    .closedir = NULL,
+};
+
+/**
+ * installs a device for use by the application.
+ *
+ * an index into filtab.devtab is written into the device file,
+ * this index is used by open() to interface a one of filtab.tab to one of filtab.devtab.
+ *
+ * @param	name is the full path to the file to associate with the device.
+ * @param	dev_ctx is a pointer to some data that will be passed to the device driver
+ *			driver ioctl functions.
+ * @param	read_enable is an ioctl function that can enable a device to read data.
+ * @param	write_enable is an ioctl function that can enable a device to write data.
+ * @param   open is an ioctl function that can enable a device.
+ * @param	close is an ioctl function that can disable a device.
+ * @param	ioctl is an ioctl function that can set the hardware settings of a device.
+ * @retval	returns a pointer to the created dev_ioctl_t structure, or NULL on error.
+ */
+dev_ioctl_t* install_device(char* name,
+					void* dev_ctx,
+					dev_ioctl_fn_t read_enable,
+					dev_ioctl_fn_t write_enable,
+                    dev_ioctl_fn_t open_dev,
+					dev_ioctl_fn_t close_dev,
+					dev_ioctl_fn_t ioctl)
+{
+	FIL f;
+	unsigned char buf[DEVICED_INTERFACE_FILE_SIZE];
+	int device;
+	dev_ioctl_t* ret = NULL;
+	unsigned int n = 0;
+
+	log_syslog(NULL, "installing %s...", name);
+
+	// try to create the directory first, if it fails it is already there
+	// or, the disk isnt in. the next step will also fail in that case.
+	f_mkdir(DEVICE_INTERFACE_DIRECTORY);
+
+    // is it possible to open the device file?
+    if(f_open(&f, (const TCHAR*)name, FA_WRITE|FA_OPEN_ALWAYS) == FR_OK)
+    {
+        for(device = 0; device < DEVICE_TABLE_LENGTH; device++)
+        {
+            // found an empty slot
+            if(filtab.devtab[device] == NULL)
+            {
+                // todo, add better logic to write the file only if it is out of date/not exists
+                // install devno in file
+                buf[0] = (unsigned char)device;
+                if((f_write(&f, buf, (UINT)1, (UINT*)&n) == FR_OK) && (n == 1))
+                {
+                    // create device io structure and populate api
+#if ENABLE_LIKEPOSIX_STATIC
+                    filtab.devtab[device] = &dev_objects[device];
+#else
+                    filtab.devtab[device] = pvPortMalloc(sizeof(dev_ioctl_t));
+#endif
+                    if(filtab.devtab[device])
+                    {
+                        // note that filtab.devtab[device]->pipe is populated by _open()
+                        filtab.devtab[device]->timeout = 0;
+                        filtab.devtab[device]->read_enable = read_enable;
+                        filtab.devtab[device]->write_enable = write_enable;
+                        filtab.devtab[device]->ioctl = ioctl;
+                        filtab.devtab[device]->open = open_dev;
+                        filtab.devtab[device]->close = close_dev;
+                        filtab.devtab[device]->ctx = dev_ctx;
+                        filtab.devtab[device]->termios = NULL;
+                        filtab.devtab[device]->fte = NULL;
+                    }
+                    ret = filtab.devtab[device];
+                    log_syslog(NULL, "%s OK", name);
+                }
+                else
+                    log_error(NULL, "failed to write device %s", name);
+
+                break;
+            }
+        }
+        f_close(&f);
+    }
+    else
+        log_error(NULL, "failed to open device %s", name);
+
+	return ret;
+}
+
+/**
+ * system call, 'open'
+ *
+ * opens a file for disk IO, or a FreeRTOS Queue, for
+ * device IO or data transfer/sharing.
+ *
+ * **this is a non standard implementation**
+ *
+ * @param	the name of the file to open
+ * @param	flags -
+ * 			if mode is S_IFREG, may be a combination of:
+ *  		one of O_RDONLY, O_WRONLY, or O_RDWR,
+ * 			and any of O_APPEND | O_CREAT | O_TRUNC
+ * @param	mode - repurposed - in the case of device files, specified the queue length.
+ * 			otherwise ignored.
+ * @retval	returns a file descriptor, that may be used with
+ * 			read(), write(), close(), or -1 if there was an error.
+ */
+int _open(const char *name, int flags, int mode)
+{
+    int file = EOF;
+    const vfs_fs_t* fs;
+    filtab_entry_t* fte;
+
+	if(filtab.count > FILE_TABLE_LENGTH)
+		return EOF;
+
+	if(lock_filtab())
+	{
+	    // resolve the backend once, from here on the entry ops are used
+	    fs = __resolve(name);
+	    if(fs && fs->open)
+	        fte = __create_filtab_item(flags, fs->entry_size_of ? fs->entry_size_of(name, flags + 1) : fs->entry_size);
+	    else
+	        fte = NULL;
+
+	    if(fte)
+	    {
+#if ENABLE_LIKEPOSIX_ENCODED_VARIANTS
+	        // a file may be created, drop cached variant lookups
+	        if(flags & O_CREAT)
+	            __encoded_invalidate();
+#endif
+
+	        // if we got 0 here it means the backend opened the file successfully
+	        // now need to add the file table entry to the descriptor table
+	        if(fs->open(fte, name, fte->flags, mode) == 0)
+	            file = __insert_entry(fte);
+
+	        // open or add failed, delete
+	        if(file == EOF)
+	            __delete_filtab_item(fte);
+	    }
+        unlock_filtab();
+	}
+
+	return file;
+}
+
+#if ENABLE_LIKEPOSIX_ENCODED_VARIANTS
+static uint32_t __encoded_hash(const char* path)
+{
+    // FNV-1a, 0 is reserved for unused cache entries
+    uint32_t hash = 2166136261u;
+    while(*path)
+        hash = (hash ^ (unsigned char)*path++) * 16777619u;
+    return hash ? hash : 1;
+}
+
+/**
+ * opens a file for reading, or its pre-compressed sibling <name>.gz if the caller
+ * accepts gzip encoding and the sibling exists.
+ *
+ * whether the sibling exists is cached, so repeated opens of a file that has no
+ * variant cost a single open. the cache is dropped whenever a file is created,
+ * removed or renamed.
+ *
+ * **this is a non standard function**
+ *
+ * @param	name is the name of the file to open.
+ * @param	flags - must be O_RDONLY, optionally with O_NONBLOCK. anything else just opens name.
+ * @param	accepted is a combination of the CONTENT_ENCODING_xxx values the caller can handle.
+ * @param	encoding is set to the encoding of the file that was opened, CONTENT_ENCODING_IDENTITY
+ * 			or CONTENT_ENCODING_GZIP.
+ * @retval	returns a file descriptor, or -1 if there was an error.
+ */
+int open_encoded(const char* name, int flags, int accepted, int* encoding)
+{
+    char path[ENCODED_VARIANT_PATH_LENGTH];
+    uint32_t hash;
+    unsigned int generation = 0;
+    int exists = -1;
+    int file = EOF;
+    int i;
+
+    *encoding = CONTENT_ENCODING_IDENTITY;
+
+    if(!name || (flags & (O_WRONLY|O_RDWR|O_CREAT|O_TRUNC|O_APPEND)) || !(accepted & CONTENT_ENCODING_GZIP) ||
+        (snprintf(path, sizeof(path), "%s.gz", name) >= (int)sizeof(path)))
+        return _open(name, flags, 0);
+
+    hash = __encoded_hash(path);
+
+    if(lock_filtab())
+    {
+        for(i = 0; i < ENCODED_VARIANT_CACHE_LENGTH; i++)
+        {
+            if(encoded_cache[i].hash == hash)
+            {
+                exists = encoded_cache[i].exists;
+                break;
+            }
+        }
+        generation = encoded_cache_generation;
+        unlock_filtab();
+    }
+
+    if(exists != 0)
+    {
+        file = _open(path, flags, 0);
+
+        // cache the outcome, unless the cache was dropped while the file was being opened
+        if(exists == -1 && lock_filtab())
+        {
+            if(generation == encoded_cache_generation)
+            {
+                encoded_cache[encoded_cache_next].hash = hash;
+                encoded_cache[encoded_cache_next].exists = file != EOF;
+                encoded_cache_next = (encoded_cache_next + 1) % ENCODED_VARIANT_CACHE_LENGTH;
+            }
+            unlock_filtab();
+        }
+    }
+
+    if(file != EOF)
+        *encoding = CONTENT_ENCODING_GZIP;
+    else
+        file = _open(name, flags, 0);
+
+    return file;
+}
+#endif
+
+#if ENABLE_LIKEPOSIX_TIMERS
+static void __delete_closed_timers(void);
+#endif
+
+/**
+ * close the specified file descriptor.
+ *
+ * @param	file is the file descriptor to close.
+ * @retval 	0 on success, -1 on error.
+ */
+int _close(int file)
+{
+	int res = EOF;
+    if(lock_filtab())
+    {
+        filtab_entry_t* fte = __get_entry(file);
+        if(fte)
+        {
+            // remove the file table entry
+            res = __remove_entry(file);
+            // then close the backend and delete all the file structures
+            __delete_filtab_item(fte);
+        }
+        unlock_filtab();
+    }
+#if ENABLE_LIKEPOSIX_TIMERS
+    // timerfd timers are deleted once the table is unlocked
+    __delete_closed_timers();
+#endif
+    // tasks waiting on the descriptor find out that it has gone
+    if(res == 0)
+        vfs_notify();
+	return res;
+}
+
+/**
+ * writes a buffer to the file specified.
+ *
+ * @param	file is a file descriptor, may be the value returned by
+ * 			a call to the open() syscall, or STDOUT_FILENO or STDERR_FILENO.
+ * @param	a buffer of characters to write.
+ * @param	count, the number of characters to write.file
+ * @retval	the number of characters written or -1 on error.
+ */
+int _write(int file, char *buffer, unsigned int count)
+{
+	int n = EOF;
+#if ENABLE_LIKEPOSIX_SOCKETS
+	uint32_t word;
+	int fd;
+#endif
+
+	if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
+	{
+		for(n = 0; n < (int)count; n++)
+			phy_putc(*buffer++);
+	}
+#if ENABLE_LIKEPOSIX_SOCKETS
+	else if((fd = __lookup_socket(file, &word)) != EOF)
+#if ENABLE_LIKEPOSIX_CORK
+		n = send(file, buffer, count, 0);
+#else
+		n = __check_socket(file, word, lwip_write(fd, buffer, (int)count));
+#endif
+#endif
+	else if(lock_filtab())
+	{
+		filtab_entry_t* fte = __get_entry(file);
+
+		if(fte && (fte->flags & FWRITE) && fte->ops->write)
+			n = fte->ops->write(fte, buffer, (int)count);
+
+		unlock_filtab();
+	}
+
+	return n;
+}
+
+/**
+ * reads a number of characters into a buffer from the file specified.
+ *
+ * @param	file is a file descriptor, may be the value returned by
+ * 			a call to the open() syscall, or STDIN_FILENO
+ * @param	a buffer for the characters to read.
+ * @param	count, the number of characters to read.
+ * @retval	the number of characters read or -1 on error.
+ */
+int _read(int file, char *buffer, int count)
+{
+	int n = EOF;
+	int wait = 0;
+	struct pollfd pfd = {file, POLLIN, 0};
+#if ENABLE_LIKEPOSIX_SOCKETS
+	uint32_t word;
+	int fd;
+#endif
+
+	if(file == STDIN_FILENO || file == (intptr_t)stdin)
+	{
+		for(n = 0; n < count; n++)
+			*buffer++ = phy_getc();
+	}
+#if ENABLE_LIKEPOSIX_SOCKETS
+	else if((fd = __lookup_socket(file, &word)) != EOF)
+		n = __check_socket(file, word, lwip_read(fd, buffer, count));
+#endif
+	else
+	{
+		// a backend that can't block with the table locked fails with EAGAIN,
+		// a blocking descriptor then waits for it to become readable.
+		do {
+			filtab_entry_t* fte;
+
+			if(!lock_filtab())
+				break;
+
+			fte = __get_entry(file);
+			if(fte && (fte->flags & FREAD) && fte->ops->read)
+			{
+				n = fte->ops->read(fte, buffer, count);
+				wait = n == EOF && errno == EAGAIN && !(fte->flags & O_NONBLOCK) && fte->ops->poll;
+			}
+			else
+				wait = 0;
+
+			unlock_filtab();
+		} while(wait && poll(&pfd, 1, -1) > 0 && !(pfd.revents & POLLNVAL));
+	}
+
+	return n;
+}
+
+int fsync(int file)
+{
+	int res = EOF;
+	if(file == STDIN_FILENO ||
+			file == STDOUT_FILENO ||
+			file == STDERR_FILENO ||
+			file == (intptr_t)stdout ||
+			file == (intptr_t)stderr ||
+			file == (intptr_t)stdin)
+	{
+		res = 0;
+	}
+	else if(lock_filtab())
+	{
+		filtab_entry_t* fte = __get_entry(file);
+
+		if(fte && fte->ops->fsync)
+			res = fte->ops->fsync(fte);
+
+        unlock_filtab();
+	}
+
+	return res;
+}
+
+/**
+ * gets or sets the file status flags of a descriptor.
+ *
+ * F_GETFL returns the access mode, and O_APPEND and O_NONBLOCK if set.
+ * F_SETFL sets or clears O_NONBLOCK, other flags are ignored. a non blocking device
+ * descriptor reads and writes whatever the queues allow at once, a non blocking socket
+ * returns EWOULDBLOCK rather than waiting, and a non blocking timerfd read fails with EAGAIN
+ * rather than waiting for the timer to expire. regular files never block, the flag is just kept.
+ * stdin, stdout and stderr report O_RDONLY or O_WRONLY. phy_getc() and phy_putc() always wait,
+ * so setting O_NONBLOCK on them fails with EINVAL.
+ * F_GETFD and F_SETFD are accepted, there is no exec() so there are no descriptor flags.
+ *
+ * @param	file is the file descriptor.
+ * @param	cmd is one of F_GETFL, F_SETFL, F_GETFD, F_SETFD.
+ * @param	... is the new flags, an int, for F_SETFL and F_SETFD.
+ * @retval	the flags for F_GETFL, otherwise 0, or -1 on error.
+ */
+int fcntl(int file, int cmd, ...)
+{
+	int res = EOF;
+	int arg = 0;
+	va_list ap;
+
+	// F_GETFL and F_GETFD take no argument
+	if(cmd == F_SETFL || cmd == F_SETFD)
+	{
+		va_start(ap, cmd);
+		arg = va_arg(ap, int);
+		va_end(ap);
+	}
+
+	if(cmd != F_GETFL && cmd != F_SETFL && cmd != F_GETFD && cmd != F_SETFD)
+	{
+		errno = EINVAL;
+		return EOF;
+	}
+
+	if(file == STDIN_FILENO ||
+			file == STDOUT_FILENO ||
+			file == STDERR_FILENO ||
+			file == (intptr_t)stdout ||
+			file == (intptr_t)stderr ||
+			file == (intptr_t)stdin)
+	{
+		if(cmd == F_GETFL)
+			res = (file == STDIN_FILENO || file == (intptr_t)stdin) ? O_RDONLY : O_WRONLY;
+		else if(cmd == F_SETFL && (arg & O_NONBLOCK))
+			errno = EINVAL;
+		else
+			res = 0;
+	}
+	else if(lock_filtab())
+	{
+		filtab_entry_t* fte = __get_entry(file);
+
+		if(!fte)
+			errno = EBADF;
+		else if(cmd == F_GETFL)
+			res = (fte->flags - 1) & (O_ACCMODE|O_APPEND|O_NONBLOCK);
+		else if(cmd == F_SETFL)
+		{
+			res = 0;
+#if ENABLE_LIKEPOSIX_SOCKETS
+			if(fte->mode == S_IFSOCK)
+			{
+				// FIONBIO rather than lwip_fcntl(), lwIP may have been built with its own O_NONBLOCK value
+				int nonblocking = (arg & O_NONBLOCK) ? 1 : 0;
+				res = lwip_ioctl(__socket_fd(fte), FIONBIO, &nonblocking);
+			}
+#endif
+			if(res == 0)
+				fte->flags = (fte->flags & ~O_NONBLOCK) | (arg & O_NONBLOCK);
+		}
+		else
+			res = 0;
+
+		unlock_filtab();
+	}
+
+	return res;
+}
+
+/**
+ * gets the current working directory - follows the GNU version
+ * in that id buffer is set to NULL, a buffer of size bytes is allocated
+ * to hold the cwd string. it must be freed afterward by the user...
+ * in the static configuration buffer must not be NULL.
+ */
+char* getcwd(char* buffer, size_t size)
+{
+    char* allocated = NULL;
+
+    if(buffer == NULL)
+    {
+#if ENABLE_LIKEPOSIX_STATIC
+        errno = EINVAL;
+        return NULL;
+#else
+        buffer = allocated = malloc(size);
+        if(!buffer)
+            return NULL;
+#endif
+    }
+
+    if(f_getcwd((TCHAR*)buffer, (UINT)size) != FR_OK)
+    {
+        free(allocated);
+        buffer = NULL;
+    }
+
+    return buffer;
+}
+
+/**
+ * allocates and populates a DIR info struct.
+ * returns NULL if there was no memory allocated or the directory specified didnt exist.
+ * the directory must be closed with closedir() by the user.
+ */
+DIR* opendir(const char *name)
+{
+    const vfs_fs_t* fs = __resolve(name);
+    dir_entry_t* dir = NULL;
+
+    if(fs && fs->opendir)
+    {
+        dir = __alloc_dir();
+        if(dir)
+        {
+            dir->fs = fs;
+            dir->index = 0;
+            dir->ctx = NULL;
+            if(fs->opendir(dir, name) != 0)
+            {
+                __free_dir(dir);
+                dir = NULL;
+            }
+        }
+    }
+
+    return (DIR*)dir;
+}
+/**
+ * closes a directory opened with opendir.
+ * returns 0 on success, or -1 on error.
+ */
+int closedir(DIR *dirp)
+{
+    dir_entry_t* dir = (dir_entry_t*)dirp;
+
+    if(dir)
+    {
+        if(dir->fs->closedir)
+            dir->fs->closedir(dir);
+        __free_dir(dir);
+    }
+
+    return 0;
+}
+
+/**
+ * reads directory info. returns a pointer to a struct dirent,
+ * as long as there are entries in the directory.
+ * returns NULL when there are no other entries in the directory.
+ */
+struct dirent* readdir(DIR *dirp)
+{
+    dir_entry_t* dir = (dir_entry_t*)dirp;
+
+    _dirent.d_name[0] = '\0';
+    _dirent.d_type = DT_REG;
+
+    if(!dir || !dir->fs->readdir || dir->fs->readdir(dir, &_dirent) != 0)
+        return NULL;
+
+    return &_dirent;
+}
+
+int chdir(const char *path)
+{
+    return f_chdir((TCHAR*)path) == FR_OK ? 0 : -1;
+}
+
+int mkdir(const char *pathname, mode_t mode)
+{
+    (void)mode;
+    const vfs_fs_t* fs = __resolve(pathname);
+    return (fs && fs->mkdir) ? fs->mkdir(pathname) : EOF;
+}
+
+/**
+ * populates a struct stat type with:
+ *
+ *  - st_size	- the size of the file
+ *  - st_mode 	- the mode of the file (S_IFCHR, S_IFREG, S_IFIFO, etc)
+ *
+ *  ... from an open file.
+ */
+int _fstat(int file, struct stat *st)
+{
+	int res = EOF;
+	if(file == STDIN_FILENO ||
+			file == STDOUT_FILENO ||
+			file == STDERR_FILENO ||
+			file == (intptr_t)stdout ||
+			file == (intptr_t)stderr ||
+			file == (intptr_t)stdin)
+	{
+		if(st)
+		{
+			st->st_size = 1;
+			st->st_mode = S_IFCHR;
+		}
+		res = 0;
+	}
+	else if(lock_filtab())
+	{
+		filtab_entry_t* fte = __get_entry(file);
+
+		if(fte)
+		{
+			res = 0;
+			if(st)
+			{
+				st->st_size = 0;
+				st->st_mode = fte->mode;
+				if(fte->ops->fstat)
+					res = fte->ops->fstat(fte, st);
+			}
+		}
+		unlock_filtab();
+	}
+
+	return res;
+}
+
+long int _ftell(int file)
+{
+	int res = EOF;
+
+	if(lock_filtab())
+	{
+        filtab_entry_t* fte = __get_entry(file);
+
+        if(fte && fte->ops->lseek)
+            res = fte->ops->lseek(fte, 0, SEEK_CUR);
+
+        unlock_filtab();
+	}
+
+	return res;
+}
+
+/**
+ * populates a struct stat type with:
+ *
+ *  - st_size	- the size of the file
+ *  - st_mode 	- the mode of the file (S_IFCHR, S_IFREG, S_IFIFO, etc)
+ *
+ *  ... from a file that is not already open.
+ */
+int _stat(char *file, struct stat *st)
+{
+	const vfs_fs_t* fs = __resolve(file);
+	return (fs && fs->stat) ? fs->stat(file, st) : EOF;
+}
+
+/**
+ * returns 1 if the file is a device, or stdio endpoint, 0 otherwise.
+ *
+ */
+int _isatty(int file)
+{
+	int res = 0;
+
+	if(file == STDIN_FILENO ||
+			file == STDOUT_FILENO ||
+			file == STDERR_FILENO ||
+			file == (intptr_t)stdout ||
+			file == (intptr_t)stderr ||
+			file == (intptr_t)stdin)
+		res = 1;
+	else if(lock_filtab())
+	{
+		filtab_entry_t* fte = __get_entry(file);
+		if(fte && (fte->mode == S_IFIFO))
+			res = 1;
+
+		unlock_filtab();
+	}
+	return res;
+}
+
+/**
+ * only works for seekable files (not devices, or stdio's)
+ *
+ * SEEK_SET 	Offset is to be measured in absolute terms.
+ * SEEK_CUR 	Offset is to be measured relative to the current location of the pointer.
+ * SEEK_END 	Offset is to be measured relative to the end of the file.
+ *
+ * @retval	the new offset from the start of the file, or -1 on error.
+ */
+int _lseek(int file, int offset, int whence)
+{
+	int res = EOF;
+    if(lock_filtab())
+    {
+        filtab_entry_t* fte = __get_entry(file);
+
+        if(!fte)
+            errno = EBADF;
+        else if(!fte->ops->lseek)
+            errno = ESPIPE;
+        else
+            res = fte->ops->lseek(fte, offset, whence);
+
+        unlock_filtab();
+    }
+	return res;
+}
+
+int _unlink(char *name)
+{
+	const vfs_fs_t* fs = __resolve(name);
+	int res = (fs && fs->unlink) ? fs->unlink(name) : EOF;
+#if ENABLE_LIKEPOSIX_ENCODED_VARIANTS
+	if(res == 0 && lock_filtab())
+	{
+		__encoded_invalidate();
+		unlock_filtab();
+	}
+#endif
+	return res;
+}
+
+/**
+ * renames a file, both names must resolve to the same backend.
+ */
+int rename(const char *oldname, const char *newname)
+{
+	const vfs_fs_t* fs = __resolve(oldname);
+	int res;
+	if(!fs || !fs->rename || fs != __resolve(newname))
+		return EOF;
+	res = fs->rename(oldname, newname);
+#if ENABLE_LIKEPOSIX_ENCODED_VARIANTS
+	// invalidate after the rename, a lookup racing with it then sees the generation change
+	if(res == 0 && lock_filtab())
+	{
+		__encoded_invalidate();
+		unlock_filtab();
+	}
+#endif
+	return res;
+}
+
+void _exit(int i)
+{
+	printf("Program exit with code %d", i);
+	while (1);
+}
+
+caddr_t _sbrk(int incr)
+{
+	(void)incr;
+    return NULL;
+}
+
+int _link(char *old, char *new)
+{
+	(void)old;
+	(void)new;
+	errno = EMLINK;
+	return -1;
+}
+
+int _execve(char *name, char **argv, char **env)
+{
+	(void)name;
+	(void)argv;
+	(void)env;
+	errno = ENOMEM;
+	return -1;
+}
+
+int _fork()
+{
+	errno = EAGAIN;
+	return -1;
+}
+
+int _getpid()
+{
+	return 1;
+}
+
+int _kill(int pid, int sig)
+{
+	(void)pid;
+	(void)sig;
+	errno = EINVAL;
+	return (-1);
+}
+
+#if !ENABLE_LIKEPOSIX_CPUTIME
+int times(struct tm *buf)
+{
+	(void)buf;
+	return -1;
+}
+#endif
+
+int _wait(int *status)
+{
+	(void)status;
+	errno = ECHILD;
+	return -1;
+}
+
+/**
+ * allocates a block, small requests are served by the size class allocator
+ * when ENABLE_LIKEPOSIX_SLAB is set.
+ */
+static inline void* __mem_alloc(size_t size)
+{
+#if ENABLE_LIKEPOSIX_SLAB
+	void* ptr = slab_alloc(size);
+	if(ptr)
+		return ptr;
+#endif
+	return pvPortMalloc(size);
+}
+
+static inline void __mem_free(void* ptr)
+{
+#if ENABLE_LIKEPOSIX_SLAB
+	if(slab_owns(ptr))
+	{
+		slab_free(ptr);
+		return;
+	}
+#endif
+	vPortFree(ptr);
+}
+
+/**
+ * @retval  the number of bytes usable in a block allocated with pvPortMalloc().
+ */
+static inline size_t __heap_block_size(void* ptr)
+{
+	xBlockLink *block = (xBlockLink*)((unsigned char*)ptr - heapSTRUCT_SIZE);
+	// heap_4 marks allocated blocks with the top bit of xBlockSize, heap_2 never sets it
+	return (block->xBlockSize & ~heapBLOCK_ALLOCATED_BIT) - heapSTRUCT_SIZE;
+}
+
+/**
+ * resizes a block without moving it, if it is already large enough, or if the
+ * heap scheme provides heap_grow() and can extend it into the free block that follows.
+ *
+ * @param   size is set to the usable size of the block before resizing.
+ * @retval  0 if the block now holds newSize bytes, or -1 if it must be moved.
+ */
+static inline int __mem_resize(void* ptr, size_t newSize, size_t* size)
+{
+#if ENABLE_LIKEPOSIX_SLAB
+	if(slab_owns(ptr))
+	{
+		*size = slab_size(ptr);
+		return newSize <= *size ? 0 : EOF;
+	}
+#endif
+	*size = __heap_block_size(ptr);
+	if(newSize <= *size)
+		return 0;
+	if(heap_grow && heap_grow(ptr, newSize) == 0)
+		return 0;
+	return EOF;
+}
+
+/**
+ * allocates memory, the caller address is recorded when ENABLE_LIKEPOSIX_HEAPTRACE is set.
+ */
+static inline void* __malloc(size_t size, void* caller)
+{
+	(void)caller;
+	if(size > ((size_t)-1) - HEAPTRACE_HEADER_SIZE)
+		return NULL;
+	return heaptrace_alloc(__mem_alloc(size + HEAPTRACE_HEADER_SIZE), size, caller);
+}
+
+static inline void __free(void* ptr, void* caller)
+{
+	(void)caller;
+	__mem_free(heaptrace_free(ptr, caller));
+}
+
+/**
+ * allocates zeroed memory for num items of size bytes.
+ * returns NULL and sets ENOMEM if num * size overflows.
+ */
+static inline void* __calloc(size_t num, size_t size, void* caller)
+{
+	void* ptr;
+
+	if(size && num > ((size_t)-1) / size)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	ptr = __malloc(num * size, caller);
+	if(ptr)
+		memset(ptr, 0, num * size);
+	return ptr;
+}
+
+/**
+ * resizes a block, without moving it where possible:
+ *
+ * - if the block is already large enough, it is returned as is.
+ * - otherwise, if the heap scheme provides heap_grow(), it is asked to extend
+ *   the block into the free block that follows it. the stock schemes do not.
+ * - only then is a new block allocated and the data copied.
+ *
+ * works with heap_2.c and heap_4.c only, see HEAP_BLOCK_HEADER_SIZE.
+ */
+static inline void* __realloc(void* oldAddr, size_t newSize, void* caller)
+{
+	size_t oldSize;
+	void *newAddr;
+	(void)caller;
+
+	if(oldAddr == NULL)
+		return __malloc(newSize, caller);
+
+	if(newSize == 0)
+	{
+		__free(oldAddr, caller);
+		return NULL;
+	}
+
+	if(newSize <= ((size_t)-1) - HEAPTRACE_HEADER_SIZE &&
+		__mem_resize((unsigned char*)oldAddr - HEAPTRACE_HEADER_SIZE, newSize + HEAPTRACE_HEADER_SIZE, &oldSize) == 0)
+	{
+		heaptrace_resize(oldAddr, newSize, caller);
+		return oldAddr;
+	}
+
+	newAddr = __malloc(newSize, caller);
+	if(newAddr == NULL)
+		return NULL;
+
+	memcpy(newAddr, oldAddr, oldSize - HEAPTRACE_HEADER_SIZE);
+	__free(oldAddr, caller);
+
+	return newAddr;
+}
+
+/**
+ * the newlib reentrant allocation hooks. the caller address they record is their return
+ * address, which for calls made through malloc(), free(), calloc() and realloc() is in those
+ * newlib functions, not in the code that called them. see HEAPTRACE_WRAP for that.
+ */
+_PTR _malloc_r(struct _reent *re, size_t size) {
+	(void)re;
+	return __malloc(size, __builtin_return_address(0));
+}
+
+_VOID _free_r(struct _reent *re, _PTR ptr) {
+	(void)re;
+	__free(ptr, __builtin_return_address(0));
+}
+
+_PTR _calloc_r(struct _reent *re, size_t num, size_t size) {
+	(void)re;
+	return __calloc(num, size, __builtin_return_address(0));
+}
+
+_PTR _realloc_r(struct _reent *re, _PTR oldAddr, size_t newSize)
+{
+	(void)re;
+	return __realloc(oldAddr, newSize, __builtin_return_address(0));
+}
+
+#if ENABLE_LIKEPOSIX_HEAPTRACE && HEAPTRACE_WRAP
+/**
+ * malloc(), free(), calloc() and realloc() for a link with
+ * -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc, which sends the calls here
+ * rather than through newlib, so that the heap trace records the address they were made from.
+ */
+void* __wrap_malloc(size_t size)
+{
+	return __malloc(size, __builtin_return_address(0));
+}
+
+void __wrap_free(void* ptr)
+{
+	__free(ptr, __builtin_return_address(0));
+}
+
+void* __wrap_calloc(size_t num, size_t size)
+{
+	return __calloc(num, size, __builtin_return_address(0));
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	return __realloc(ptr, size, __builtin_return_address(0));
+}
+#endif
+
+int tcgetattr(int fildes, struct termios *termios_p)
+{
+    int ret = -1;
+    if(termios_p == NULL || isatty(fildes) == 0)
+        return ret;
+
+    memset(termios_p, 0, sizeof(struct termios));
+
+    if(fildes == STDOUT_FILENO || fildes == STDERR_FILENO || fildes == (intptr_t)stdout || fildes == (intptr_t)stderr)
+    {
+        termios_p->c_cflag = B115200|CS8;
+        ret = 0;
+    }
+    else if(fildes == STDIN_FILENO || fildes == (intptr_t)stdin)
+    {
+        termios_p->c_cflag = B115200|CS8;
+        ret = 0;
+    }
+    else if(lock_filtab())
+    {
+        dev_ioctl_t* device = __get_device(__get_entry(fildes));
+
+        if(device && device->ioctl)
+        {
+            device->termios = termios_p;
+            ret = device->ioctl(device);
+            device->termios = NULL;
+        }
+        unlock_filtab();
+    }
+
+    return ret;
+}
+
+int tcsetattr(int fildes, int when, const struct termios *termios_p)
+{
+    (void)when;
+    int ret = -1;
+    if(termios_p == NULL || isatty(fildes) == 0)
+        return ret;
+
+    if(fildes == STDOUT_FILENO || fildes == STDERR_FILENO || fildes == (intptr_t)stdout || fildes == (intptr_t)stderr)
+    {
+
+    }
+    else if(fildes == STDIN_FILENO || fildes == (intptr_t)stdin)
+    {
+
+    }
+    else if(lock_filtab())
+    {
+        dev_ioctl_t* device = __get_device(__get_entry(fildes));
+
+        if(device && device->ioctl)
+        {
+            device->termios = (struct termios *)termios_p;
+            ret = device->ioctl(device);
+            device->termios = NULL;
+        }
+        unlock_filtab();
+    }
+
+    return ret;
+}
+
+speed_t cfgetispeed(const struct termios* termios)
+{
+    return termios->c_ispeed;
+}
+speed_t cfgetospeed(const struct termios* termios)
+{
+    return termios->c_ospeed;
+}
+
+int cfsetispeed(struct termios* termios, speed_t ispeed)
+{
+    termios->c_ispeed = ispeed;
+    return 0;
+}
+int cfsetospeed(struct termios* termios, speed_t ospeed)
+{
+    termios->c_ospeed = ospeed;
+    return 0;
+}
+
+int tcdrain(int file)
+{
+    unsigned long timeout;
+    int res = EOF;
+
+    if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
+    {
+        res = 0;
+    }
+    else if(file == STDIN_FILENO || file == (intptr_t)stdin)
+    {
+        res = 0;
+    }
+    else if(lock_filtab())
+    {
+        filtab_entry_t* fte = __get_entry(file);
+
+        if(fte)
+        {
+            if(fte->mode == S_IFIFO)
+            {
+                timeout = get_hw_time_ms() + __device(fte)->timeout;
+                while(uxQueueMessagesWaiting(__device(fte)->pipe.write) > 0 && get_hw_time_ms() < timeout)
+                    portYIELD();
+
+                if(get_hw_time_ms() < timeout)
+                    res = 0;
+            }
+        }
+        unlock_filtab();
+    }
+
+    return res;
+}
+
+/**
+ * not implemented....
+ */
+int tcflow(int file, int flags)
+{
+    int res = EOF;
+
+    if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
+    {
+        res = 0;
+    }
+    else if(file == STDIN_FILENO || file == (intptr_t)stdin)
+    {
+        res = 0;
+    }
+    else if(lock_filtab())
+    {
+        filtab_entry_t* fte = __get_entry(file);
+
+        if(fte)
+        {
+            if(fte->mode == S_IFIFO)
+            {
+                (void)flags;
+                res = EOF;
+            }
+        }
+        unlock_filtab();
+    }
+    return res;
+}
+
+int tcflush(int file, int flags)
+{
+    int res = EOF;
+
+    if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
+    {
+        res = 0;
+    }
+    else if(file == STDIN_FILENO || file == (intptr_t)stdin)
+    {
+        res = 0;
+    }
+    else if(lock_filtab())
+    {
+        filtab_entry_t* fte = __get_entry(file);
+
+        if(fte)
+        {
+            if(fte->mode == S_IFIFO)
+            {
+                if(flags == TCIFLUSH)
+                {
+                    xQueueReset(__device(fte)->pipe.read);
+                    res = 0;
+                }
+
+                else if(flags == TCOFLUSH)
+                {
+                    xQueueReset(__device(fte)->pipe.write);
+                    res = 0;
+                }
+
+                else if(flags == TCIOFLUSH)
+                {
+                    xQueueReset(__device(fte)->pipe.write);
+                    xQueueReset(__device(fte)->pipe.read);
+                    res = 0;
+                }
+            }
+        }
+        unlock_filtab();
+    }
+    return res;
 }
 
+/**********************************
+ * select and poll
+ **********************************/
+
+#if VFS_POLLIN != POLLIN || VFS_POLLOUT != POLLOUT || VFS_POLLERR != POLLERR
+#error the VFS_POLL flags must have the values of the POLL flags in poll.h
+#endif
+
 /**
- * determine the mode to open the file with - this is a customization of the mode passed into _open()...
+ * checks the descriptors given in arg, sets *sockets if any of them is a socket.
+ * called with the file table locked.
  *
- * returns a combination of the following...
- *  @arg     S_IFDIR - not implemented
- *  @arg     S_IFCHR - not implemented
- *  @arg     S_IFBLK - not implemented
- *  @arg     S_IFREG - signifies regular a file
- *  @arg     S_IFLNK - not implemented
- *  @arg     S_IFSOCK - not implemented
- *  @arg     S_IFIFO - signifies open a FIFO (interfacing a device)
+ * @retval  the number of ready descriptors, or -1 on error.
+ */
+typedef int (*vfs_scan_t)(void* arg, int* sockets);
+
+/**
+ * select() arguments.
+ */
+typedef struct {
+    int nfds;
+    fd_set* sets[3];            ///< the read, write and except sets passed to select()
+    fd_set requested[3];        ///< the sets as they were passed in
+} select_args_t;
+
+/**
+ * poll() arguments.
+ */
+typedef struct {
+    struct pollfd* fds;
+    nfds_t nfds;
+} poll_args_t;
+
+/**
+ * @retval  the readiness of a descriptor, files without a poll op are always ready.
  */
-inline int __determine_mode(const char *name)
+static int __poll_entry(filtab_entry_t* fte)
 {
-	int x = startswith(name, DEVICE_INTERFACE_DIRECTORY);
-	return x == 0 ? S_IFIFO : S_IFREG;
+    return fte->ops->poll ? fte->ops->poll(fte) : VFS_POLLIN|VFS_POLLOUT;
 }
 
 /**
- * installs a device for use by the application.
+ * @retval  the readiness of a stdio descriptor, which has no file table entry, or -1 for
+ *          any other descriptor. stdout and stderr are always writable. stdin is readable
+ *          when phy_getc() is defined, though a read may still wait for a character.
+ */
+static int __poll_stdio(int file)
+{
+    if(file == STDOUT_FILENO || file == STDERR_FILENO)
+        return VFS_POLLOUT;
+    if(file == STDIN_FILENO)
+        return phy_getc ? VFS_POLLIN : 0;
+    return EOF;
+}
+
+/**
+ * registers the calling task to be woken by vfs_notify(), before it first checks its
+ * descriptors so that no notification is missed between the check and the sleep.
+ * notifications left over from an earlier wait are discarded.
  *
- * an index into filtab.devtab is written into the device file,
- * this index is used by open() to interface a one of filtab.tab to one of filtab.devtab.
+ * @param   key is the epoll instance to wait on, or NULL for select() and poll().
+ * @retval  0, or -1 if there was not enough memory for the waiter's semaphore.
+ */
+static int __add_waiter(vfs_waiter_t* waiter, const void* key)
+{
+#if VFS_NOTIFY_INDEX < 0
+#if configSUPPORT_STATIC_ALLOCATION
+    waiter->wake = xSemaphoreCreateBinaryStatic(&waiter->wake_buffer);
+#else
+    waiter->wake = xSemaphoreCreateBinary();
+#endif
+    if(!waiter->wake)
+    {
+        errno = ENOMEM;
+        return EOF;
+    }
+#else
+    ulTaskNotifyTakeIndexed(VFS_NOTIFY_INDEX, pdTRUE, 0);
+#endif
+    waiter->task = xTaskGetCurrentTaskHandle();
+    waiter->key = key;
+    taskENTER_CRITICAL();
+    waiter->next = filtab.waiters;
+    filtab.waiters = waiter;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+static void __remove_waiter(vfs_waiter_t* waiter)
+{
+    vfs_waiter_t** w;
+
+    taskENTER_CRITICAL();
+    for(w = &filtab.waiters; *w; w = &(*w)->next)
+    {
+        if(*w == waiter)
+        {
+            *w = waiter->next;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+#if VFS_NOTIFY_INDEX < 0
+    vSemaphoreDelete(waiter->wake);
+#endif
+}
+
+/**
+ * scans until scan reports ready descriptors or an error, or the timeout expires, then
+ * removes the waiter, which must have been added with __add_waiter().
  *
- * @param	name is the full path to the file to associate with the device.
- * @param	dev_ctx is a pointer to some data that will be passed to the device driver
- *			driver ioctl functions.
- * @param	read_enable is an ioctl function that can enable a device to read data.
- * @param	write_enable is an ioctl function that can enable a device to write data.
- * @param   open is an ioctl function that can enable a device.
- * @param	close is an ioctl function that can disable a device.
- * @param	ioctl is an ioctl function that can set the hardware settings of a device.
- * @retval	returns a pointer to the created dev_ioctl_t structure, or NULL on error.
+ * between scans the calling task sleeps until vfs_notify() is called, on the notification
+ * value at VFS_NOTIFY_INDEX, or on the waiter's semaphore. sockets only call vfs_notify() with
+ * ENABLE_LIKEPOSIX_SOCKET_EVENTS, without it the sleep is limited to VFS_POLL_INTERVAL
+ * when there are sockets to check.
+ *
+ * @param   timeout is the timeout in milliseconds, 0 to scan once, or -1 to wait indefinitely.
+ * @retval  the value returned by the last scan.
  */
-dev_ioctl_t* install_device(char* name,
-					void* dev_ctx,
-					dev_ioctl_fn_t read_enable,
-					dev_ioctl_fn_t write_enable,
-                    dev_ioctl_fn_t open_dev,
-					dev_ioctl_fn_t close_dev,
-					dev_ioctl_fn_t ioctl)
+static int __wait_ready(vfs_waiter_t* waiter, vfs_scan_t scan, void* arg, int timeout)
 {
-	FIL f;
-	unsigned char buf[DEVICED_INTERFACE_FILE_SIZE];
-	int device;
-	dev_ioctl_t* ret = NULL;
-	unsigned int n = 0;
+    TimeOut_t start;
+    TickType_t remaining = timeout < 0 ? portMAX_DELAY : ((TickType_t)timeout + portTICK_RATE_MS - 1) / portTICK_RATE_MS;
+    TickType_t wait;
+    int sockets = 0;
+    int n;
 
-	log_syslog(NULL, "installing %s...", name);
+    vTaskSetTimeOutState(&start);
 
-	// try to create the directory first, if it fails it is already there
-	// or, the disk isnt in. the next step will also fail in that case.
-	f_mkdir(DEVICE_INTERFACE_DIRECTORY);
+    for(;;)
+    {
+        n = EOF;
+        if(lock_filtab())
+        {
+            n = scan(arg, &sockets);
+            unlock_filtab();
+        }
 
-    // is it possible to open the device file?
-    if(f_open(&f, (const TCHAR*)name, FA_WRITE|FA_OPEN_ALWAYS) == FR_OK)
+        if(n != 0 || remaining == 0 || xTaskCheckForTimeOut(&start, &remaining) == pdTRUE)
+            break;
+
+        wait = remaining;
+#if !(ENABLE_LIKEPOSIX_SOCKETS && ENABLE_LIKEPOSIX_SOCKET_EVENTS)
+        if(sockets && wait > VFS_POLL_INTERVAL/portTICK_RATE_MS)
+            wait = VFS_POLL_INTERVAL/portTICK_RATE_MS;
+#endif
+        __sleep_waiter(waiter, wait);
+    }
+
+    __remove_waiter(waiter);
+    return n;
+}
+
+static int __select_scan(void* arg, int* sockets)
+{
+    static const int events[3] = {VFS_POLLIN, VFS_POLLOUT, VFS_POLLERR};
+    select_args_t* args = (select_args_t*)arg;
+    filtab_entry_t* fte;
+    int ready;
+    int requested;
+    int file;
+    int i;
+    int n = 0;
+
+    for(i = 0; i < 3; i++)
     {
-        for(device = 0; device < DEVICE_TABLE_LENGTH; device++)
+        if(args->sets[i])
+            FD_ZERO(args->sets[i]);
+    }
+
+    for(file = 0; file < args->nfds; file++)
+    {
+        requested = 0;
+        for(i = 0; i < 3; i++)
         {
-            // found an empty slot
-            if(filtab.devtab[device] == NULL)
+            if(args->sets[i] && FD_ISSET(file, &args->requested[i]))
+                requested |= events[i];
+        }
+        if(!requested)
+            continue;
+
+        fte = __get_entry(file);
+        if(fte)
+        {
+            if(fte->mode == S_IFSOCK)
+                *sockets = 1;
+            ready = __poll_entry(fte) & requested;
+        }
+        else if((ready = __poll_stdio(file)) != EOF)
+            ready &= requested;
+        else
+        {
+            errno = EBADF;
+            return EOF;
+        }
+
+        for(i = 0; i < 3; i++)
+        {
+            if(ready & events[i])
             {
-                // todo, add better logic to write the file only if it is out of date/not exists
-                // install devno in file
-                buf[0] = (unsigned char)device;
-                if((f_write(&f, buf, (UINT)1, (UINT*)&n) == FR_OK) && (n == 1))
-                {
-                    // create device io structure and populate api
-                    filtab.devtab[device] = pvPortMalloc(sizeof(dev_ioctl_t));
-                    if(filtab.devtab[device])
-                    {
-                        // note that filtab.devtab[device]->pipe is populated by _open()
-                        filtab.devtab[device]->timeout = 0;
-                        filtab.devtab[device]->read_enable = read_enable;
-                        filtab.devtab[device]->write_enable = write_enable;
-                        filtab.devtab[device]->ioctl = ioctl;
-                        filtab.devtab[device]->open = open_dev;
-                        filtab.devtab[device]->close = close_dev;
-                        filtab.devtab[device]->ctx = dev_ctx;
-                        filtab.devtab[device]->termios = NULL;
-                    }
-                    ret = filtab.devtab[device];
-                    log_syslog(NULL, "%s OK", name);
-                }
-                else
-                    log_error(NULL, "failed to write device %s", name);
+                FD_SET(file, args->sets[i]);
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+static int __poll_scan(void* arg, int* sockets)
+{
+    poll_args_t* args = (poll_args_t*)arg;
+    filtab_entry_t* fte;
+    nfds_t i;
+    int ready;
+    int n = 0;
+
+    for(i = 0; i < args->nfds; i++)
+    {
+        args->fds[i].revents = 0;
+        if(args->fds[i].fd < 0)
+            continue;
+
+        fte = __get_entry(args->fds[i].fd);
+        if(fte)
+        {
+            if(fte->mode == S_IFSOCK)
+                *sockets = 1;
+            args->fds[i].revents = __poll_entry(fte) & (args->fds[i].events | POLLERR);
+        }
+        else if((ready = __poll_stdio(args->fds[i].fd)) != EOF)
+            args->fds[i].revents = ready & args->fds[i].events;
+        else
+            args->fds[i].revents = POLLNVAL;
+
+        if(args->fds[i].revents)
+            n++;
+    }
+
+    return n;
+}
+
+/**
+ * waits for descriptors of any type to become ready. regular files are always ready,
+ * devices are ready when their queues hold data or have space, sockets as reported by lwIP.
+ * stdout and stderr are always ready to write, stdin to read if phy_getc() is defined.
+ *
+ * @param   fds is an array of nfds descriptors, with the events of interest.
+ *          POLLERR and POLLNVAL are always reported, POLLPRI and POLLHUP are not supported.
+ * @param   timeout is the timeout in milliseconds, 0 to return immediately, or -1 to wait indefinitely.
+ * @retval  the number of descriptors with revents set, 0 on timeout, or -1 on error.
+ */
+int poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+    poll_args_t args = {fds, nfds};
+    vfs_waiter_t waiter;
+
+    if(!fds && nfds)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
+
+    if(__add_waiter(&waiter, NULL) == EOF)
+        return EOF;
+    return __wait_ready(&waiter, __poll_scan, &args, timeout);
+}
+
+/**
+ * like-posix sys/socket.h maps select() to lwip_select() when like-posix doesnt manage sockets.
+ */
+#undef select
+
+/**
+ * waits for descriptors of any type to become ready, see poll().
+ *
+ * @param   nfds is the highest descriptor in any of the sets, plus 1.
+ * @param   readfds, writefds and exceptfds may be NULL. on return they hold the ready descriptors.
+ * @param   timeout is the timeout, or NULL to wait indefinitely.
+ * @retval  the number of ready descriptors, counted once per set, 0 on timeout,
+ *          or -1 on error, with errno set to EBADF if a descriptor was not open.
+ */
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout)
+{
+    select_args_t args;
+    vfs_waiter_t waiter;
+    int ms = EOF;
+    int i;
+
+    if(nfds < 0 || nfds > FD_SETSIZE)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
+
+    args.nfds = nfds;
+    args.sets[0] = readfds;
+    args.sets[1] = writefds;
+    args.sets[2] = exceptfds;
+    for(i = 0; i < 3; i++)
+    {
+        if(args.sets[i])
+            args.requested[i] = *args.sets[i];
+    }
+
+    if(timeout)
+    {
+        if(timeout->tv_sec >= INT_MAX / 1000)
+            ms = INT_MAX;
+        else
+            ms = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+    }
+
+    if(__add_waiter(&waiter, NULL) == EOF)
+        return EOF;
+    return __wait_ready(&waiter, __select_scan, &args, ms);
+}
+
+#if ENABLE_LIKEPOSIX_EPOLL
+
+/**********************************
+ * epoll
+ **********************************/
+
+#if EPOLLIN != VFS_POLLIN || EPOLLOUT != VFS_POLLOUT || EPOLLERR != VFS_POLLERR
+#error the VFS_POLL flags must have the values of the EPOLL flags in sys/epoll.h
+#endif
+
+static const vfs_ops_t epoll_ops;
+
+/**
+ * epoll_wait() arguments.
+ */
+typedef struct {
+    int epfd;
+    struct epoll_event* events;
+    int maxevents;
+} epoll_args_t;
+
+/**
+ * @retval  the epoll instance open on a descriptor, or NULL.
+ */
+static epoll_entry_t* __get_epoll(int epfd)
+{
+    filtab_entry_t* fte = __get_entry(epfd);
+    return (fte && fte->ops == &epoll_ops) ? (epoll_entry_t*)fte : NULL;
+}
+
+/**
+ * @retval  the registration of a descriptor with an instance, or NULL.
+ */
+static epoll_watch_t* __find_watch(filtab_entry_t* fte, epoll_entry_t* epoll)
+{
+    epoll_watch_t* watch;
+
+    for(watch = fte->watches; watch; watch = watch->next)
+    {
+        if(watch->epoll == epoll)
+            break;
+    }
+    return watch;
+}
+
+/**
+ * removes all registrations with the instance, and lets tasks waiting on it find out that it has gone.
+ */
+static int epoll_close(filtab_entry_t* fte)
+{
+    epoll_entry_t* epoll = (epoll_entry_t*)fte;
+    epoll_watch_t** w;
+    epoll_watch_t* watch;
+    vfs_waiter_t* waiter;
+    int file;
+
+    for(file = 0; file < FILE_TABLE_LENGTH; file++)
+    {
+        if(!filtab.tab[file])
+            continue;
+
+        w = &filtab.tab[file]->watches;
+        while(*w)
+        {
+            watch = *w;
+            if(watch->epoll == epoll)
+            {
+                taskENTER_CRITICAL();
+                *w = watch->next;
+                taskEXIT_CRITICAL();
+                __unlink_socket_watch(watch);
+                __free_watch(watch);
+            }
+            else
+                w = &watch->next;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    epoll->ready = NULL;
+    epoll->last = NULL;
+    for(waiter = filtab.waiters; waiter; waiter = waiter->next)
+    {
+        if(waiter->key == epoll)
+        {
+            waiter->key = NULL;
+            __wake_waiter(waiter);
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return 0;
+}
+
+/**
+ * an epoll instance is readable when it has registrations that may have events to report.
+ */
+static int epoll_poll(filtab_entry_t* fte)
+{
+    return ((epoll_entry_t*)fte)->ready ? VFS_POLLIN : 0;
+}
+
+static const vfs_ops_t epoll_ops = {
+    .read = NULL,
+    .write = NULL,
+    .lseek = NULL,
+    .fstat = NULL,
+    .fsync = NULL,
+    .close = epoll_close,
+    .poll = epoll_poll,
+};
+
+/**
+ * reports the events of the registrations in the ready list. only the ready list is
+ * checked, so the cost is in the number of descriptors that may be ready, not the number
+ * registered. level triggered registrations that reported an event are queued again,
+ * to be checked on the next call.
+ */
+static int __epoll_scan(void* arg, int* sockets)
+{
+    epoll_args_t* args = (epoll_args_t*)arg;
+    epoll_entry_t* epoll = __get_epoll(args->epfd);
+    epoll_watch_t* pending;
+    epoll_watch_t* watch;
+    uint32_t events;
+    int n = 0;
+
+    if(!epoll)
+    {
+        errno = EBADF;
+        return EOF;
+    }
 
-                break;
-            }
+#if ENABLE_LIKEPOSIX_SOCKETS && !ENABLE_LIKEPOSIX_SOCKET_EVENTS
+    // without socket events the instance's sockets are checked every time it is
+    for(watch = epoll->sockets; watch; watch = watch->socket_next)
+    {
+        *sockets = 1;
+        taskENTER_CRITICAL();
+        __queue_watch(watch);
+        taskEXIT_CRITICAL();
+    }
+#else
+    (void)sockets;
+#endif
+
+    // take the ready list, registrations queued from here on go on a new one
+    taskENTER_CRITICAL();
+    pending = epoll->ready;
+    epoll->ready = NULL;
+    epoll->last = NULL;
+    taskEXIT_CRITICAL();
+
+    while(pending && n < args->maxevents)
+    {
+        watch = pending;
+        taskENTER_CRITICAL();
+        pending = watch->ready_next;
+        watch->queued = 0;
+        taskEXIT_CRITICAL();
+
+        events = __poll_entry(watch->fte) & (__watch_events(watch) | EPOLLERR);
+        if(!events)
+            continue;
+
+        args->events[n].events = events;
+        args->events[n].data = watch->data;
+        n++;
+
+        if(watch->events & EPOLLONESHOT)
+            watch->events &= EPOLLET|EPOLLONESHOT;
+        else if(!(watch->events & EPOLLET))
+        {
+            taskENTER_CRITICAL();
+            __queue_watch(watch);
+            taskEXIT_CRITICAL();
         }
-        f_close(&f);
     }
-    else
-        log_error(NULL, "failed to open device %s", name);
 
-	return ret;
+    // put back the registrations that didnt fit in events, ahead of those queued since
+    if(pending)
+    {
+        taskENTER_CRITICAL();
+        for(watch = pending; watch->ready_next; watch = watch->ready_next);
+        watch->ready_next = epoll->ready;
+        if(!epoll->last)
+            epoll->last = watch;
+        epoll->ready = pending;
+        taskEXIT_CRITICAL();
+    }
+
+    return n;
 }
 
 /**
- * system call, 'open'
- *
- * opens a file for disk IO, or a FreeRTOS Queue, for
- * device IO or data transfer/sharing.
+ * creates an epoll instance.
  *
- * **this is a non standard implementation**
+ * @param   size is ignored, but must be greater than 0.
+ * @retval  the epoll descriptor, or -1 on error.
+ */
+int epoll_create(int size)
+{
+    if(size <= 0)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
+    return epoll_create1(0);
+}
+
+/**
+ * creates an epoll instance.
  *
- * @param	the name of the file to open
- * @param	flags -
- * 			if mode is S_IFREG, may be a combination of:
- *  		one of O_RDONLY, O_WRONLY, or O_RDWR,
- * 			and any of O_APPEND | O_CREAT | O_TRUNC
- * @param	mode - repurposed - in the case of device files, specified the queue length.
- * 			otherwise ignored.
- * @retval	returns a file descriptor, that may be used with
- * 			read(), write(), close(), or -1 if there was an error.
+ * @param   flags may be 0 or EPOLL_CLOEXEC, which is ignored as there is no exec().
+ * @retval  the epoll descriptor, or -1 on error.
  */
-int _open(const char *name, int flags, int mode)
+int epoll_create1(int flags)
 {
+    filtab_entry_t* fte;
     int file = EOF;
 
-	if(filtab.count > FILE_TABLE_LENGTH)
-		return EOF;
-
-	filtab_entry_t* fte = NULL;
-	int length = mode;
-
-	if(lock_filtab())
-	{
-        file = __create_filtab_item(&fte, name, flags, __determine_mode(name), length);
+    if(flags & ~EPOLL_CLOEXEC)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
 
-        // if we got 0 here it means a file or a queue was made successfully
-        // now need to add the file stat struct to the descriptor table
-        if(file == 0)
+    if(lock_filtab())
+    {
+        fte = __create_filtab_item(O_RDWR, sizeof(epoll_entry_t));
+        if(fte)
         {
-            // add file to table
+            fte->ops = &epoll_ops;
             file = __insert_entry(fte);
-            // add failed, delete
             if(file == EOF)
                 __delete_filtab_item(fte);
-            else
-            {
-                // actions to do if everything went right...
-
-                if((fte->mode == S_IFIFO) && fte->device)
-                {
-                    // call device open
-                    if(fte->device->open)
-                        fte->device->open(fte->device);
-                    // enable reading
-                    if((fte->flags & FREAD) && fte->device->read_enable)
-                        fte->device->read_enable(fte->device);
-                    // writing is enabled in _write()...
-                }
-            }
         }
         unlock_filtab();
-	}
+    }
 
-	return file;
+    if(file == EOF)
+        errno = ENOMEM;
+
+    return file;
 }
 
 /**
- * close the specified file descriptor.
+ * adds, modifies or removes the registration of a descriptor with an epoll instance.
  *
- * @param	file is the file descriptor to close.
- * @retval 	0 on success, -1 on error.
+ * devices, sockets and timerfds may be registered. regular files are always ready and may not be,
+ * as for Linux, nor may epoll instances.
+ *
+ * @param   op is one of EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL.
+ * @param   event holds the events of interest, which may include EPOLLET and EPOLLONESHOT,
+ *          and the data to return with them. ignored for EPOLL_CTL_DEL.
+ * @retval  0 on success, or -1 on error with errno set.
  */
-int _close(int file)
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
 {
-	int res = EOF;
-    if(lock_filtab())
+    epoll_entry_t* epoll;
+    filtab_entry_t* fte;
+    epoll_watch_t* watch;
+    epoll_watch_t** w;
+    int error = 0;
+
+    if(op != EPOLL_CTL_DEL && !event)
     {
-        filtab_entry_t* fte = __get_entry(file);
-        if(fte)
+        errno = EFAULT;
+        return EOF;
+    }
+
+    if(!lock_filtab())
+    {
+        errno = EBUSY;
+        return EOF;
+    }
+
+    epoll = __get_epoll(epfd);
+    fte = __get_entry(fd);
+
+    if(!epoll || !fte)
+        error = EBADF;
+    else if(fte->ops == &epoll_ops)
+        error = EINVAL;
+    else if(fte->mode == S_IFREG)
+        error = EPERM;
+    else
+    {
+        watch = __find_watch(fte, epoll);
+
+        if(op == EPOLL_CTL_ADD)
         {
-            // disable device IO first
-            if((fte->mode == S_IFIFO) && fte->device && (fte->device->close))
+            if(watch)
+                error = EEXIST;
+            else if(!(watch = __alloc_watch()))
+                error = ENOMEM;
+            else
             {
-                // call device close
-                fte->device->close(fte->device);
+                watch->epoll = epoll;
+                watch->fte = fte;
+                watch->events = event->events;
+                watch->data = event->data;
+                watch->queued = 0;
+                __link_socket_watch(watch);
+                // queue the new registration, its events are reported if it is already ready
+                taskENTER_CRITICAL();
+                watch->next = fte->watches;
+                fte->watches = watch;
+                __notify_entry(fte, 0, NULL);
+                taskEXIT_CRITICAL();
             }
-            // then remove the file table entry
-            res = __remove_entry(file);
-            // then delete all the file structures
-            __delete_filtab_item(fte);
         }
-        unlock_filtab();
+        else if(!watch)
+            error = ENOENT;
+        else if(op == EPOLL_CTL_MOD)
+        {
+            taskENTER_CRITICAL();
+            watch->events = event->events;
+            watch->data = event->data;
+            __notify_entry(fte, 0, NULL);
+            taskEXIT_CRITICAL();
+        }
+        else if(op == EPOLL_CTL_DEL)
+        {
+            taskENTER_CRITICAL();
+            for(w = &fte->watches; *w != watch; w = &(*w)->next);
+            *w = watch->next;
+            __unqueue_watch(watch);
+            taskEXIT_CRITICAL();
+            __unlink_socket_watch(watch);
+            __free_watch(watch);
+        }
+        else
+            error = EINVAL;
     }
-	return res;
+
+    unlock_filtab();
+
+    if(error)
+    {
+        errno = error;
+        return EOF;
+    }
+    return 0;
 }
 
 /**
- * writes a buffer to the file specified.
+ * waits for events on the descriptors registered with an epoll instance.
  *
- * @param	file is a file descriptor, may be the value returned by
- * 			a call to the open() syscall, or STDOUT_FILENO or STDERR_FILENO.
- * @param	a buffer of characters to write.
- * @param	count, the number of characters to write.file
- * @retval	the number of characters written or -1 on error.
+ * @param   events receives up to maxevents events, with the data given to epoll_ctl().
+ * @param   timeout is the timeout in milliseconds, 0 to return immediately, or -1 to wait indefinitely.
+ * @retval  the number of events, 0 on timeout, or -1 on error.
  */
-int _write(int file, char *buffer, unsigned int count)
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout)
 {
-    unsigned int timeout;
-	int n = EOF;
+    epoll_args_t args = {epfd, events, maxevents};
+    epoll_entry_t* epoll = NULL;
+    vfs_waiter_t waiter;
+    int res = 0;
 
-	if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
-	{
-		for(n = 0; n < (int)count; n++)
-			phy_putc(*buffer++);
-	}
-	else if(lock_filtab())
-	{
-		filtab_entry_t* fte = __get_entry(file);
+    if(!events || maxevents <= 0)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
 
-		if(fte && (fte->flags & FWRITE))
-		{
-			if(fte->mode == S_IFREG)
-			{
-				if(f_write(&fte->file, (void*)buffer, (UINT)count, (UINT*)&n) != FR_OK)
-				    n = EOF;
-			}
-			else if((fte->mode == S_IFIFO) && fte->device)
-			{
-                timeout = fte->device->timeout;
-
-				for(n = 0; n < (int)count; n++)
-				{
-					if(xQueueSend(fte->device->pipe.write, buffer++, timeout) != pdTRUE)
-						break;
-                    timeout = 0;
-				}
-				// enable the physical device to write
-				if(fte->device->write_enable)
-					fte->device->write_enable(fte->device);
-			}
-#if ENABLE_LIKEPOSIX_SOCKETS
-            else if(fte->mode == S_IFSOCK)
-            {
-                n = lwip_write((int)fte->device, buffer, count);
-            }
-#endif
-		}
-		unlock_filtab();
-	}
+    // the waiter is keyed on the instance, adding it under the lock means epoll_close() finds it
+    if(lock_filtab())
+    {
+        epoll = __get_epoll(epfd);
+        if(epoll)
+            res = __add_waiter(&waiter, epoll);
+        unlock_filtab();
+    }
 
-	return n;
+    if(!epoll)
+    {
+        errno = EBADF;
+        return EOF;
+    }
+    if(res == EOF)
+        return EOF;
+
+    return __wait_ready(&waiter, __epoll_scan, &args, timeout);
 }
 
+#endif
+
+#if ENABLE_LIKEPOSIX_TIMERS
+
+/**********************************
+ * timers
+ **********************************/
+
 /**
- * reads a number of characters into a buffer from the file specified.
- *
- * @param	file is a file descriptor, may be the value returned by
- * 			a call to the open() syscall, or STDIN_FILENO
- * @param	a buffer for the characters to read.
- * @param	count, the number of characters to read.
- * @retval	the number of characters read or -1 on error.
+ * the longest delay a timer is programmed with, in ticks. keeps tick count comparisons
+ * within half the tick counter range.
  */
-int _read(int file, char *buffer, int count)
-{
-    unsigned int timeout;
-	int n = EOF;
+#define TIMER_MAX_TICKS                 (portMAX_DELAY >> 2)
 
-	if(file == STDIN_FILENO || file == (intptr_t)stdin)
-	{
-		for(n = 0; n < count; n++)
-			*buffer++ = phy_getc();
-	}
-	else if(lock_filtab())
-	{
-		filtab_entry_t* fte = __get_entry(file);
+/**
+ * true when the tick count now has reached tick t.
+ */
+#define __tick_reached(now, t)          ((TickType_t)((now) - (t)) < (portMAX_DELAY >> 1))
 
-		if(fte && (fte->flags & FREAD))
-		{
-			if(fte->mode == S_IFREG)
-			{
-				f_read(&fte->file, (void*)buffer, (UINT)count, (UINT*)&n);
-			}
-			else if((fte->mode == S_IFIFO) && fte->device)
-			{
-			    timeout = fte->device->timeout;
-
-				for(n = 0; n < count; n++)
-				{
-					if(xQueueReceive(fte->device->pipe.read, buffer++, timeout) != pdTRUE)
-						break;
-					timeout = 0;
-				}
-			}
-#if ENABLE_LIKEPOSIX_SOCKETS
-            else if(fte->mode == S_IFSOCK)
-            {
-                n = lwip_read((int)fte->device, buffer, count);
-            }
+/**
+ * a POSIX timer or timerfd, on a one shot FreeRTOS software timer.
+ *
+ * the timer is only ever started for the time remaining to the next expiry, and periodic
+ * timers are restarted from the callback, so that the period is kept to the expiry times
+ * rather than to when the callback happened to run. the state is shared with the timer
+ * task, and changed in critical sections.
+ */
+typedef struct _posix_timer_t {
+    TimerHandle_t timer;            ///< the software timer, its id is this structure, NULL once it is deleted
+    clockid_t clock;                ///< the clock absolute times are given on
+    int armed;                      ///< nonzero while the timer is due to expire
+    TickType_t expiry;              ///< the tick count at which the timer next expires
+    TickType_t interval;            ///< the reload period in ticks, 0 for a one shot timer
+    uint32_t expirations;           ///< expirations not yet read from a timerfd
+    int overrun;                    ///< periods missed at the last expiry, timer_getoverrun()
+    filtab_entry_t* fte;            ///< the timerfd the timer belongs to, or NULL
+    struct _posix_timer_t* next;    ///< the next timer in closed_timers
+#if defined(_POSIX_THREADS) && defined(SIGEV_THREAD)
+    void (*notify)(union sigval);   ///< SIGEV_THREAD notification function, or NULL
+    union sigval value;             ///< passed to notify
 #endif
-		}
-        unlock_filtab();
-	}
+} posix_timer_t;
 
-	return n;
+/**
+ * timerfd file table entry. timerfds have no file type, their mode is 0.
+ */
+typedef struct {
+    filtab_entry_t entry;           ///< must be the first member
+    posix_timer_t* timer;
+} timerfd_entry_t;
+
+static const vfs_ops_t timerfd_ops;
+
+/**
+ * timers waiting to be deleted, those of closed timerfds and those the timer task could not
+ * delete. changed in critical sections.
+ */
+static posix_timer_t* closed_timers;
+
+/**
+ * @retval  a time converted to ticks, rounded up, so that a timer never expires early.
+ */
+static TickType_t __timespec_to_ticks(const struct timespec* ts)
+{
+    uint64_t tick = 1000000000ull / configTICK_RATE_HZ;
+    uint64_t ticks = ((uint64_t)ts->tv_sec * 1000000000ull + ts->tv_nsec + tick - 1) / tick;
+    return ticks > TIMER_MAX_TICKS ? TIMER_MAX_TICKS : (TickType_t)ticks;
 }
 
-int fsync(int file)
+static void __ticks_to_timespec(TickType_t ticks, struct timespec* ts)
 {
-	int res = EOF;
-	if(file == STDIN_FILENO ||
-			file == STDOUT_FILENO ||
-			file == STDERR_FILENO ||
-			file == (intptr_t)stdout ||
-			file == (intptr_t)stderr ||
-			file == (intptr_t)stdin)
-	{
-		res = 0;
-	}
-	else if(lock_filtab())
-	{
-		filtab_entry_t* fte = __get_entry(file);
+    ts->tv_sec = ticks / configTICK_RATE_HZ;
+    ts->tv_nsec = (long)((uint64_t)(ticks % configTICK_RATE_HZ) * 1000000000ull / configTICK_RATE_HZ);
+}
 
-		if(fte)
-		{
-			if(fte->mode == S_IFREG)
-			{
-				f_sync(&fte->file);
-				res = 0;
-			}
-		}
-        unlock_filtab();
-	}
+static int __timespec_valid(const struct timespec* ts)
+{
+    return ts->tv_sec >= 0 && ts->tv_nsec >= 0 && ts->tv_nsec < 1000000000;
+}
 
-	return res;
+/**
+ * software timer callback, runs in the timer task.
+ *
+ * a callback that finds the expiry still in the future comes from a restart queued
+ * before the timer was set again, and just restarts the timer for the time remaining.
+ */
+static void __timer_expired(TimerHandle_t handle)
+{
+    posix_timer_t* timer = (posix_timer_t*)pvTimerGetTimerID(handle);
+    TickType_t now = xTaskGetTickCount();
+    TickType_t delay = 0;
+    int expired = 0;
+
+    taskENTER_CRITICAL();
+    if(timer->armed)
+    {
+        if(!__tick_reached(now, timer->expiry))
+            delay = timer->expiry - now;
+        else
+        {
+            expired = 1;
+            timer->expirations++;
+            timer->overrun = 0;
+            if(timer->interval)
+            {
+                // count the periods missed while the timer task was busy
+                timer->expiry += timer->interval;
+                while(__tick_reached(now, timer->expiry))
+                {
+                    timer->expiry += timer->interval;
+                    timer->expirations++;
+                    timer->overrun++;
+                }
+                delay = timer->expiry - now;
+            }
+            else
+                timer->armed = 0;
+
+            if(timer->fte)
+                __notify_entry(timer->fte, 0, NULL);
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    // a timer callback must not block
+    if(delay)
+        xTimerChangePeriod(handle, delay, 0);
+
+#if defined(_POSIX_THREADS) && defined(SIGEV_THREAD)
+    if(expired && timer->notify)
+        timer->notify(timer->value);
+#else
+    (void)expired;
+#endif
 }
 
 /**
- * gets the current working directory - follows the GNU version
- * in that id buffer is set to NULL, a buffer of size bytes is allocated
- * to hold the cwd string. it must be freed afterward by the user...
+ * @retval  a new timer, disarmed, or NULL if there was not enough memory.
  */
-char* getcwd(char* buffer, size_t size)
+static posix_timer_t* __create_timer(clockid_t clock_id)
 {
-    if(buffer == NULL)
-        buffer = malloc(size);
+    posix_timer_t* timer = (posix_timer_t*)pvPortMalloc(sizeof(posix_timer_t));
 
-    if(buffer)
+    if(timer)
     {
-        if(f_getcwd((TCHAR*)buffer, (UINT)size) != FR_OK)
+        memset(timer, 0, sizeof(posix_timer_t));
+        timer->clock = clock_id;
+        timer->timer = xTimerCreate("timer", 1, pdFALSE, timer, __timer_expired);
+        if(!timer->timer)
         {
-            free(buffer);
-            buffer = NULL;
+            vPortFree(timer);
+            timer = NULL;
         }
     }
+    return timer;
+}
+
+/**
+ * frees a timer, called in the timer task after the software timer has been deleted.
+ */
+static void __free_timer(void* timer, uint32_t unused)
+{
+    (void)unused;
+    vPortFree(timer);
+}
+
+/**
+ * disarms a timer and puts it on closed_timers, to be deleted by __delete_closed_timers().
+ * doesn't block, so it may be called with the file table locked.
+ */
+static void __close_timer(posix_timer_t* timer)
+{
+    taskENTER_CRITICAL();
+    timer->armed = 0;
+    timer->fte = NULL;
+    timer->next = closed_timers;
+    closed_timers = timer;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * deletes a timer. the timer is freed by the timer task, once it has processed the delete
+ * command, so that a callback that is already running never sees it freed.
+ *
+ * the commands are queued to the timer task, which would wait for itself if it blocked on a
+ * full queue. called from the timer task, as by a SIGEV_THREAD function, it doesn't block,
+ * and a timer whose commands didn't fit goes back on closed_timers, to be deleted by the
+ * next call that deletes a timer. don't call with the file table locked, use __close_timer().
+ */
+static void __delete_timer(posix_timer_t* timer)
+{
+    TickType_t wait = xTaskGetCurrentTaskHandle() == xTimerGetTimerDaemonTaskHandle() ? 0 : portMAX_DELAY;
 
-    return buffer;
+    taskENTER_CRITICAL();
+    timer->armed = 0;
+    timer->fte = NULL;
+    taskEXIT_CRITICAL();
+
+    if(timer->timer && xTimerDelete(timer->timer, wait) == pdPASS)
+        timer->timer = NULL;
+    if(timer->timer || xTimerPendFunctionCall(__free_timer, timer, 0, wait) != pdPASS)
+        __close_timer(timer);
 }
 
 /**
- * allocates and populates a DIR info struct.
- * returns NULL if there was no memory allocated or the directory specified didnt exist.
- * the directory must be closed with closedir() by the user.
+ * deletes the timers on closed_timers. call without the file table locked.
  */
-DIR* opendir(const char *name)
+static void __delete_closed_timers(void)
 {
-    DIR* dir = malloc(sizeof(DIR));
+    posix_timer_t* timer;
+    posix_timer_t* next;
 
-    if(dir)
+    taskENTER_CRITICAL();
+    timer = closed_timers;
+    closed_timers = NULL;
+    taskEXIT_CRITICAL();
+
+    for(; timer; timer = next)
     {
-        if(f_opendir(dir, (const TCHAR*)name) != FR_OK)
-        {
-            free(dir);
-            dir = NULL;
-        }
+        next = timer->next;
+        __delete_timer(timer);
     }
-
-    return dir;
 }
+
 /**
- * closes a directory opened with opendir.
- * returns 0 on success, or -1 on error.
+ * @retval  the time to the next expiry, 0 if the timer is disarmed, and the interval.
  */
-int closedir(DIR *dir)
+static void __timer_gettime(posix_timer_t* timer, struct itimerspec* value)
 {
-    if(dir)
+    TickType_t remaining = 0;
+    TickType_t interval;
+
+    taskENTER_CRITICAL();
+    if(timer->armed)
     {
-//        f_closedir(dir);
-        free(dir);
+        remaining = timer->expiry - xTaskGetTickCount();
+        // due, but the callback has not run yet
+        if(remaining == 0 || remaining > TIMER_MAX_TICKS)
+            remaining = 1;
     }
+    interval = timer->interval;
+    taskEXIT_CRITICAL();
 
-    return 0;
+    __ticks_to_timespec(remaining, &value->it_value);
+    __ticks_to_timespec(interval, &value->it_interval);
 }
 
 /**
- * reads directory info. returns a pointer to a struct dirent,
- * as long as there are entries in the directory.
- * returns NULL when there are no other entries in the directory.
+ * arms or disarms a timer, and clears the expirations not yet read.
  */
-struct dirent* readdir(DIR *dirp)
+static int __timer_settime(posix_timer_t* timer, int flags, const struct itimerspec* value, struct itimerspec* ovalue)
 {
-    FILINFO info;
-
-    info.lfname = _dirent.d_name;
-    info.lfsize = sizeof(_dirent.d_name);
-
-    _dirent.d_name[0] = '\0';
-    _dirent.d_type = DT_REG;
+    struct timespec delay;
+    struct timespec now;
+    TickType_t ticks = 0;
+    TickType_t interval = 0;
 
-    if(f_readdir(dirp, &info) != FR_OK || !info.fname[0])
-        return NULL;
+    if(!value || !__timespec_valid(&value->it_value) || !__timespec_valid(&value->it_interval))
+    {
+        errno = EINVAL;
+        return EOF;
+    }
 
-    if(_dirent.d_name[0] == '\0')
-        strcpy(_dirent.d_name, info.fname);
+    if(value->it_value.tv_sec || value->it_value.tv_nsec)
+    {
+        delay = value->it_value;
+        if(flags & TIMER_ABSTIME)
+        {
+            // a time that has already passed expires on the next tick
+            clock_gettime(timer->clock, &now);
+            delay.tv_sec -= now.tv_sec;
+            delay.tv_nsec -= now.tv_nsec;
+            if(delay.tv_nsec < 0)
+            {
+                delay.tv_nsec += 1000000000;
+                delay.tv_sec--;
+            }
+            if(delay.tv_sec < 0)
+                delay.tv_sec = delay.tv_nsec = 0;
+        }
+        ticks = __timespec_to_ticks(&delay);
+        if(ticks == 0)
+            ticks = 1;
+        interval = __timespec_to_ticks(&value->it_interval);
+    }
 
-    if(info.fattrib & AM_DIR)
-        _dirent.d_type = DT_DIR;
+    // value is read before ovalue is written, they may be the same
+    if(ovalue)
+        __timer_gettime(timer, ovalue);
 
-    return &_dirent;
-}
+    taskENTER_CRITICAL();
+    timer->armed = ticks != 0;
+    timer->expiry = xTaskGetTickCount() + ticks;
+    timer->interval = interval;
+    timer->expirations = 0;
+    timer->overrun = 0;
+    taskEXIT_CRITICAL();
 
-int chdir(const char *path)
-{
-    return f_chdir((TCHAR*)path) == FR_OK ? 0 : -1;
-}
+    if(ticks)
+        xTimerChangePeriod(timer->timer, ticks, portMAX_DELAY);
+    else
+        xTimerStop(timer->timer, portMAX_DELAY);
 
-int mkdir(const char *pathname, mode_t mode)
-{
-    (void)mode;
-    return f_mkdir(pathname) == FR_OK ? 0 : -1;
+    return 0;
 }
 
 /**
- * populates a struct stat type with:
+ * creates a timer.
  *
- *  - st_size	- the size of the file
- *  - st_mode 	- the mode of the file (S_IFCHR, S_IFREG, S_IFIFO, etc)
+ * there are no signals, event->sigev_notify may be SIGEV_NONE, or SIGEV_THREAD where newlib
+ * is built with _POSIX_THREADS, in which case sigev_notify_function is called in the FreeRTOS
+ * timer task, and must not block. a NULL event is taken as SIGEV_NONE. to wait for a timer
+ * alongside other descriptors, use timerfd_create().
  *
- *  ... from an open file.
+ * @param   clock_id is CLOCK_REALTIME or CLOCK_MONOTONIC, the clock absolute times are given on.
+ * @param   timerid receives the timer id.
+ * @retval  0 on success, or -1 on error with errno set.
  */
-int _fstat(int file, struct stat *st)
+int timer_create(clockid_t clock_id, struct sigevent* event, timer_t* timerid)
 {
-	int res = EOF;
-	if(file == STDIN_FILENO ||
-			file == STDOUT_FILENO ||
-			file == STDERR_FILENO ||
-			file == (intptr_t)stdout ||
-			file == (intptr_t)stderr ||
-			file == (intptr_t)stdin)
-	{
-		if(st)
-		{
-			st->st_size = 1;
-			st->st_mode = S_IFCHR;
-		}
-		res = 0;
-	}
-	else if(lock_filtab())
-	{
-		filtab_entry_t* fte = __get_entry(file);
-
-		if(fte)
-		{
-			if(fte->mode == S_IFREG)
-			{
-				if(st)
-					st->st_size = f_size(&fte->file);
-			}
-			if(fte->mode == S_IFIFO)
-			{
-				if(st)
-					st->st_size = fte->size;
-			}
+    posix_timer_t* timer;
 
-			if(st)
-				st->st_mode = fte->mode;
+    if((clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC) || !timerid ||
+       (event && event->sigev_notify != SIGEV_NONE
+#if defined(_POSIX_THREADS) && defined(SIGEV_THREAD)
+        && (event->sigev_notify != SIGEV_THREAD || !event->sigev_notify_function)
+#endif
+       ))
+    {
+        errno = EINVAL;
+        return EOF;
+    }
 
-			res = 0;
-		}
-		unlock_filtab();
-	}
+    timer = __create_timer(clock_id);
+    if(!timer)
+    {
+        errno = EAGAIN;
+        return EOF;
+    }
 
-	return res;
+#if defined(_POSIX_THREADS) && defined(SIGEV_THREAD)
+    if(event && event->sigev_notify == SIGEV_THREAD)
+    {
+        timer->notify = event->sigev_notify_function;
+        timer->value = event->sigev_value;
+    }
+#endif
+    *timerid = (timer_t)timer;
+    return 0;
 }
 
-long int _ftell(int file)
+/**
+ * disarms and deletes a timer.
+ */
+int timer_delete(timer_t timerid)
 {
-	int res = EOF;
-
-	if(lock_filtab())
-	{
-        filtab_entry_t* fte = __get_entry(file);
-
-        if(fte)
-        {
-            if(fte->mode == S_IFREG)
-                res = f_tell(&fte->file);
-        }
-        unlock_filtab();
-	}
-
-	return res;
+    if(!timerid)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
+    __delete_timer((posix_timer_t*)timerid);
+    __delete_closed_timers();
+    return 0;
 }
 
 /**
- * populates a struct stat type with:
- *
- *  - st_size	- the size of the file
- *  - st_mode 	- the mode of the file (S_IFCHR, S_IFREG, S_IFIFO, etc)
+ * arms or disarms a timer. times are rounded up to whole ticks.
  *
- *  ... from a file that is not already open.
+ * @param   flags may be TIMER_ABSTIME, value->it_value is then a time on the timer's clock.
+ * @param   value->it_value is the time to the first expiry, 0 to disarm the timer.
+ *          value->it_interval is the period after that, 0 for a one shot timer.
+ * @param   ovalue, if not NULL, receives the previous setting, as from timer_gettime().
+ * @retval  0 on success, or -1 on error with errno set.
  */
-int _stat(char *file, struct stat *st)
+int timer_settime(timer_t timerid, int flags, const struct itimerspec* value, struct itimerspec* ovalue)
 {
-	int res = EOF;
-	int fd = _open(file, O_RDONLY, 0);
-	if(fd == EOF)
-		return EOF;
-	res = _fstat(fd, st);
-	_close(fd);
-	return res;
+    if(!timerid)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
+    return __timer_settime((posix_timer_t*)timerid, flags, value, ovalue);
 }
 
 /**
- * returns 1 if the file is a device, or stdio endpoint, 0 otherwise.
- *
+ * @param   value receives the time to the next expiry, 0 if the timer is disarmed, and the interval.
+ * @retval  0 on success, or -1 on error with errno set.
  */
-int _isatty(int file)
+int timer_gettime(timer_t timerid, struct itimerspec* value)
 {
-	int res = 0;
-
-	if(file == STDIN_FILENO ||
-			file == STDOUT_FILENO ||
-			file == STDERR_FILENO ||
-			file == (intptr_t)stdout ||
-			file == (intptr_t)stderr ||
-			file == (intptr_t)stdin)
-		res = 1;
-	else if(lock_filtab())
-	{
-		filtab_entry_t* fte = __get_entry(file);
-		if(fte && (fte->mode == S_IFIFO))
-			res = 1;
-
-		unlock_filtab();
-	}
-	return res;
+    if(!timerid || !value)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
+    __timer_gettime((posix_timer_t*)timerid, value);
+    return 0;
 }
 
 /**
- * only works for files with mode = S_IFREG (not devices, or stdio's)
- *
- * SEEK_SET 	Offset is to be measured in absolute terms.
- * SEEK_CUR 	Offset is to be measured relative to the current location of the pointer.
- * SEEK_END 	Offset is to be measured back, relative to the end of the file.
+ * @retval  the number of periods missed at the last expiry, or -1 on error.
  */
-int _lseek(int file, int offset, int whence)
+int timer_getoverrun(timer_t timerid)
 {
-	int res = EOF;
-    if(lock_filtab())
+    if(!timerid)
     {
-        filtab_entry_t* fte = __get_entry(file);
-
-        if(fte)
-        {
-            if(fte->mode == S_IFREG)
-            {
-                if(whence == SEEK_CUR)
-                    offset = f_tell(&fte->file) + offset;
-                else if(whence == SEEK_END)
-                    offset = f_size(&fte->file) - offset;
-
-                if(f_lseek(&fte->file, offset) == FR_OK)
-                    res = 0;
-            }
-        }
-        unlock_filtab();
+        errno = EINVAL;
+        return EOF;
     }
-	return res;
+    return ((posix_timer_t*)timerid)->overrun;
 }
 
-int _unlink(char *name)
+/**
+ * reads the number of expirations since the timer was set or last read, as a uint64_t.
+ *
+ * the op is called with the file table locked, so with no expirations it fails with EAGAIN,
+ * and read() waits for the descriptor to become readable unless it is non blocking.
+ */
+static int timerfd_read(filtab_entry_t* fte, char* buffer, int count)
 {
-	FRESULT res = f_unlink((const TCHAR*)name);
-	return res == FR_OK ? 0 : EOF;
-}
+    posix_timer_t* timer = ((timerfd_entry_t*)fte)->timer;
+    uint64_t expirations;
 
-int rename(const char *oldname, const char *newname)
-{
-	FRESULT res = f_rename((const TCHAR*)oldname, (const TCHAR*)newname);
-	return res == FR_OK ? 0 : EOF;
-}
+    if(count < (int)sizeof(uint64_t))
+    {
+        errno = EINVAL;
+        return EOF;
+    }
 
-void _exit(int i)
-{
-	printf("Program exit with code %d", i);
-	while (1);
-}
+    taskENTER_CRITICAL();
+    expirations = timer->expirations;
+    timer->expirations = 0;
+    taskEXIT_CRITICAL();
 
-caddr_t _sbrk(int incr)
-{
-	(void)incr;
-    return NULL;
+    if(!expirations)
+    {
+        errno = EAGAIN;
+        return EOF;
+    }
+    memcpy(buffer, &expirations, sizeof(uint64_t));
+    return sizeof(uint64_t);
 }
 
-int _link(char *old, char *new)
+/**
+ * called with the file table locked, the timer is deleted by close() once it is unlocked.
+ */
+static int timerfd_close(filtab_entry_t* fte)
 {
-	(void)old;
-	(void)new;
-	errno = EMLINK;
-	return -1;
+    __close_timer(((timerfd_entry_t*)fte)->timer);
+    return 0;
 }
 
-int _execve(char *name, char **argv, char **env)
+/**
+ * a timerfd is readable when the timer has expired since it was set or last read.
+ */
+static int timerfd_poll(filtab_entry_t* fte)
 {
-	(void)name;
-	(void)argv;
-	(void)env;
-	errno = ENOMEM;
-	return -1;
+    return ((timerfd_entry_t*)fte)->timer->expirations ? VFS_POLLIN : 0;
 }
 
-int _fork()
-{
-	errno = EAGAIN;
-	return -1;
-}
+static const vfs_ops_t timerfd_ops = {
+    .read = timerfd_read,
+    .write = NULL,
+    .lseek = NULL,
+    .fstat = NULL,
+    .fsync = NULL,
+    .close = timerfd_close,
+    .poll = timerfd_poll,
+};
 
-int _getpid()
+/**
+ * @retval  the timer of a timerfd, or NULL. call with the file table locked.
+ */
+static posix_timer_t* __get_timerfd(int fd)
 {
-	return 1;
+    filtab_entry_t* fte = __get_entry(fd);
+    return (fte && fte->ops == &timerfd_ops) ? ((timerfd_entry_t*)fte)->timer : NULL;
 }
 
-int _kill(int pid, int sig)
+/**
+ * creates a timer that is read through a descriptor, so that it may be waited on with
+ * poll(), select() and epoll_wait(), alongside sockets and devices.
+ *
+ * @param   clock_id is CLOCK_REALTIME or CLOCK_MONOTONIC.
+ * @param   flags may be TFD_NONBLOCK and TFD_CLOEXEC. without TFD_NONBLOCK read() waits for the
+ *          timer to expire, TFD_NONBLOCK may also be set with fcntl(). TFD_CLOEXEC is ignored.
+ * @retval  the timer descriptor, or -1 on error.
+ */
+int timerfd_create(int clock_id, int flags)
 {
-	(void)pid;
-	(void)sig;
-	errno = EINVAL;
-	return (-1);
-}
+    posix_timer_t* timer;
+    filtab_entry_t* fte = NULL;
+    int file = EOF;
 
-int times(struct tm *buf)
-{
-	(void)buf;
-	return -1;
-}
+    if((clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC) || (flags & ~(TFD_NONBLOCK|TFD_CLOEXEC)))
+    {
+        errno = EINVAL;
+        return EOF;
+    }
 
-int _wait(int *status)
-{
-	(void)status;
-	errno = ECHILD;
-	return -1;
+    timer = __create_timer(clock_id);
+    if(timer && lock_filtab())
+    {
+        fte = __create_filtab_item(O_RDONLY | (flags & TFD_NONBLOCK), sizeof(timerfd_entry_t));
+        if(fte)
+        {
+            fte->ops = &timerfd_ops;
+            ((timerfd_entry_t*)fte)->timer = timer;
+            timer->fte = fte;
+            file = __insert_entry(fte);
+            if(file == EOF)
+                __delete_filtab_item(fte);
+        }
+        unlock_filtab();
+    }
+
+    if(file == EOF)
+    {
+        // once given to an entry, the timer is deleted with it
+        if(timer && !fte)
+            __delete_timer(timer);
+        __delete_closed_timers();
+        errno = ENOMEM;
+    }
+
+    return file;
 }
 
-_PTR _realloc_r(struct _reent *re, _PTR oldAddr, size_t newSize)
+/**
+ * arms or disarms a timerfd, as timer_settime(), and clears the expirations not yet read.
+ *
+ * @param   flags may be TFD_TIMER_ABSTIME.
+ * @retval  0 on success, or -1 on error with errno set.
+ */
+int timerfd_settime(int fd, int flags, const struct itimerspec* new_value, struct itimerspec* old_value)
 {
-	(void)re;
+    posix_timer_t* timer;
+    int res = EOF;
 
-	xBlockLink *block;
-	size_t toCopy;
-	void *newAddr;
+    if(lock_filtab())
+    {
+        timer = __get_timerfd(fd);
+        if(timer)
+            res = __timer_settime(timer, (flags & TFD_TIMER_ABSTIME) ? TIMER_ABSTIME : 0, new_value, old_value);
+        else
+            errno = EBADF;
+        unlock_filtab();
+    }
+    return res;
+}
 
-	newAddr = pvPortMalloc(newSize);
+/**
+ * @param   curr_value receives the time to the next expiry, 0 if the timer is disarmed, and the interval.
+ * @retval  0 on success, or -1 on error with errno set.
+ */
+int timerfd_gettime(int fd, struct itimerspec* curr_value)
+{
+    posix_timer_t* timer;
+    int res = EOF;
 
-	if (newAddr == NULL)
-		return NULL;
+    if(!curr_value)
+    {
+        errno = EINVAL;
+        return EOF;
+    }
 
-	/* We need the block struct pointer to get the current size */
-	block = oldAddr;
-	block -= heapSTRUCT_SIZE;
+    if(lock_filtab())
+    {
+        timer = __get_timerfd(fd);
+        if(timer)
+        {
+            __timer_gettime(timer, curr_value);
+            res = 0;
+        }
+        else
+            errno = EBADF;
+        unlock_filtab();
+    }
+    return res;
+}
 
-	/* determine the size to be copied */
-	toCopy = (newSize<block->xBlockSize)?(newSize):(block->xBlockSize);
+#endif
 
-	/* copy old block into new one */
-	memcpy((void *)newAddr, (void *)oldAddr, (size_t)toCopy);
+#if ENABLE_LIKEPOSIX_SOCKETS
 
-	vPortFree(oldAddr);
+/**
+ * wrapper for interfacing lwiip functions with like-posix.
+ * the descriptor is translated without the file table lock, and the lwIP function
+ * called without any like-posix lock held.
+ */
+#define SOCKET_WRAPPER(lwip_function, sockfd, ...)                  \
+    uint32_t word;                                                  \
+    int fd = __lookup_socket(sockfd, &word);                        \
+    if(fd == EOF) {                                                 \
+        errno = EBADF;                                              \
+        return EOF;                                                 \
+    }                                                               \
+    return __check_socket(sockfd, word, lwip_function(fd, __VA_ARGS__));
+
+#if ENABLE_LIKEPOSIX_SOCKET_EVENTS
+/**
+ * the event callback lwIP installs on socket netconns, chained by socket_event_callback().
+ */
+static netconn_callback lwip_event_callback;
 
-	return newAddr;
-}
+/**
+ * the file table entries of lwIP sockets, indexed by lwIP socket number less LWIP_SOCKET_OFFSET.
+ */
+static filtab_entry_t* socket_entries[NUM_SOCKETS];
 
-_PTR _calloc_r(struct _reent *re, size_t num, size_t size) {
-	(void)re;
-	return pvPortMalloc(num*size);
-}
+/**
+ * passes lwIP socket events on to lwIP, then reports them against the socket descriptor.
+ */
+static void socket_event_callback(struct netconn* conn, enum netconn_evt evt, u16_t len)
+{
+    int index;
 
-_PTR _malloc_r(struct _reent *re, size_t size) {
-	(void)re;
-	return pvPortMalloc(size);
-}
+    lwip_event_callback(conn, evt, len);
 
-_VOID _free_r(struct _reent *re, _PTR ptr) {
-	(void)re;
-	vPortFree(ptr);
+    index = conn->socket - LWIP_SOCKET_OFFSET;
+    taskENTER_CRITICAL();
+    __notify_entry(index >= 0 && index < NUM_SOCKETS ? socket_entries[index] : NULL, 0, NULL);
+    taskEXIT_CRITICAL();
 }
 
-int tcgetattr(int fildes, struct termios *termios_p)
+/**
+ * routes the events of an lwIP socket through socket_event_callback().
+ * connections accepted on a hooked socket inherit the callback from it.
+ */
+static void __hook_socket_events(filtab_entry_t* fte, int fd)
 {
-    int ret = -1;
-    if(termios_p == NULL || isatty(fildes) == 0)
-        return ret;
+    struct lwip_sock* sock = lwip_socket_dbg_get_socket(fd);
+    int index = fd - LWIP_SOCKET_OFFSET;
 
-    memset(termios_p, 0, sizeof(struct termios));
+    if(index >= 0 && index < NUM_SOCKETS)
+    {
+        taskENTER_CRITICAL();
+        socket_entries[index] = fte;
+        taskEXIT_CRITICAL();
+    }
 
-    if(fildes == STDOUT_FILENO || fildes == STDERR_FILENO || fildes == (intptr_t)stdout || fildes == (intptr_t)stderr)
+    if(sock && sock->conn && sock->conn->callback != socket_event_callback)
     {
-        termios_p->c_cflag = B115200|CS8;
-        ret = 0;
+        lwip_event_callback = sock->conn->callback;
+        sock->conn->callback = socket_event_callback;
     }
-    else if(fildes == STDIN_FILENO || fildes == (intptr_t)stdin)
+}
+#endif
+
+#if ENABLE_LIKEPOSIX_CORK
+#if SOCKET_CORK_TIMEOUT < 1
+#error SOCKET_CORK_TIMEOUT must be at least 1 millisecond
+#endif
+#if TCP_CORK == TCP_NODELAY || TCP_CORK == TCP_KEEPALIVE || (defined(TCP_KEEPIDLE) && (TCP_CORK == TCP_KEEPIDLE || TCP_CORK == TCP_KEEPINTVL || TCP_CORK == TCP_KEEPCNT))
+#error TCP_CORK has the value of an lwIP IPPROTO_TCP option, set it to another in likeposix_config.h
+#endif
+
+/**
+ * SOCKET_CORK_TIMEOUT in ticks, rounded up, so at least 1 at any tick rate.
+ */
+#define SOCKET_CORK_TICKS               ((TickType_t)(((uint64_t)SOCKET_CORK_TIMEOUT * configTICK_RATE_HZ + 999) / 1000))
+
+/**
+ * the write coalescing buffer of a stream socket.
+ *
+ * send() with MSG_MORE, or any write while TCP_CORK is set, adds to the buffer, which
+ * is sent whole when it fills, on the next write without MSG_MORE, when TCP_CORK is
+ * cleared, or SOCKET_CORK_TIMEOUT milliseconds after data was first held.
+ */
+struct _socket_cork_t {
+    SemaphoreHandle_t lock;         ///< held while the buffer is in use
+    TimerHandle_t timer;            ///< sends the buffer at the timeout
+    int fd;                         ///< the lwIP socket, -1 once it is closed
+    int refs;                       ///< held by the file table entry and each task using the cork
+    int corked;                     ///< set by TCP_CORK
+    int length;                     ///< the number of bytes held
+    char data[SOCKET_CORK_SIZE];    ///< the bytes held
+};
+
+/**
+ * sends the bytes held, followed by buffer, in a single lwIP write, so that they go out
+ * in full sized segments. with the cork locked.
+ *
+ * @retval  the number of bytes of buffer sent, or -1 on error. bytes held that could not
+ *          be sent, by a non blocking socket, stay held.
+ */
+static int __cork_flush(socket_cork_t* cork, const void* buffer, int count, int flags)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+    int n;
+
+    iov[0].iov_base = cork->data;
+    iov[0].iov_len = cork->length;
+    iov[1].iov_base = (void*)buffer;
+    iov[1].iov_len = count;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = cork->length ? iov : iov + 1;
+    msg.msg_iovlen = (cork->length ? 1 : 0) + (count ? 1 : 0);
+    if(!msg.msg_iovlen)
+        return 0;
+    if(cork->fd == EOF)
     {
-        termios_p->c_cflag = B115200|CS8;
-        ret = 0;
+        errno = EBADF;
+        return EOF;
     }
-    else if(lock_filtab())
+
+    n = lwip_sendmsg(cork->fd, &msg, flags);
+    if(n < 0)
+        return EOF;
+    if(n < cork->length)
     {
-        filtab_entry_t* fte = __get_entry(fildes);
+        memmove(cork->data, cork->data + n, cork->length - n);
+        cork->length -= n;
+        return 0;
+    }
+    n -= cork->length;
+    cork->length = 0;
+    return n;
+}
+
+/**
+ * sends the held bytes at the timeout. runs in the timer task, so never blocks, a task
+ * writing to the socket at the time sends or rearms the timer itself.
+ */
+static void __cork_timeout(TimerHandle_t timer)
+{
+    socket_cork_t* cork = (socket_cork_t*)pvTimerGetTimerID(timer);
 
-        if(fte->device && fte->device->ioctl)
+    if(xSemaphoreTake(cork->lock, 0) == pdTRUE)
+    {
+        if(cork->fd != EOF && cork->length)
         {
-            fte->device->termios = termios_p;
-            ret = fte->device->ioctl(fte->device);
-            fte->device->termios = NULL;
+            __cork_flush(cork, NULL, 0, MSG_DONTWAIT);
+            // lwIP's send buffer is full, try again later
+            if(cork->length)
+                xTimerStart(timer, 0);
         }
-        unlock_filtab();
+        xSemaphoreGive(cork->lock);
     }
+}
 
-    return ret;
+/**
+ * frees a cork, in the timer task, once its timer has been deleted.
+ */
+static void __free_cork(void* arg, uint32_t unused)
+{
+    socket_cork_t* cork = (socket_cork_t*)arg;
+    (void)unused;
+
+    vSemaphoreDelete(cork->lock);
+    vPortFree(cork);
 }
 
-int tcsetattr(int fildes, int when, const struct termios *termios_p)
+/**
+ * drops a reference to a cork, the last one frees it.
+ *
+ * the timer task runs its commands in order, so the cork is freed after its timer is
+ * deleted, and after any run of __cork_timeout() already due. should either command not
+ * be queued the cork is leaked, rather than freed under a timer that may still fire.
+ */
+static void __put_cork(socket_cork_t* cork)
 {
-    (void)when;
-    int ret = -1;
-    if(termios_p == NULL || isatty(fildes) == 0)
-        return ret;
+    int refs;
 
-    if(fildes == STDOUT_FILENO || fildes == STDERR_FILENO || fildes == (intptr_t)stdout || fildes == (intptr_t)stderr)
-    {
+    taskENTER_CRITICAL();
+    refs = --cork->refs;
+    taskEXIT_CRITICAL();
 
-    }
-    else if(fildes == STDIN_FILENO || fildes == (intptr_t)stdin)
-    {
+    if(!refs && xTimerDelete(cork->timer, portMAX_DELAY) == pdPASS)
+        xTimerPendFunctionCall(__free_cork, cork, 0, portMAX_DELAY);
+}
+
+/**
+ * writes to a socket through its cork.
+ *
+ * @retval  the number of bytes written or held, or -1 on error.
+ */
+static int __cork_send(socket_cork_t* cork, const void* buffer, int count, int flags)
+{
+    int n = 0;
+    int chunk;
+
+    xSemaphoreTake(cork->lock, portMAX_DELAY);
 
+    if((flags & MSG_MORE) || cork->corked)
+    {
+        // hold the data, sending the buffer each time it fills
+        while(n < count)
+        {
+            chunk = SOCKET_CORK_SIZE - cork->length;
+            if(chunk > count - n)
+                chunk = count - n;
+            memcpy(cork->data + cork->length, (const char*)buffer + n, chunk);
+            cork->length += chunk;
+            n += chunk;
+            if(cork->length == SOCKET_CORK_SIZE &&
+                (__cork_flush(cork, NULL, 0, flags | MSG_MORE) == EOF || cork->length == SOCKET_CORK_SIZE))
+                break;
+        }
+        if(cork->length && xTimerIsTimerActive(cork->timer) == pdFALSE)
+            xTimerStart(cork->timer, 0);
+        if(!n && count)
+            n = EOF;
     }
-    else if(lock_filtab())
+    else
     {
-        filtab_entry_t* fte = __get_entry(fildes);
-
-        if(fte->device && fte->device->ioctl)
+        n = __cork_flush(cork, buffer, count, flags);
+        if(!n && count)
         {
-            fte->device->termios = (struct termios *)termios_p;
-            ret = fte->device->ioctl(fte->device);
-            fte->device->termios = NULL;
+            errno = EWOULDBLOCK;
+            n = EOF;
         }
-        unlock_filtab();
     }
 
-    return ret;
+    xSemaphoreGive(cork->lock);
+    return n;
 }
 
-speed_t cfgetispeed(const struct termios* termios)
-{
-    return termios->c_ispeed;
-}
-speed_t cfgetospeed(const struct termios* termios)
+/**
+ * clears TCP_CORK and sends the held bytes.
+ */
+static int __uncork(socket_cork_t* cork, int flags)
 {
-    return termios->c_ospeed;
-}
+    int res;
 
-int cfsetispeed(struct termios* termios, speed_t ispeed)
-{
-    termios->c_ispeed = ispeed;
-    return 0;
+    xSemaphoreTake(cork->lock, portMAX_DELAY);
+    cork->corked = 0;
+    res = __cork_flush(cork, NULL, 0, flags) == EOF ? EOF : 0;
+    xSemaphoreGive(cork->lock);
+    return res;
 }
-int cfsetospeed(struct termios* termios, speed_t ospeed)
+
+/**
+ * finds the cork of a socket translated by __lookup_socket(), without the file table lock.
+ * the entry is removed, and its translation word changed, before the entry is freed, so
+ * while the word is unchanged the entry and its cork are still there.
+ *
+ * @retval  the cork, with a reference to drop with __put_cork(), or NULL if it hasn't one.
+ */
+static socket_cork_t* __lookup_cork(int sockfd, uint32_t word)
 {
-    termios->c_ospeed = ospeed;
-    return 0;
+    filtab_entry_t* fte;
+    socket_cork_t* cork = NULL;
+
+    taskENTER_CRITICAL();
+    fte = filtab.tab[sockfd - FILE_TABLE_OFFSET];
+    if(fte && filtab.sockets[sockfd - FILE_TABLE_OFFSET] == word && (cork = __socket(fte)->cork))
+        cork->refs++;
+    taskEXIT_CRITICAL();
+    return cork;
 }
 
-int tcdrain(int file)
+/**
+ * gives a stream socket a cork, datagram sockets are not coalesced.
+ *
+ * @retval  the cork, with a reference to drop with __put_cork(), or NULL if the socket
+ *          is not a stream socket or on error.
+ */
+static socket_cork_t* __create_cork(int sockfd, uint32_t word, int fd)
 {
-    unsigned long timeout;
-    int res = EOF;
+    socket_cork_t* cork = NULL;
+    int type = 0;
+    socklen_t length = sizeof(type);
 
-    if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
-    {
-        res = 0;
-    }
-    else if(file == STDIN_FILENO || file == (intptr_t)stdin)
+    if(lwip_getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) != 0 || type != SOCK_STREAM)
     {
-        res = 0;
+        errno = ENOPROTOOPT;
+        return NULL;
     }
-    else if(lock_filtab())
-    {
-        filtab_entry_t* fte = __get_entry(file);
 
-        if(fte)
+    if(lock_filtab())
+    {
+        if(filtab.sockets[sockfd - FILE_TABLE_OFFSET] == word)
         {
-            if(fte->mode == S_IFIFO)
+            cork = __socket(filtab.tab[sockfd - FILE_TABLE_OFFSET])->cork;
+            if(cork)
             {
-                timeout = get_hw_time_ms() + fte->device->timeout;
-                while(uxQueueMessagesWaiting(fte->device->pipe.write) > 0 && get_hw_time_ms() < timeout)
-                    portYIELD();
-
-                if(get_hw_time_ms() < timeout)
-                    res = 0;
+                taskENTER_CRITICAL();
+                cork->refs++;
+                taskEXIT_CRITICAL();
+            }
+            else if((cork = (socket_cork_t*)pvPortMalloc(sizeof(socket_cork_t))))
+            {
+                cork->lock = xSemaphoreCreateMutex();
+                cork->timer = xTimerCreate("cork", SOCKET_CORK_TICKS, pdFALSE, cork, __cork_timeout);
+                cork->fd = fd;
+                // one for the entry, one for the caller
+                cork->refs = 2;
+                cork->corked = 0;
+                cork->length = 0;
+                if(cork->lock && cork->timer)
+                    __socket(filtab.tab[sockfd - FILE_TABLE_OFFSET])->cork = cork;
+                else
+                {
+                    if(cork->lock)
+                        vSemaphoreDelete(cork->lock);
+                    if(cork->timer)
+                        xTimerDelete(cork->timer, 0);
+                    vPortFree(cork);
+                    cork = NULL;
+                }
             }
+            if(!cork)
+                errno = ENOMEM;
         }
         unlock_filtab();
     }
+    return cork;
+}
 
-    return res;
+/**
+ * detaches the cork of a closing socket, with the file table locked, and sends what it
+ * holds without blocking. a task writing to the socket may be blocked in lwIP with the
+ * cork locked, its held bytes are then lost as the socket closes under it, as they would
+ * be by a close() a moment earlier. the cork is freed once that task lets it go.
+ */
+static void __close_cork(filtab_entry_t* fte)
+{
+    socket_cork_t* cork = __socket(fte)->cork;
+
+    __socket(fte)->cork = NULL;
+    if(xSemaphoreTake(cork->lock, 0) == pdTRUE)
+    {
+        __cork_flush(cork, NULL, 0, MSG_DONTWAIT);
+        xSemaphoreGive(cork->lock);
+    }
+    cork->fd = EOF;
+    __put_cork(cork);
 }
+#endif
 
+#if ENABLE_LIKEPOSIX_ZEROCOPY
 /**
- * not implemented....
+ * the tasks holding each lwIP socket open, see __hold_socket(). changed in critical sections.
  */
-int tcflow(int file, int flags)
+static struct {
+    int count;                  ///< the tasks holding the socket
+    int closing;                ///< set if the socket was closed while held
+} socket_holds[NUM_SOCKETS];
+
+/**
+ * keeps a socket translated by __lookup_socket() open until __release_socket(), so that its
+ * netconn stays valid and lwIP doesn't give its number to another socket. a close() in the
+ * meantime removes the descriptor at once, and closes the lwIP socket on the release.
+ *
+ * @retval  0, or -1 if the descriptor was closed after it was translated.
+ */
+static int __hold_socket(int sockfd, uint32_t word, int fd)
 {
+    int index = fd - LWIP_SOCKET_OFFSET;
     int res = EOF;
 
-    if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
+    taskENTER_CRITICAL();
+    if(index >= 0 && index < NUM_SOCKETS && filtab.sockets[sockfd - FILE_TABLE_OFFSET] == word)
     {
+        socket_holds[index].count++;
         res = 0;
     }
-    else if(file == STDIN_FILENO || file == (intptr_t)stdin)
+    taskEXIT_CRITICAL();
+    return res;
+}
+
+static void __release_socket(int fd)
+{
+    int index = fd - LWIP_SOCKET_OFFSET;
+    int close = 0;
+
+    taskENTER_CRITICAL();
+    if(--socket_holds[index].count == 0 && socket_holds[index].closing)
     {
-        res = 0;
+        socket_holds[index].closing = 0;
+        close = 1;
     }
-    else if(lock_filtab())
-    {
-        filtab_entry_t* fte = __get_entry(file);
+    taskEXIT_CRITICAL();
 
-        if(fte)
-        {
-            if(fte->mode == S_IFIFO)
-            {
-                (void)flags;
-                res = EOF;
-            }
-        }
-        unlock_filtab();
+    if(close)
+        lwip_close(fd);
+}
+
+/**
+ * @retval  nonzero if the socket is held, its lwIP socket is then closed by the last release.
+ */
+static int __defer_socket_close(int fd)
+{
+    int index = fd - LWIP_SOCKET_OFFSET;
+    int held = 0;
+
+    taskENTER_CRITICAL();
+    if(index >= 0 && index < NUM_SOCKETS && socket_holds[index].count)
+    {
+        socket_holds[index].closing = 1;
+        held = 1;
     }
-    return res;
+    taskEXIT_CRITICAL();
+    return held;
 }
+#endif
 
-int tcflush(int file, int flags)
+static int socket_read(filtab_entry_t* fte, char* buffer, int count)
 {
-    int res = EOF;
+    return lwip_read(__socket_fd(fte), buffer, count);
+}
 
-    if(file == STDOUT_FILENO || file == STDERR_FILENO || file == (intptr_t)stdout || file == (intptr_t)stderr)
+static int socket_write(filtab_entry_t* fte, const char* buffer, int count)
+{
+    return lwip_write(__socket_fd(fte), buffer, count);
+}
+
+static int socket_close(filtab_entry_t* fte)
+{
+#if ENABLE_LIKEPOSIX_SOCKET_EVENTS
+    int index = __socket_fd(fte) - LWIP_SOCKET_OFFSET;
+
+    if(index >= 0 && index < NUM_SOCKETS)
     {
-        res = 0;
+        taskENTER_CRITICAL();
+        socket_entries[index] = NULL;
+        taskEXIT_CRITICAL();
     }
-    else if(file == STDIN_FILENO || file == (intptr_t)stdin)
+#endif
+#if ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+    if(__socket(fte)->slots)
+        __put_slots(__socket(fte)->slots);
+#endif
+#if ENABLE_LIKEPOSIX_CORK
+    if(__socket(fte)->cork)
+        __close_cork(fte);
+#endif
+#if ENABLE_LIKEPOSIX_ZEROCOPY
+    if(__defer_socket_close(__socket_fd(fte)))
+        return 0;
+#endif
+    return lwip_close(__socket_fd(fte));
+}
+
+static int socket_poll(filtab_entry_t* fte)
+{
+    int fd = __socket_fd(fte);
+    int events = 0;
+    fd_set rfds;
+    fd_set wfds;
+    fd_set efds;
+    struct timeval tv = {0, 0};
+
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&efds);
+    FD_SET(fd, &rfds);
+    FD_SET(fd, &wfds);
+    FD_SET(fd, &efds);
+
+    if(lwip_select(fd + 1, &rfds, &wfds, &efds, &tv) > 0)
+    {
+        if(FD_ISSET(fd, &rfds))
+            events |= VFS_POLLIN;
+        if(FD_ISSET(fd, &wfds))
+            events |= VFS_POLLOUT;
+        if(FD_ISSET(fd, &efds))
+            events |= VFS_POLLERR;
+    }
+    return events;
+}
+
+static const vfs_ops_t socket_ops = {
+    .read = socket_read,
+    .write = socket_write,
+    .lseek = NULL,
+    .fstat = NULL,
+    .fsync = NULL,
+    .close = socket_close,
+    .poll = socket_poll,
+};
+
+/**
+ * allocates the entry for a new socket, with the file table locked. a connection accepted
+ * on a listening socket that has reserved entries takes one of them, while any are free.
+ *
+ * @param   listener is the listening socket descriptor, or -1.
+ * @param   word is the translation word of the listener, see __lookup_socket().
+ */
+static filtab_entry_t* __create_socket_item(int listener, uint32_t word)
+{
+#if ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+    accept_slots_t* slots = NULL;
+    filtab_entry_t* fte;
+
+    // the listener may have been closed, or its slot reused, while accept() was in lwIP
+    if(listener != EOF && filtab.sockets[listener - FILE_TABLE_OFFSET] == word)
+        slots = __socket(filtab.tab[listener - FILE_TABLE_OFFSET])->slots;
+
+    if(slots && (fte = (filtab_entry_t*)pool_alloc(&slots->pool)))
     {
-        res = 0;
+        memset(fte, 0, sizeof(socket_entry_t));
+        fte->flags = O_RDWR+1;
+        __socket(fte)->owner = slots;
+        slots->refs++;
+        return fte;
     }
-    else if(lock_filtab())
-    {
-        filtab_entry_t* fte = __get_entry(file);
+#else
+    (void)listener;
+    (void)word;
+#endif
+    return __create_filtab_item(O_RDWR, sizeof(socket_entry_t));
+}
+
+/**
+ * adds an lwip socket to the file table.
+ *
+ * @param   listener is the listening socket descriptor fd was accepted on, or -1.
+ * @param   word is the translation word of the listener, see __lookup_socket().
+ * @retval  the file descriptor, or -1 on error. the lwip socket is closed on error.
+ */
+static int __insert_socket(int fd, int listener, uint32_t word)
+{
+    int file = EOF;
+    filtab_entry_t* fte = NULL;
 
+    if(lock_filtab())
+    {
+        fte = __create_socket_item(listener, word);
         if(fte)
         {
-            if(fte->mode == S_IFIFO)
+            fte->mode = S_IFSOCK;
+            fte->ctx = (void*)(intptr_t)fd;
+            fte->ops = &socket_ops;
+#if ENABLE_LIKEPOSIX_SOCKET_EVENTS
+            __hook_socket_events(fte, fd);
+#endif
+            // add file to table
+            file = __insert_entry(fte);
+            if(file == EOF)
+                __delete_filtab_item(fte);
+            else
             {
-                if(flags == TCIFLUSH)
-                {
-                    xQueueReset(fte->device->pipe.read);
-                    res = 0;
-                }
-
-                else if(flags == TCOFLUSH)
-                {
-                    xQueueReset(fte->device->pipe.write);
-                    res = 0;
-                }
-
-                else if(flags == TCIOFLUSH)
-                {
-                    xQueueReset(fte->device->pipe.write);
-                    xQueueReset(fte->device->pipe.read);
-                    res = 0;
-                }
+                // publish the translation, under the next generation of the slot
+                uint32_t current = filtab.sockets[file - FILE_TABLE_OFFSET];
+                filtab.sockets[file - FILE_TABLE_OFFSET] = ((current & ~SOCKET_MAP_FD_MASK) + SOCKET_MAP_GENERATION) | (uint32_t)(fd + 1);
             }
         }
         unlock_filtab();
     }
-    return res;
-}
 
-#if ENABLE_LIKEPOSIX_SOCKETS
+    if(!fte)
+        lwip_close(fd);
+
+    return file;
+}
 
+#if ENABLE_LIKEPOSIX_ACCEPT_SLOTS
 /**
- * wrapper for interfacing lwiip functions with like-posix
+ * reserves entries for the connections to be accepted on a listening socket, so that
+ * accept() doesn't allocate while they last. a failed reservation isn't an error,
+ * accept() then allocates entries as it would without one.
  */
-#define SOCKET_WRAPPER(lwip_function, sockfd, ...)                  \
-    int res = EOF; if(lock_filtab()){                               \
-    filtab_entry_t* fte = __get_entry(sockfd);                      \
-    if(fte && (fte->mode == S_IFSOCK))                               \
-        res = lwip_function((int)fte->device, __VA_ARGS__);         \
-    unlock_filtab();                                                \
-} return res;
+static void __reserve_slots(int sockfd, uint32_t word, int conns)
+{
+    accept_slots_t* slots;
+
+    if(conns > ACCEPT_SLOTS_MAX)
+        conns = ACCEPT_SLOTS_MAX;
+    if(conns <= 0)
+        return;
+
+    slots = (accept_slots_t*)pvPortMalloc(sizeof(accept_slots_t) + conns * sizeof(socket_entry_t));
+    if(!slots)
+        return;
+    pool_init(&slots->pool, slots->objects, sizeof(socket_entry_t), conns);
+    slots->refs = 1;
+
+    if(lock_filtab())
+    {
+        // listen() may be called again on a listening socket, the first reservation stays
+        if(filtab.sockets[sockfd - FILE_TABLE_OFFSET] == word && !__socket(filtab.tab[sockfd - FILE_TABLE_OFFSET])->slots)
+        {
+            __socket(filtab.tab[sockfd - FILE_TABLE_OFFSET])->slots = slots;
+            slots = NULL;
+        }
+        unlock_filtab();
+    }
 
+    if(slots)
+        vPortFree(slots);
+}
+#endif
 
 /**
  * creates anew socket and adds it to the file table.
@@ -1334,99 +4559,150 @@ int tcflush(int file, int flags)
  */
 int socket(int namespace, int style, int protocol)
 {
-    int file = EOF;
+    int fd;
 
     if(filtab.count > FILE_TABLE_LENGTH)
         return EOF;
 
-    // create new file table node
-    filtab_entry_t* ftn = (filtab_entry_t*)pvPortMalloc(sizeof(filtab_entry_t));
+    fd = lwip_socket(namespace, style, protocol);
 
-    if(!ftn)
+    if(fd == -1)
         return EOF;
 
-    ftn->mode = S_IFSOCK;
-    ftn->flags = FWRITE | FREAD;
-    ftn->device = NULL;
-    ftn->size = 0;
+    return __insert_socket(fd, EOF, 0);
+}
 
-    file = lwip_socket(namespace, style, protocol);
+/**
+ * accepts a connection on a listening socket.
+ *
+ * several tasks may wait in accept() on the same listening socket, lwIP hands each
+ * connection to one of them. with ENABLE_LIKEPOSIX_ACCEPT_SLOTS, the entry for the
+ * connection is drawn from those reserved by listen() while any are free.
+ */
+int accept(int sockfd, struct sockaddr *addr, socklen_t *length_ptr)
+{
+    uint32_t word;
+    int fd;
 
-    if(file == -1)
-        return file;
+    if(filtab.count > FILE_TABLE_LENGTH)
+        return EOF;
 
-    // hack socket file descriptor on as the device
-    ftn->device = (dev_ioctl_t*)file;
-    file = EOF;
+    fd = __lookup_socket(sockfd, &word);
+    if(fd == EOF)
+    {
+        errno = EBADF;
+        return EOF;
+    }
 
-    if(lock_filtab())
+    // fd is now the accepted socket fdes
+    fd = lwip_accept(fd, addr, length_ptr);
+    if(__check_socket(sockfd, word, fd) == EOF)
     {
-        // add file to table
-        file = __insert_entry(ftn);
-        unlock_filtab();
+        // the listener was closed while accept() was in lwIP
+        if(fd >= 0)
+            lwip_close(fd);
+        return EOF;
     }
 
-    if(file == EOF)
-        __delete_filtab_item(ftn);
+    return __insert_socket(fd, sockfd, word);
+}
 
-    return file;
+static int __connect(int sockfd, struct sockaddr *addr, socklen_t length)
+{
+    SOCKET_WRAPPER(lwip_connect, sockfd, addr, length);
 }
 
 /**
- * TODO - reuse code from socket in accept.
+ * @retval  the longest a blocking connect() on the socket may wait, in milliseconds,
+ *          its SO_SNDTIMEO if set, otherwise SOCKET_CONNECT_TIMEOUT.
  */
-int accept(int sockfd, struct sockaddr *addr, socklen_t *length_ptr)
+static int __connect_timeout(int sockfd)
 {
-    if(filtab.count > FILE_TABLE_LENGTH)
-        return EOF;
-
-//    if(lock_filtab())
-//    {
-        filtab_entry_t* fte = __get_entry(sockfd);
-        sockfd = EOF;
-        if(fte && (fte->mode == S_IFSOCK))
-            sockfd = lwip_accept((int)fte->device, addr, length_ptr);
-//        unlock_filtab();
-//    }
-
-    // sockfd is now the accepted socket fdes
-
-    if(sockfd == -1)
-        return EOF;
-
-    // create new file table node
-    filtab_entry_t* ftn = (filtab_entry_t*)pvPortMalloc(sizeof(filtab_entry_t));
+#if LWIP_SO_SNDTIMEO
+#if LWIP_SO_SNDRCVTIMEO_NONSTANDARD
+    int tv = 0;
+#else
+    struct timeval tv = {0, 0};
+#endif
+    socklen_t length = sizeof(tv);
 
-    if(!ftn)
+    if(getsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv, &length) == 0)
     {
-        lwip_close(sockfd);
-        return EOF;
+#if LWIP_SO_SNDRCVTIMEO_NONSTANDARD
+        if(tv > 0)
+            return tv;
+#else
+        if(tv.tv_sec > 0 || tv.tv_usec > 0)
+            return tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+#endif
     }
+#else
+    (void)sockfd;
+#endif
+    return SOCKET_CONNECT_TIMEOUT;
+}
 
-    ftn->mode = S_IFSOCK;
-    ftn->flags = FWRITE | FREAD;
-    ftn->size = 0;
-    // hack sockfd file descriptor on as the device
-    ftn->device = (dev_ioctl_t*)sockfd;
-    sockfd = EOF;
+/**
+ * connects a blocking socket, waiting at most timeout milliseconds. the socket is
+ * made non-blocking for the attempt, and restored after.
+ */
+static int __connect_timed(int sockfd, struct sockaddr *addr, socklen_t length, int timeout, int flags)
+{
+    struct pollfd pfd = {.fd = sockfd, .events = POLLOUT, .revents = 0};
+    socklen_t errlen = sizeof(int);
+    int err = 0;
+    int res;
 
-    if(lock_filtab())
+    if(fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) == EOF)
+        return EOF;
+
+    res = __connect(sockfd, addr, length);
+    if(res == EOF && errno == EINPROGRESS)
     {
-        // add file to table
-        sockfd = __insert_entry(ftn);
-        // sockfd is now the file table entry fdes
-        unlock_filtab();
+        res = poll(&pfd, 1, timeout);
+        if(res == 1)
+        {
+            res = getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+            if(res == 0 && err)
+            {
+                res = EOF;
+                errno = err;
+            }
+        }
+        else if(res == 0)
+        {
+            // still connecting, as for Linux, the caller may wait on or close the socket
+            res = EOF;
+            errno = EINPROGRESS;
+        }
     }
 
-    if(sockfd == EOF)
-        __delete_filtab_item(ftn);
-
-    return sockfd;
+    err = errno;
+    fcntl(sockfd, F_SETFL, flags);
+    errno = err;
+    return res;
 }
 
+/**
+ * connects a socket.
+ *
+ * on a non-blocking socket, made so with fcntl(), connect() fails with EINPROGRESS while
+ * the connection is made. the socket then polls writable once the attempt completes, and
+ * SO_ERROR, read with getsockopt(), holds its outcome, so that a task may open connections
+ * to several peers at once with poll(), select() or epoll_wait().
+ *
+ * a blocking socket waits at most its SO_SNDTIMEO, or SOCKET_CONNECT_TIMEOUT milliseconds if
+ * that is not set, as for Linux. connect() then fails with EINPROGRESS, the attempt carries on.
+ */
 int connect(int sockfd, struct sockaddr *addr, socklen_t length)
 {
-    SOCKET_WRAPPER(lwip_connect, sockfd, addr, length);
+    int flags = fcntl(sockfd, F_GETFL);
+    int timeout;
+
+    if(flags != EOF && !(flags & O_NONBLOCK) && (timeout = __connect_timeout(sockfd)) > 0)
+        return __connect_timed(sockfd, addr, length, timeout, flags);
+
+    return __connect(sockfd, addr, length);
 }
 
 int bind(int sockfd, struct sockaddr *addr, socklen_t length)
@@ -1436,6 +4712,19 @@ int bind(int sockfd, struct sockaddr *addr, socklen_t length)
 
 int shutdown(int sockfd, int how)
 {
+#if ENABLE_LIKEPOSIX_CORK
+    {
+        uint32_t held;
+        socket_cork_t* cork;
+
+        // held bytes go out before the FIN
+        if(how != SHUT_RD && __lookup_socket(sockfd, &held) != EOF && (cork = __lookup_cork(sockfd, held)))
+        {
+            __uncork(cork, 0);
+            __put_cork(cork);
+        }
+    }
+#endif
     SOCKET_WRAPPER(lwip_shutdown, sockfd, how);
 }
 
@@ -1449,19 +4738,114 @@ int getpeername(int sockfd, struct sockaddr *addr, socklen_t *length)
     SOCKET_WRAPPER(lwip_getpeername, sockfd, addr, length);
 }
 
+#if ENABLE_LIKEPOSIX_CORK
+/**
+ * sets or clears TCP_CORK. clearing it sends the held bytes.
+ */
+static int __set_cork(int sockfd, const void* optval, socklen_t optlen)
+{
+    uint32_t word;
+    socket_cork_t* cork;
+    int res;
+    int fd = __lookup_socket(sockfd, &word);
+
+    if(fd == EOF)
+    {
+        errno = EBADF;
+        return EOF;
+    }
+    if(!optval || optlen < sizeof(int))
+    {
+        errno = EINVAL;
+        return EOF;
+    }
+
+    cork = __lookup_cork(sockfd, word);
+    if(!*(const int*)optval)
+    {
+        if(!cork)
+            return 0;
+        res = __uncork(cork, 0);
+        __put_cork(cork);
+        return __check_socket(sockfd, word, res);
+    }
+
+    if(!cork && !(cork = __create_cork(sockfd, word, fd)))
+        return EOF;
+    xSemaphoreTake(cork->lock, portMAX_DELAY);
+    cork->corked = 1;
+    xSemaphoreGive(cork->lock);
+    __put_cork(cork);
+    return 0;
+}
+#endif
+
+/**
+ * with ENABLE_LIKEPOSIX_CORK, TCP_CORK may be set at level IPPROTO_TCP, as for Linux.
+ * while it is set writes are held, and sent in full sized segments.
+ */
 int setsockopt(int sockfd, int level, int optname, void *optval, socklen_t optlen)
 {
+#if ENABLE_LIKEPOSIX_CORK
+    if(level == IPPROTO_TCP && optname == TCP_CORK)
+        return __set_cork(sockfd, optval, optlen);
+#endif
     SOCKET_WRAPPER(lwip_setsockopt, sockfd, level, optname, optval, optlen);
 }
 
 int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optlen)
 {
+#if ENABLE_LIKEPOSIX_CORK
+    if(level == IPPROTO_TCP && optname == TCP_CORK)
+    {
+        uint32_t word;
+        socket_cork_t* cork;
+
+        if(__lookup_socket(sockfd, &word) == EOF)
+        {
+            errno = EBADF;
+            return EOF;
+        }
+        if(!optval || !optlen || *optlen < sizeof(int))
+        {
+            errno = EINVAL;
+            return EOF;
+        }
+        cork = __lookup_cork(sockfd, word);
+        *(int*)optval = cork ? cork->corked : 0;
+        *optlen = sizeof(int);
+        if(cork)
+            __put_cork(cork);
+        return 0;
+    }
+#endif
     SOCKET_WRAPPER(lwip_getsockopt, sockfd, level, optname, optval, optlen);
 }
 
+/**
+ * marks a socket as listening. with ENABLE_LIKEPOSIX_ACCEPT_SLOTS, up to n entries, at most
+ * ACCEPT_SLOTS_MAX, are reserved for the connections accepted on it. servers pass the number
+ * of connections they serve at once, conns in their configuration files.
+ */
 int listen(int sockfd, int n)
 {
+#if ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+    uint32_t word;
+    int fd = __lookup_socket(sockfd, &word);
+
+    if(fd == EOF)
+    {
+        errno = EBADF;
+        return EOF;
+    }
+    if(__check_socket(sockfd, word, lwip_listen(fd, n)) == EOF)
+        return EOF;
+
+    __reserve_slots(sockfd, word, n);
+    return 0;
+#else
     SOCKET_WRAPPER(lwip_listen, sockfd, n);
+#endif
 }
 
 int recv(int sockfd, void *buffer, size_t size, int flags)
@@ -1474,9 +4858,37 @@ int recvfrom(int sockfd, void *buffer, size_t size, int flags, struct sockaddr *
     SOCKET_WRAPPER(lwip_recvfrom, sockfd, buffer, size, flags, addr, length);
 }
 
+/**
+ * with ENABLE_LIKEPOSIX_CORK, MSG_MORE holds the data on a stream socket, to be sent
+ * with what follows it, see socket_cork_t.
+ */
 int send(int sockfd, const void *buffer, size_t size, int flags)
 {
+#if ENABLE_LIKEPOSIX_CORK
+    uint32_t word;
+    socket_cork_t* cork;
+    int res;
+    int fd = __lookup_socket(sockfd, &word);
+
+    if(fd == EOF)
+    {
+        errno = EBADF;
+        return EOF;
+    }
+
+    cork = __lookup_cork(sockfd, word);
+    if(!cork && (flags & MSG_MORE))
+        cork = __create_cork(sockfd, word, fd);
+    if(cork)
+    {
+        res = __cork_send(cork, buffer, (int)size, flags);
+        __put_cork(cork);
+        return __check_socket(sockfd, word, res);
+    }
+    return __check_socket(sockfd, word, lwip_send(fd, buffer, size, flags));
+#else
     SOCKET_WRAPPER(lwip_send, sockfd, buffer, size, flags);
+#endif
 }
 
 int sendto(int sockfd, const void *buffer, size_t size, int flags, struct sockaddr *addr, socklen_t length)
@@ -1484,26 +4896,240 @@ int sendto(int sockfd, const void *buffer, size_t size, int flags, struct sockad
     SOCKET_WRAPPER(lwip_sendto, sockfd, buffer, size, flags, addr, length);
 }
 
+#if ENABLE_LIKEPOSIX_MMSG
+/**
+ * receives up to vlen datagrams, with a single descriptor translation.
+ *
+ * waits, as flags and the socket allow, for the first datagram only, then takes those
+ * already queued, as Linux does with MSG_WAITFORONE. the timeout is not supported, except
+ * that a zero timeout doesn't wait at all, pass NULL.
+ *
+ * @retval  the number of datagrams received, with msg_len and msg_hdr.msg_namelen,
+ *          msg_flags set for each, or -1 if none were received.
+ */
+int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags, struct timespec* timeout)
+{
+    uint32_t word;
+    unsigned int i;
+    int n;
+    int fd = __lookup_socket(sockfd, &word);
+
+    if(fd == EOF)
+    {
+        errno = EBADF;
+        return EOF;
+    }
+
+    if(timeout && !timeout->tv_sec && !timeout->tv_nsec)
+        flags |= MSG_DONTWAIT;
+
+    for(i = 0; i < vlen; i++)
+    {
+        n = lwip_recvmsg(fd, &msgvec[i].msg_hdr, flags);
+        if(n < 0)
+            break;
+        msgvec[i].msg_len = n;
+        flags |= MSG_DONTWAIT;
+    }
+
+    return i ? (int)i : __check_socket(sockfd, word, EOF);
+}
+
 /**
- * TODO - finish me
+ * sends up to vlen datagrams, with a single descriptor translation.
+ *
+ * @retval  the number of datagrams sent, with msg_len set for each, or -1 if none were sent.
  */
-//int select(int nfds, fd_set *read-fds, fd_set *write-fds, fd_set *except-fds, struct timeval *timeout)
-//{
-//    SOCKET_WRAPPER(lwip_select, sockfd, buffer, size, flags, addr, length);
-//}
+int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags)
+{
+    uint32_t word;
+    unsigned int i;
+    int n;
+    int fd = __lookup_socket(sockfd, &word);
+
+    if(fd == EOF)
+    {
+        errno = EBADF;
+        return EOF;
+    }
+
+    for(i = 0; i < vlen; i++)
+    {
+        n = lwip_sendmsg(fd, &msgvec[i].msg_hdr, flags);
+        if(n < 0)
+            break;
+        msgvec[i].msg_len = n;
+    }
 
+    return i ? (int)i : __check_socket(sockfd, word, EOF);
+}
+#endif
+
+/**
+ * FIONBIO goes through fcntl(), so that F_GETFL reports O_NONBLOCK however it was set.
+ */
 int ioctlsocket(int sockfd, int cmd, void* argp)
 {
+    if(cmd == (int)FIONBIO && argp)
+    {
+        uint32_t held;
+
+        if(__lookup_socket(sockfd, &held) == EOF)
+        {
+            errno = EBADF;
+            return EOF;
+        }
+        return fcntl(sockfd, F_SETFL, *(int*)argp ? O_NONBLOCK : 0);
+    }
     SOCKET_WRAPPER(lwip_ioctl, sockfd, cmd, argp);
 }
 
+#if ENABLE_LIKEPOSIX_ZEROCOPY
+/**
+ * receives on a socket without copying.
+ *
+ * the data stays in the lwIP buffers it arrived in, and is read in place, a segment at
+ * a time, with recv_zerocopy_next(). the buffers count against the lwIP pbuf pool until
+ * they are handed back with recv_zerocopy_release(), so release them promptly.
+ * a datagram socket receives one datagram, a stream socket whatever lwIP has queued.
+ * data is taken from the netconn, so bytes recv() received but didn't return are not
+ * seen, don't mix recv_zerocopy() and recv() on a stream socket. as for recv(), only
+ * one task at a time should receive on a socket.
+ *
+ * the socket is held open for the call. a close() from another task removes the
+ * descriptor, and the call then fails with EBADF, but the lwIP socket is only closed
+ * when the call returns, so shut the socket down first to make a waiting call return.
+ *
+ * **this is a non standard function**
+ *
+ * @param   zc is populated with the received data, even on error, when it holds nothing.
+ * @param   flags may be MSG_DONTWAIT.
+ * @retval  the number of bytes received, 0 at the end of a stream, or -1 on error.
+ */
+int recv_zerocopy(int sockfd, recv_zerocopy_t* zc, int flags)
+{
+    struct lwip_sock* sock;
+    struct netconn* conn;
+    struct netbuf* buf = NULL;
+    struct pbuf* p = NULL;
+    u8_t apiflags = 0;
+    err_t err;
+    uint32_t word;
+    int fd = __lookup_socket(sockfd, &word);
+    int res;
+
+    zc->buf = NULL;
+    zc->next = NULL;
+    zc->datagram = 0;
+
+    if(fd == EOF || __hold_socket(sockfd, word, fd) == EOF)
+    {
+        errno = EBADF;
+        return EOF;
+    }
+
+    // held, the netconn stays open until the release
+    sock = lwip_socket_dbg_get_socket(fd);
+    conn = sock ? sock->conn : NULL;
+    if(!conn)
+    {
+        __release_socket(fd);
+        errno = EBADF;
+        return EOF;
+    }
+
+    if((flags & MSG_DONTWAIT) || netconn_is_nonblocking(conn))
+        apiflags = NETCONN_DONTBLOCK;
+
+    if(NETCONNTYPE_GROUP(netconn_type(conn)) == NETCONN_TCP)
+    {
+        err = netconn_recv_tcp_pbuf_flags(conn, &p, apiflags);
+        if(err == ERR_OK)
+            zc->buf = p;
+    }
+    else
+    {
+        zc->datagram = 1;
+        err = netconn_recv_udp_raw_netbuf_flags(conn, &buf, apiflags);
+        if(err == ERR_OK)
+        {
+            zc->buf = buf;
+            p = buf->p;
+        }
+    }
+
+    __release_socket(fd);
+
+    if(err == ERR_OK)
+    {
+        zc->next = p;
+        res = p ? p->tot_len : 0;
+    }
+    else if(err == ERR_CLSD && !zc->datagram)
+        res = 0;
+    else
+    {
+        errno = err_to_errno(err);
+        res = EOF;
+    }
+
+    // closed during the call, the data goes back to lwIP
+    res = __check_socket(sockfd, word, res);
+    if(res == EOF)
+        recv_zerocopy_release(zc);
+    return res;
+}
+
+/**
+ * returns the next segment of the data received by recv_zerocopy().
+ *
+ * @param   length is set to the length of the segment.
+ * @retval  the segment, read only, or NULL when there are no more.
+ */
+const void* recv_zerocopy_next(recv_zerocopy_t* zc, size_t* length)
+{
+    struct pbuf* p = (struct pbuf*)zc->next;
+
+    if(!p)
+        return NULL;
+
+    // the last pbuf of a chain holds the rest of its tot_len
+    zc->next = p->len == p->tot_len ? NULL : p->next;
+    *length = p->len;
+    return p->payload;
+}
+
+/**
+ * hands the buffers received by recv_zerocopy() back to lwIP.
+ */
+void recv_zerocopy_release(recv_zerocopy_t* zc)
+{
+    if(zc->buf)
+    {
+        if(zc->datagram)
+            netbuf_delete((struct netbuf*)zc->buf);
+        else
+            pbuf_free((struct pbuf*)zc->buf);
+    }
+    zc->buf = NULL;
+    zc->next = NULL;
+}
+#endif
+
 /**
- * clashes with signature in standard header sys/_default_fcntl.h
+ * closes a socket, the same as close().
+ *
+ * other tasks may be in a socket call on the same descriptor, as the file table isn't
+ * locked across socket calls. such a call that returns after the close fails with EBADF.
+ * lwIP gives the number of a closed socket to the next socket it opens though, at once,
+ * so a call that had translated the descriptor before the close but not yet reached lwIP
+ * may run on a socket opened after it, by any task. don't close a socket that another
+ * task may still use, shut it down with shutdown() so the other task's calls return,
+ * and close it when they have.
+ *
+ * @param   socket is the descriptor to close.
+ * @retval  0 on success, -1 on error.
  */
-//int fcntl(int filedes, int cmd, int val)
-//{
-//    SOCKET_WRAPPER(lwip_fcntl, filedes, cmd, val);
-//}
 int closesocket(int socket)
 {
     return _close(socket);
@@ -58,6 +58,67 @@
  extern "C" {
 #endif
 
+/**
+ * enable open_encoded(), which opens a pre-compressed sibling of a file when the caller accepts it.
+ */
+#ifndef ENABLE_LIKEPOSIX_ENCODED_VARIANTS
+#define ENABLE_LIKEPOSIX_ENCODED_VARIANTS   0
+#endif
+/**
+ * the number of variant lookup results cached by open_encoded().
+ */
+#ifndef ENCODED_VARIANT_CACHE_LENGTH
+#define ENCODED_VARIANT_CACHE_LENGTH        16
+#endif
+/**
+ * the maximum length of a path passed to open_encoded(), including the variant suffix.
+ */
+#ifndef ENCODED_VARIANT_PATH_LENGTH
+#define ENCODED_VARIANT_PATH_LENGTH         96
+#endif
+
+/**
+ * enable the static configuration, in which the syscall layer makes no use of the heap.
+ * file table entries, directories, devices, device queues and locks are all allocated
+ * from statically sized pools.
+ */
+#ifndef ENABLE_LIKEPOSIX_STATIC
+#define ENABLE_LIKEPOSIX_STATIC             0
+#endif
+/**
+ * the number of directories that may be open at once, in the static configuration.
+ */
+#ifndef DIR_TABLE_LENGTH
+#define DIR_TABLE_LENGTH                    2
+#endif
+/**
+ * the number of FatFs files that may be open at once, in the static configuration.
+ * these entries hold a FIL, and are counted separately from the FILE_TABLE_LENGTH
+ * entries used by sockets, devices and the other backends.
+ */
+#ifndef FATFS_FILE_TABLE_LENGTH
+#define FATFS_FILE_TABLE_LENGTH             4
+#endif
+/**
+ * the length of each device queue in the static configuration, the queue length passed to
+ * open() is limited to this.
+ */
+#ifndef DEVICE_QUEUE_LENGTH
+#define DEVICE_QUEUE_LENGTH                 64
+#endif
+/**
+ * in the static configuration, if non zero, the build fails if the pools take more than this many bytes.
+ */
+#ifndef LIKEPOSIX_STATIC_MAX_BYTES
+#define LIKEPOSIX_STATIC_MAX_BYTES          0
+#endif
+
+/**
+ * content encodings, combined to form the accepted argument of open_encoded().
+ */
+#define CONTENT_ENCODING_IDENTITY           0x00    ///< the file as it is
+#define CONTENT_ENCODING_GZIP               0x01    ///< the gzip compressed sibling, <name>.gz
+
 #ifndef FILE_TABLE_OFFSET
 #error FILE_TABLE_OFFSET must be defined - normally defined in likeposix_config.h
 #endif
@@ -91,6 +152,10 @@
 
  /**
   * device interface definition, used for device driver interfacing.
+  *
+  * to wake tasks waiting on the device in select(), poll() or epoll_wait(), drivers call
+  * vfs_notify_device_from_isr(), declared in vfs.h, after putting data in pipe.read or taking
+  * data from pipe.write.
   */
  struct _dev_ioctl_t{
     unsigned int timeout;           ///< io timeout in milliseconds
@@ -102,6 +167,7 @@
  	void* ctx;						///< a pointer to data that has meaning in the context of the device driver itself.
     struct termios* termios;        ///< a termios structure to define device settings via termios interface.
  	queue_pair_t pipe;
+    struct _filtab_entry_t* fte;    ///< the descriptor the device is open on, set by the syscall layer
  };
 
 void init_likeposix();
@@ -113,6 +179,10 @@ dev_ioctl_t* install_device(char* name,
 							dev_ioctl_fn_t close_dev,
 							dev_ioctl_fn_t ioctl);
 
+#if ENABLE_LIKEPOSIX_ENCODED_VARIANTS
+int open_encoded(const char* name, int flags, int accepted, int* encoding);
+#endif
+
 #endif
 
 #ifdef __cplusplus
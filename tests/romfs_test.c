@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * host test of romfs.c, against an image of base_fs generated by tools/mkromfs.py.
+ *
+ * the source tree is walked on the host, and for every file and directory in it the test
+ * checks what romfs.c gives through the image: stat() type and size, romfs_map() data and
+ * alignment, open(), read() in several chunk sizes, lseek() from each origin and fstat(),
+ * and the sorted listing of each directory. paths that are not in the tree, a name cut
+ * short, a name run on, a path through a file, must not resolve.
+ *
+ * mkromfs.py --verify reads the image back with the tool's own parser, this checks it with
+ * the code that runs on the target. see tests/Makefile.
+ */
+
+#define _XOPEN_SOURCE   700     ///< nftw()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#define FREAD           1       ///< newlib open flags, as open() passes them to the backend
+#define FWRITE          2
+
+#include "romfs.c"
+
+#ifndef BASE_FS
+#define BASE_FS         "../base_fs"
+#endif
+
+#define MAX_NODES       256
+#define MAX_PATH        256
+#define PATH_LENGTH     (MAX_PATH + sizeof(BASE_FS) + sizeof(ROMFS_DIRECTORY) + 2)
+
+typedef struct {
+    char path[MAX_PATH];        ///< the path under BASE_FS, starting with '/'
+    int dir;
+    size_t size;
+} node_t;
+
+static node_t nodes[MAX_NODES];
+static int node_count;
+static char data[256 * 1024];
+static char buffer[256 * 1024];
+
+static int collect(const char* path, const struct stat* st, int type, struct FTW* ftw)
+{
+    const char* rel = path + strlen(BASE_FS);
+    (void)ftw;
+
+    // mkromfs.py skips hidden names
+    if(*rel == '\0' || strstr(rel, "/."))
+        return 0;
+
+    assert(node_count < MAX_NODES && strlen(rel) < MAX_PATH);
+    strcpy(nodes[node_count].path, rel);
+    nodes[node_count].dir = type == FTW_D;
+    nodes[node_count].size = st->st_size;
+    node_count++;
+    return 0;
+}
+
+static size_t load(const char* rel)
+{
+    char path[PATH_LENGTH];
+    FILE* f;
+    size_t length;
+
+    assert(strlen(rel) < MAX_PATH);
+    strcpy(path, BASE_FS);
+    strcat(path, rel);
+    f = fopen(path, "rb");
+    assert(f);
+    length = fread(data, 1, sizeof(data), f);
+    assert(feof(f));
+    fclose(f);
+    return length;
+}
+
+static void romfs_path(char* path, const char* rel)
+{
+    assert(strlen(rel) < MAX_PATH + 2);
+    strcpy(path, ROMFS_DIRECTORY);
+    strcat(path, *rel ? rel + 1 : rel);
+}
+
+static int resolves(const char* path)
+{
+    struct stat st;
+    return romfs_fs.stat(path, &st) == 0;
+}
+
+static int compare_nodes(const void* a, const void* b)
+{
+    return strcmp(((const node_t*)a)->path, ((const node_t*)b)->path);
+}
+
+static void check_file(const node_t* node)
+{
+    char path[PATH_LENGTH];
+    static const int chunks[] = {1, 7, 61, 512, 4096, (int)sizeof(buffer)};
+    union {
+        filtab_entry_t fte;
+        char space[256];
+    } entry;
+    filtab_entry_t* fte = &entry.fte;
+    struct stat st;
+    const char* mapped;
+    unsigned int mapped_size;
+    size_t length = load(node->path);
+    size_t pos;
+    int count;
+    int c;
+
+    assert(romfs_fs.entry_size <= sizeof(entry));
+    romfs_path(path, node->path);
+
+    assert(romfs_fs.stat(path, &st) == 0);
+    assert(st.st_mode == S_IFREG && (size_t)st.st_size == length);
+
+    mapped = romfs_map(path, &mapped_size);
+    assert(mapped && mapped_size == length);
+    assert(((uintptr_t)mapped & 3) == 0);
+    assert(memcmp(mapped, data, length) == 0);
+
+    memset(&entry, 0, sizeof(entry));
+    assert(romfs_fs.open(fte, path, FREAD | FWRITE, 0) == EOF);
+    assert(romfs_fs.open(fte, path, FREAD | O_CREAT, 0) == EOF);
+
+    for(c = 0; c < (int)(sizeof(chunks) / sizeof(chunks[0])); c++)
+    {
+        memset(&entry, 0, sizeof(entry));
+        assert(romfs_fs.open(fte, path, FREAD, 0) == 0);
+        assert(fte->ops->fstat(fte, &st) == 0 && (size_t)st.st_size == length);
+
+        pos = 0;
+        while((count = fte->ops->read(fte, buffer + pos, chunks[c])) > 0)
+        {
+            assert(count <= chunks[c]);
+            pos += count;
+            assert(pos <= length);
+        }
+        assert(count == 0 && pos == length);
+        assert(memcmp(buffer, data, length) == 0);
+        assert(fte->ops->read(fte, buffer, 1) == 0);
+
+        // seek from each origin, then read what is left
+        pos = length / (c + 2);
+        assert(fte->ops->lseek(fte, (int)pos, SEEK_SET) == (int)pos);
+        assert(fte->ops->lseek(fte, 0, SEEK_CUR) == (int)pos);
+        assert(fte->ops->read(fte, buffer, (int)sizeof(buffer)) == (int)(length - pos));
+        assert(memcmp(buffer, data + pos, length - pos) == 0);
+        assert(fte->ops->lseek(fte, -(int)(length - pos), SEEK_END) == (int)pos);
+        assert(fte->ops->lseek(fte, -1, SEEK_SET) == EOF);
+        assert(fte->ops->lseek(fte, (int)length + 10, SEEK_SET) == (int)length + 10);
+        assert(fte->ops->read(fte, buffer, 1) == 0);
+        assert(fte->ops->poll(fte) == VFS_POLLIN);
+        assert(fte->ops->close(fte) == 0);
+    }
+
+    // a path through a file
+    strcat(path, "/x");
+    assert(!resolves(path));
+}
+
+static void check_dir(const node_t* node)
+{
+    char path[PATH_LENGTH];
+    const node_t* expected[MAX_NODES];
+    dir_entry_t dir;
+    struct dirent ent;
+    struct stat st;
+    size_t length = strlen(node->path);
+    int count = 0;
+    int i;
+
+    romfs_path(path, node->path);
+    assert(romfs_fs.stat(path, &st) == 0 && st.st_mode == S_IFDIR);
+    assert(romfs_map(path, NULL) == NULL);
+    strcat(path, "/");
+    assert(romfs_fs.stat(path, &st) == 0 && st.st_mode == S_IFDIR);
+
+    // the children of the directory, nodes is sorted so they are in strcmp() order
+    for(i = 0; i < node_count; i++)
+    {
+        if(strncmp(nodes[i].path, node->path, length) == 0 && nodes[i].path[length] == '/' &&
+                !strchr(nodes[i].path + length + 1, '/'))
+            expected[count++] = &nodes[i];
+    }
+
+    memset(&dir, 0, sizeof(dir));
+    assert(romfs_fs.opendir(&dir, path) == 0);
+    for(i = 0; i < count; i++)
+    {
+        assert(romfs_fs.readdir(&dir, &ent) == 0);
+        assert(strcmp(ent.d_name, expected[i]->path + length + 1) == 0);
+        assert(ent.d_type == (expected[i]->dir ? DT_DIR : DT_REG));
+    }
+    assert(romfs_fs.readdir(&dir, &ent) == EOF);
+}
+
+static int in_tree(const char* rel)
+{
+    int i;
+
+    for(i = 0; i < node_count; i++)
+    {
+        if(strcmp(nodes[i].path, rel) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * names one character longer and one shorter than a name in the tree must not resolve,
+ * unless they are in the tree too.
+ */
+static void check_missing(const node_t* node)
+{
+    char rel[MAX_PATH + 2];
+    char path[PATH_LENGTH];
+    size_t length = strlen(node->path);
+
+    sprintf(rel, "%sx", node->path);
+    romfs_path(path, rel);
+    assert(in_tree(rel) || !resolves(path));
+
+    if(node->path[length - 2] != '/')
+    {
+        strcpy(rel, node->path);
+        rel[length - 1] = '\0';
+        romfs_path(path, rel);
+        assert(in_tree(rel) || !resolves(path));
+    }
+}
+
+int main(void)
+{
+    node_t root = {"", 1, 0};
+    struct stat st;
+    size_t bytes = 0;
+    int files = 0;
+    int dirs = 0;
+    int i;
+
+    assert(romfs_init() == 0);
+    assert(nftw(BASE_FS, collect, 16, FTW_PHYS) == 0);
+    assert(node_count > 0);
+    qsort(nodes, node_count, sizeof(node_t), compare_nodes);
+
+    check_dir(&root);
+    assert(romfs_fs.stat(ROMFS_DIRECTORY, &st) == 0 && st.st_mode == S_IFDIR);
+    assert(romfs_map(ROMFS_DIRECTORY, NULL) == NULL);
+    assert(!resolves(ROMFS_DIRECTORY "no such file"));
+    assert(!resolves(ROMFS_DIRECTORY "no/such/file"));
+
+    for(i = 0; i < node_count; i++)
+    {
+        if(nodes[i].dir)
+        {
+            check_dir(&nodes[i]);
+            dirs++;
+        }
+        else
+        {
+            check_file(&nodes[i]);
+            bytes += nodes[i].size;
+            files++;
+        }
+        check_missing(&nodes[i]);
+    }
+
+    printf("%d files, %d directories, %lu bytes checked against %s\n", files, dirs, (unsigned long)bytes, BASE_FS);
+    printf("ok\n");
+    return 0;
+}
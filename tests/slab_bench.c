@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * host benchmark of the size class allocator, slab.c, against the heap alone.
+ *
+ * the heap is a model of FreeRTOS heap_4, first fit from a free list kept in address
+ * order, with adjacent free blocks merged, and an 8 byte block header as on a 32 bit
+ * target. the same workload, many small short lived allocations mixed with buffers
+ * that live for longer, is run on the heap alone, then with small allocations served
+ * by slab_alloc() and the rest by the heap, as malloc() does with ENABLE_LIKEPOSIX_SLAB.
+ *
+ * for each run it prints
+ *  - failed, the allocations the heap could not serve,
+ *  - free, largest and frag, the free heap, its largest block, and 1 - largest / free,
+ *    sampled through the run, the worst sample and the state at the end,
+ *  - walk, the free blocks visited per heap allocation, mean and worst, what a heap_4
+ *    allocation costs on a target,
+ *  - ns, host nanoseconds per allocation, mean and worst, clock reads included.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "slab.c"
+
+#define HEAP_SIZE       (32 * 1024)
+#define HEAP_HEADER     8
+#define HEAP_MIN_SPLIT  (2 * HEAP_HEADER)
+#define HEAP_END        ((uint32_t)HEAP_SIZE)
+
+#define STEPS           200000
+#define SLOTS           256
+#define SAMPLE_PERIOD   1000
+
+/**
+ * a heap block header, the next free block by offset, and the size of the block, header included.
+ */
+typedef struct {
+    uint32_t next;
+    uint32_t size;
+} heap_block_t;
+
+static uint8_t heap[HEAP_SIZE] __attribute__((aligned(8)));
+static uint32_t heap_free;                  ///< the first free block, HEAP_END if there is none
+static unsigned long heap_walked;
+static unsigned long heap_walk_worst;
+static unsigned long heap_allocs;
+
+#define BLOCK(offset)   ((heap_block_t*)(heap + (offset)))
+
+static void heap_init(void)
+{
+    heap_free = 0;
+    BLOCK(0)->next = HEAP_END;
+    BLOCK(0)->size = HEAP_SIZE;
+    heap_walked = 0;
+    heap_walk_worst = 0;
+    heap_allocs = 0;
+}
+
+void* pvPortMalloc(size_t size)
+{
+    uint32_t want = (uint32_t)((size + 7) & ~(size_t)7) + HEAP_HEADER;
+    uint32_t* link = &heap_free;
+    uint32_t block;
+    unsigned long walk = 0;
+
+    while(*link != HEAP_END && BLOCK(*link)->size < want)
+    {
+        link = &BLOCK(*link)->next;
+        walk++;
+    }
+    walk++;
+
+    heap_allocs++;
+    heap_walked += walk;
+    if(walk > heap_walk_worst)
+        heap_walk_worst = walk;
+
+    block = *link;
+    if(block == HEAP_END)
+        return NULL;
+
+    if(BLOCK(block)->size - want >= HEAP_MIN_SPLIT)
+    {
+        BLOCK(block + want)->size = BLOCK(block)->size - want;
+        BLOCK(block + want)->next = BLOCK(block)->next;
+        BLOCK(block)->size = want;
+        *link = block + want;
+    }
+    else
+        *link = BLOCK(block)->next;
+
+    return heap + block + HEAP_HEADER;
+}
+
+void vPortFree(void* ptr)
+{
+    uint32_t block = (uint32_t)((uint8_t*)ptr - heap) - HEAP_HEADER;
+    uint32_t* link = &heap_free;
+    uint32_t prev = HEAP_END;
+
+    while(*link < block)
+    {
+        prev = *link;
+        link = &BLOCK(*link)->next;
+    }
+
+    BLOCK(block)->next = *link;
+    *link = block;
+
+    // merge with the next block, then the previous one
+    if(BLOCK(block)->next != HEAP_END && BLOCK(block)->next == block + BLOCK(block)->size)
+    {
+        BLOCK(block)->size += BLOCK(BLOCK(block)->next)->size;
+        BLOCK(block)->next = BLOCK(BLOCK(block)->next)->next;
+    }
+    if(prev != HEAP_END && prev + BLOCK(prev)->size == block)
+    {
+        BLOCK(prev)->size += BLOCK(block)->size;
+        BLOCK(prev)->next = BLOCK(block)->next;
+    }
+}
+
+static void heap_state(uint32_t* free, uint32_t* largest)
+{
+    uint32_t block;
+
+    *free = 0;
+    *largest = 0;
+    for(block = heap_free; block != HEAP_END; block = BLOCK(block)->next)
+    {
+        *free += BLOCK(block)->size;
+        if(BLOCK(block)->size > *largest)
+            *largest = BLOCK(block)->size;
+    }
+}
+
+/**
+ * xorshift, so that both runs, on any host, see the same workload.
+ */
+static uint32_t rng;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+typedef struct {
+    void* ptr;
+    unsigned long expires;
+} slot_t;
+
+static slot_t slots[SLOTS];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void* bench_malloc(size_t size, int use_slab)
+{
+    void* ptr = use_slab ? slab_alloc(size) : NULL;
+    return ptr ? ptr : pvPortMalloc(size);
+}
+
+static void bench_free(void* ptr)
+{
+    if(slab_owns(ptr))
+        slab_free(ptr);
+    else
+        vPortFree(ptr);
+}
+
+static void run(const char* name, int use_slab)
+{
+    unsigned long step;
+    unsigned long allocs = 0;
+    unsigned long failed = 0;
+    uint64_t start;
+    uint64_t elapsed;
+    uint64_t ns = 0;
+    uint64_t ns_worst = 0;
+    uint32_t free;
+    uint32_t largest;
+    double frag;
+    double frag_worst = 0;
+    uint32_t kind;
+    uint32_t size;
+    unsigned long life;
+    int i;
+
+    heap_init();
+    if(use_slab)
+        slab_init();
+    heap_allocs = 0;
+    heap_walked = 0;
+    heap_walk_worst = 0;
+    memset(slots, 0, sizeof(slots));
+    rng = 2463534242u;
+
+    for(step = 0; step < STEPS; step++)
+    {
+        // expiry is checked on a few slots per step, so lifetimes are approximate
+        for(i = 0; i < 4; i++)
+        {
+            slot_t* slot = &slots[(step * 4 + i) % SLOTS];
+            if(slot->ptr && slot->expires <= step)
+            {
+                bench_free(slot->ptr);
+                slot->ptr = NULL;
+            }
+        }
+
+        slot_t* slot = &slots[next_random() % SLOTS];
+        if(slot->ptr)
+            continue;
+
+        kind = next_random() % 100;
+        if(kind < 75)
+        {
+            // names, small structures, short lived
+            size = 1 + next_random() % 124;
+            size = 4 + next_random() % size;
+            life = 1 + next_random() % 200;
+        }
+        else if(kind < 97)
+        {
+            // messages, medium
+            size = 129 + next_random() % 384;
+            life = 20 + next_random() % 1000;
+        }
+        else
+        {
+            // connection buffers, large and long lived
+            size = 1024 + next_random() % 1024;
+            life = 500 + next_random() % 8000;
+        }
+
+        start = now_ns();
+        slot->ptr = bench_malloc(size, use_slab);
+        elapsed = now_ns() - start;
+        ns += elapsed;
+        if(elapsed > ns_worst)
+            ns_worst = elapsed;
+        allocs++;
+
+        if(!slot->ptr)
+            failed++;
+        slot->expires = step + life;
+
+        if(step % SAMPLE_PERIOD == 0)
+        {
+            heap_state(&free, &largest);
+            frag = free ? 1.0 - (double)largest / free : 0;
+            if(frag > frag_worst)
+                frag_worst = frag;
+        }
+    }
+
+    heap_state(&free, &largest);
+    frag = free ? 1.0 - (double)largest / free : 0;
+    printf("%-12s %7lu %6lu %6u %7u %5.1f%% %5.1f%% %5.2f/%-5lu %5lu/%-6lu\n",
+            name, allocs, failed, free, largest, 100 * frag, 100 * frag_worst,
+            heap_allocs ? (double)heap_walked / heap_allocs : 0.0, heap_walk_worst,
+            (unsigned long)(allocs ? ns / allocs : 0), (unsigned long)ns_worst);
+
+    for(i = 0; i < SLOTS; i++)
+    {
+        if(slots[i].ptr)
+            bench_free(slots[i].ptr);
+    }
+}
+
+int main(void)
+{
+    slab_usage_t usage;
+    int c;
+
+    printf("%d byte heap, %d steps, %d live slots\n", HEAP_SIZE, STEPS, SLOTS);
+    printf("%-12s %7s %6s %6s %7s %6s %6s %11s %12s\n",
+            "", "allocs", "failed", "free", "largest", "frag", "worst", "walk", "ns");
+    run("heap", 0);
+    run("slab + heap", 1);
+
+    for(c = 0; c < slab_classes(); c++)
+    {
+        slab_usage(c, &usage);
+        printf("class %4u: %3u objects, peak %3u, fell through %lu times\n",
+                usage.size, usage.count, usage.peak, (unsigned long)usage.fallback);
+        assert(usage.used == 0);
+    }
+    return 0;
+}
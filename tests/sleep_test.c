@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * host test of nanosleep() and clock_nanosleep(), on a simulated clock.
+ *
+ * the simulation has a 1ms tick and a 168MHz cycle counter, and each clock read costs 50ns.
+ * vTaskDelay() wakes on the tick boundary it is due at, as FreeRTOS does. 2000 sleeps, of
+ * up to a tick, up to 50us, and up to 20ms, start at random points in a tick. the test
+ * checks that no sleep ends early, how late they end, and that without the cycle clock the
+ * last part of a tick is slept through rather than spun out, then prints the mean and worst
+ * error.
+ *
+ * built with and without ENABLE_LIKEPOSIX_CYCLE_CLOCK, see tests/Makefile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+
+#define USE_FREERTOS                1
+#define USE_DRIVER_SYSTEM_TIMER     1
+#define CYCLE_CLOCK_ENABLE()        do {} while(0)
+#define CYCLE_CLOCK_COUNTER()       sim_cycles()
+#define TIMEZONE_OFFSET             0
+
+#include <stdint.h>
+#include "timers.h"
+static uint32_t sim_cycles(void);
+
+#include "time.c"
+
+#define SLEEPS          2000
+#define NS_PER_TICK     (NSEC_PER_SEC / configTICK_RATE_HZ)
+#define NS_PER_READ     50
+
+int errno;
+
+static uint64_t sim_ns;             ///< simulated time
+static unsigned int reads;          ///< clock reads
+static unsigned int delays;         ///< calls to vTaskDelay()
+static TimerCallbackFunction_t clock_update;
+
+static uint32_t sim_cycles(void)
+{
+    sim_ns += NS_PER_READ;
+    reads++;
+    return (uint32_t)(sim_ns * (configCPU_CLOCK_HZ / 1000000) / 1000);
+}
+
+void get_hw_time(unsigned long* secs, unsigned long* usecs)
+{
+    *secs = sim_ns / NSEC_PER_SEC;
+    *usecs = sim_ns / 1000 % 1000000;
+}
+
+void vTaskSetTimeOutState(TimeOut_t* timeout)
+{
+    sim_ns += NS_PER_READ;
+    reads++;
+    timeout->xOverflowCount = 0;
+    timeout->xTimeOnEntering = (TickType_t)(sim_ns / NS_PER_TICK);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    delays++;
+    sim_ns = (sim_ns / NS_PER_TICK + ticks) * NS_PER_TICK;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(sim_ns / NS_PER_TICK);
+}
+
+TimerHandle_t xTimerCreateStatic(const char* name, TickType_t period, UBaseType_t reload, void* id, TimerCallbackFunction_t callback, StaticTimer_t* buffer)
+{
+    (void)name; (void)period; (void)reload; (void)id; (void)buffer;
+    clock_update = callback;
+    return (TimerHandle_t)&clock_update;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait)
+{
+    (void)timer; (void)wait;
+    return pdPASS;
+}
+
+void delay(unsigned int ms)
+{
+    sim_ns += (uint64_t)ms * 1000000;
+}
+
+int main(void)
+{
+    struct timespec request;
+    struct timespec deadline;
+    uint64_t duration;
+    uint64_t start;
+    uint64_t late;
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    unsigned int first_read;
+    unsigned int first_delay;
+    int i;
+
+    clock_init();
+    srand(1);
+
+    for(i = 0; i < SLEEPS; i++)
+    {
+        switch(i % 3)
+        {
+            case 0: duration = rand() % NS_PER_TICK; break;
+            case 1: duration = rand() % 50000; break;
+            default: duration = (uint64_t)(rand() % 20000) * 1000; break;
+        }
+        sim_ns += rand() % NS_PER_TICK;
+        if(clock_update)
+            clock_update(NULL);
+
+        request.tv_sec = duration / NSEC_PER_SEC;
+        request.tv_nsec = duration % NSEC_PER_SEC;
+        start = sim_ns;
+        first_read = reads;
+        first_delay = delays;
+        assert(nanosleep(&request, NULL) == 0);
+
+        assert(sim_ns - start >= duration);
+        late = sim_ns - start - duration;
+        total += late;
+        if(late > worst)
+            worst = late;
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+        (void)first_read;
+        (void)first_delay;
+        assert(late < 1000);
+#else
+        // the tick clock only moves on the tick, the sleep must not spin on it. the clock is
+        // read for the deadline, then once after each delay
+        assert(reads - first_read == delays - first_delay + 2);
+        assert(late <= 2 * NS_PER_TICK);
+#endif
+    }
+
+    printf("%s: %d sleeps, mean error %llu ns, worst %llu ns\n",
+            ENABLE_LIKEPOSIX_CYCLE_CLOCK ? "cycle clock" : "tick clock", SLEEPS,
+            (unsigned long long)(total / SLEEPS), (unsigned long long)worst);
+
+    // invalid requests
+    request.tv_sec = 0;
+    request.tv_nsec = NSEC_PER_SEC;
+    assert(nanosleep(&request, NULL) == -1 && errno == EINVAL);
+    assert(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &request, NULL) == EINVAL);
+
+    // an absolute deadline, 300us ahead
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    __timespec_add(&deadline, 300000);
+    start = sim_ns;
+    assert(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == 0);
+    assert(sim_ns - start >= 299000);
+
+    start = sim_ns;
+    assert(usleep(250) == 0 && sim_ns - start >= 250000);
+
+    printf("ok\n");
+    return 0;
+}
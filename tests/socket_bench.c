@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * host benchmark of socket descriptor translation, with the file table lock held across
+ * the lwIP call, as SOCKET_WRAPPER did before the lock free lookup, and with the lock free
+ * lookup and generation check syscalls.c uses now.
+ *
+ * lwIP is stood in for by host sockets, a socketpair() per connection. each busy thread
+ * sends a 64 byte message on its connection and receives it back, through a descriptor
+ * in a model of the file table. the two translations are
+ *  - locked, take the table lock, check the entry is a socket, call lwIP, release the lock,
+ *  - lock free, read the entry's translation word, call lwIP, then check that the word
+ *    hasn't changed, __lookup_socket() and __check_socket() as in syscalls.c.
+ *
+ * each is run with 1, 2 and 4 busy threads, then with 4 busy threads and one more task
+ * waiting on an idle connection in recv() with a 10 ms receive timeout, a common way to
+ * poll a socket with lwIP. for each it prints the send and receive calls completed per
+ * second, summed over the busy threads, and the worst time one call took.
+ *
+ * the lock is a host mutex rather than a FreeRTOS semaphore, and the host scheduler is not
+ * FreeRTOS, so the figures compare the two lookups, they aren't target throughput.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define FILE_TABLE_LENGTH       16
+#define FILE_TABLE_OFFSET       3
+
+#define SOCKET_MAP_FD_MASK      0x0000ffffu
+#define SOCKET_MAP_GENERATION   0x00010000u
+
+#define MESSAGE_SIZE            64
+#define RUN_NS                  (300 * 1000000ull)
+#define IDLE_TIMEOUT_US         10000
+#define MAX_THREADS             5
+
+/**
+ * the parts of the file table the lookups use.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int socket[FILE_TABLE_LENGTH];          ///< the host socket of each slot, -1 if it's not a socket
+    volatile uint32_t sockets[FILE_TABLE_LENGTH];
+} filtab_t;
+
+static filtab_t filtab = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int insert_socket(int sock)
+{
+    int file;
+
+    pthread_mutex_lock(&filtab.lock);
+    for(file = 0; file < FILE_TABLE_LENGTH; file++)
+    {
+        if(filtab.socket[file] == -1)
+        {
+            filtab.socket[file] = sock;
+            filtab.sockets[file] = ((filtab.sockets[file] & ~SOCKET_MAP_FD_MASK) + SOCKET_MAP_GENERATION) | (uint32_t)(sock + 1);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&filtab.lock);
+    assert(file < FILE_TABLE_LENGTH);
+    return file + FILE_TABLE_OFFSET;
+}
+
+static void remove_socket(int file)
+{
+    pthread_mutex_lock(&filtab.lock);
+    close(filtab.socket[file - FILE_TABLE_OFFSET]);
+    filtab.socket[file - FILE_TABLE_OFFSET] = -1;
+    filtab.sockets[file - FILE_TABLE_OFFSET] &= ~SOCKET_MAP_FD_MASK;
+    pthread_mutex_unlock(&filtab.lock);
+}
+
+/**
+ * the translation SOCKET_WRAPPER made with the table locked.
+ */
+static ssize_t locked_call(int file, int receive, void* buffer, size_t size)
+{
+    ssize_t res = -1;
+    int sock;
+
+    pthread_mutex_lock(&filtab.lock);
+    file -= FILE_TABLE_OFFSET;
+    sock = file >= 0 && file < FILE_TABLE_LENGTH ? filtab.socket[file] : -1;
+    if(sock != -1)
+        res = receive ? recv(sock, buffer, size, 0) : send(sock, buffer, size, 0);
+    else
+        errno = EBADF;
+    pthread_mutex_unlock(&filtab.lock);
+    return res;
+}
+
+/**
+ * __lookup_socket() and __check_socket(), as in syscalls.c.
+ */
+static inline int lookup_socket(int file, uint32_t* word)
+{
+    file -= FILE_TABLE_OFFSET;
+    if(file < 0 || file >= FILE_TABLE_LENGTH)
+        return -1;
+    *word = filtab.sockets[file];
+    return (int)(*word & SOCKET_MAP_FD_MASK) - 1;
+}
+
+static inline ssize_t check_socket(int file, uint32_t word, ssize_t res)
+{
+    if(filtab.sockets[file - FILE_TABLE_OFFSET] != word)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    return res;
+}
+
+static ssize_t lockfree_call(int file, int receive, void* buffer, size_t size)
+{
+    uint32_t word;
+    int sock = lookup_socket(file, &word);
+
+    if(sock == -1)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    return check_socket(file, word, receive ? recv(sock, buffer, size, 0) : send(sock, buffer, size, 0));
+}
+
+typedef ssize_t (*call_t)(int file, int receive, void* buffer, size_t size);
+
+typedef struct {
+    pthread_t thread;
+    call_t call;
+    int send_file;                  ///< one end of this thread's connection, -1 for the idle task
+    int recv_file;                  ///< the other end
+    unsigned long calls;
+    uint64_t worst;
+} worker_t;
+
+static volatile int running;
+
+static void* worker(void* arg)
+{
+    worker_t* w = arg;
+    char message[MESSAGE_SIZE];
+    uint64_t start;
+    uint64_t elapsed;
+    ssize_t res;
+    int receive = 0;
+
+    memset(message, 'x', sizeof(message));
+    while(running)
+    {
+        if(w->send_file == -1)
+        {
+            res = w->call(w->recv_file, 1, message, sizeof(message));
+            assert(res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK));
+            continue;
+        }
+
+        start = now_ns();
+        res = w->call(receive ? w->recv_file : w->send_file, receive, message, sizeof(message));
+        elapsed = now_ns() - start;
+        assert(res == MESSAGE_SIZE);
+        if(elapsed > w->worst)
+            w->worst = elapsed;
+        w->calls++;
+        receive = !receive;
+    }
+    return NULL;
+}
+
+static void run(const char* name, call_t call, int busy, int idle)
+{
+    worker_t workers[MAX_THREADS];
+    int idle_peer[MAX_THREADS];
+    int pair[2];
+    struct timeval timeout = {0, IDLE_TIMEOUT_US};
+    unsigned long calls = 0;
+    uint64_t worst = 0;
+    uint64_t start;
+    int count = busy + idle;
+    int i;
+
+    assert(count <= MAX_THREADS);
+    memset(workers, 0, sizeof(workers));
+    for(i = 0; i < count; i++)
+    {
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+        workers[i].call = call;
+        if(i < busy)
+        {
+            workers[i].send_file = insert_socket(pair[0]);
+            workers[i].recv_file = insert_socket(pair[1]);
+            idle_peer[i] = -1;
+        }
+        else
+        {
+            // nothing is ever sent to the idle task, its peer end is kept open outside the table
+            assert(setsockopt(pair[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+            workers[i].send_file = -1;
+            workers[i].recv_file = insert_socket(pair[0]);
+            idle_peer[i] = pair[1];
+        }
+    }
+
+    running = 1;
+    for(i = 0; i < count; i++)
+        assert(pthread_create(&workers[i].thread, NULL, worker, &workers[i]) == 0);
+    start = now_ns();
+    while(now_ns() - start < RUN_NS)
+        usleep(1000);
+    running = 0;
+
+    for(i = 0; i < count; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        calls += workers[i].calls;
+        if(workers[i].worst > worst)
+            worst = workers[i].worst;
+        if(workers[i].send_file != -1)
+            remove_socket(workers[i].send_file);
+        remove_socket(workers[i].recv_file);
+        if(idle_peer[i] != -1)
+            close(idle_peer[i]);
+    }
+
+    printf("%-10s %4d %4d %12.0f %10lu\n", name, busy, idle,
+            calls / (RUN_NS / 1e9), (unsigned long)(worst / 1000));
+}
+
+/**
+ * a call racing with close() must fail with EBADF through the lock free lookup,
+ * even though the host socket number it used is still valid.
+ */
+static void check_generation(void)
+{
+    int pair[2];
+    int peer;
+    int file;
+    uint32_t word;
+    int sock;
+    char c = 'x';
+
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    file = insert_socket(pair[0]);
+    sock = lookup_socket(file, &word);
+    assert(sock == pair[0]);
+
+    // close and reopen the slot between the lookup and the check, as another task might
+    peer = pair[1];
+    remove_socket(file);
+    close(peer);
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    assert(insert_socket(pair[0]) == file);
+    errno = 0;
+    assert(check_socket(file, word, send(pair[0], &c, 1, 0)) == -1 && errno == EBADF);
+
+    remove_socket(file);
+    close(pair[1]);
+}
+
+int main(void)
+{
+    int busy;
+    int i;
+
+    for(i = 0; i < FILE_TABLE_LENGTH; i++)
+        filtab.socket[i] = -1;
+
+    check_generation();
+
+    printf("%d byte messages, %.1f s per run, idle receive timeout %d ms\n",
+            MESSAGE_SIZE, RUN_NS / 1e9, IDLE_TIMEOUT_US / 1000);
+    printf("%-10s %4s %4s %12s %10s\n", "", "busy", "idle", "calls/s", "worst us");
+    for(busy = 1; busy <= 4; busy *= 2)
+    {
+        run("locked", locked_call, busy, 0);
+        run("lock free", lockfree_call, busy, 0);
+    }
+    run("locked", locked_call, 4, 1);
+    run("lock free", lockfree_call, 4, 1);
+    return 0;
+}
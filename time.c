@@ -42,8 +42,32 @@
  * time_t time(time_t* time)
  * unsigned int sleep(unsigned int secs)
  * int usleep(useconds_t usecs)
+ * int clock_gettime(clockid_t clock_id, struct timespec* tp), declared in clock.h
+ * int clock_getres(clockid_t clock_id, struct timespec* res)
+ * int nanosleep(const struct timespec* request, struct timespec* remain)
+ * int clock_nanosleep(clockid_t clock_id, int flags, const struct timespec* request, struct timespec* remain)
+ * clock_t times(struct tms* buf)
+ * clock_t clock()
+ * int getrusage(int who, struct rusage* usage)
  *
+ * CLOCK_MONOTONIC counts from boot, and is not affected by setting the hardware timer.
+ * CLOCK_REALTIME is the hardware timer plus TIMEZONE_OFFSET, as gettimeofday() reports.
  *
+ * With ENABLE_LIKEPOSIX_CYCLE_CLOCK set, both are read from a free running cycle counter,
+ * without calling into the driver or taking a lock. A software timer extends the counter
+ * to 64 bits every CYCLE_CLOCK_UPDATE_PERIOD milliseconds, resamples the hardware timer for
+ * CLOCK_REALTIME, and measures the counter frequency against it. The clock state is
+ * published under a sequence count, a reader that is interrupted by an update just reads
+ * it again. gettimeofday() and time() then read CLOCK_REALTIME the same way.
+ *
+ * With ENABLE_LIKEPOSIX_CPUTIME set, times(), clock() and getrusage() report the CPU time
+ * of the calling task, from its FreeRTOS run time counter. Tasks share one address space
+ * but are scheduled like processes, so CPU time is accounted per task. Interrupts are
+ * accounted to the task they interrupt, and there is no split between user and system
+ * time, it is all reported as user time. With the cycle clock, cputime_counter() is a
+ * run time counter of CPUTIME_COUNTER_HZ for portGET_RUN_TIME_COUNTER_VALUE().
+ * The kernel keeps the per task totals in configRUN_TIME_COUNTER_TYPE, 32 bits unless it
+ * is set otherwise, so at 1 MHz the reported CPU time wraps to 0 every 71.6 minutes.
  *
  * Note: get_hw_time must be defined somewhere in the device drivers.
  *
@@ -57,7 +81,12 @@
 
 #include <sys/time.h>
 #include <unistd.h>
+#include <errno.h>
 #include "system.h"
+#include "clock.h"
+
+#undef errno
+extern int errno;
 
 #ifndef USE_FREERTOS
 #define USE_FREERTOS 0
@@ -73,6 +102,14 @@
 #include "task.h"
 #include "queue.h"
 #include "semphr.h"
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+#include "timers.h"
+#endif
+#if ENABLE_LIKEPOSIX_CPUTIME
+#include <string.h>
+#include <sys/times.h>
+#include <sys/resource.h>
+#endif
 #else
 #pragma message("building with polled sleep")
 #endif
@@ -90,6 +127,196 @@ extern void get_hw_time(unsigned long* secs, unsigned long* usecs);
 #define TIMEZONE_OFFSET 0
 #endif
 
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK && !USE_FREERTOS
+#error ENABLE_LIKEPOSIX_CYCLE_CLOCK requires FreeRTOS software timers
+#endif
+
+#if ENABLE_LIKEPOSIX_CPUTIME && !(USE_FREERTOS && configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY)
+#error ENABLE_LIKEPOSIX_CPUTIME requires configGENERATE_RUN_TIME_STATS and configUSE_TRACE_FACILITY to be set in FreeRTOSConfig.h
+#endif
+
+#define NSEC_PER_SEC    1000000000
+
+/**
+ * adds ns nanoseconds to tp.
+ */
+static void __timespec_add(struct timespec* tp, uint64_t ns)
+{
+    while(ns >= NSEC_PER_SEC)
+    {
+        tp->tv_sec++;
+        ns -= NSEC_PER_SEC;
+    }
+    tp->tv_nsec += (long)ns;
+    if(tp->tv_nsec >= NSEC_PER_SEC)
+    {
+        tp->tv_sec++;
+        tp->tv_nsec -= NSEC_PER_SEC;
+    }
+}
+
+/**
+ * @retval  a - b in nanoseconds.
+ */
+static int64_t __timespec_diff(const struct timespec* a, const struct timespec* b)
+{
+    return (int64_t)(a->tv_sec - b->tv_sec) * NSEC_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
+
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+
+/**
+ * cycle counter periods are converted to nanoseconds by multiplying by cycle_clock_t.mult,
+ * nanoseconds per cycle scaled up by 2^CYCLE_CLOCK_SHIFT.
+ */
+#define CYCLE_CLOCK_SHIFT   24
+
+/**
+ * the clock as it was at the last update, the counter value then, and its rate.
+ */
+typedef struct {
+    uint32_t sequence;          ///< incremented before and after each update, odd while one is in progress
+    uint32_t cycles;            ///< the counter at the last update
+    uint64_t mult;              ///< nanoseconds per cycle, scaled by 2^CYCLE_CLOCK_SHIFT, 0 until clock_init()
+    struct timespec monotonic;  ///< CLOCK_MONOTONIC at the last update
+    struct timespec realtime;   ///< CLOCK_REALTIME at the last update
+} cycle_clock_t;
+
+static volatile cycle_clock_t cycle_clock;
+
+/**
+ * the frequency measurement, only touched by the timer task.
+ */
+static struct {
+    uint64_t start;             ///< the hardware timer, in microseconds, at the start of the measurement
+    uint64_t cycles;            ///< cycles counted since then
+} calibration;
+
+/**
+ * reads a clock from the cycle counter.
+ */
+static void __cycle_clock_read(struct timespec* tp, int realtime)
+{
+    uint32_t sequence;
+    uint32_t delta;
+    uint64_t mult;
+
+    do {
+        sequence = cycle_clock.sequence;
+        *tp = realtime ? cycle_clock.realtime : cycle_clock.monotonic;
+        mult = cycle_clock.mult;
+        delta = CYCLE_CLOCK_COUNTER() - cycle_clock.cycles;
+    } while((sequence & 1) || sequence != cycle_clock.sequence);
+
+    __timespec_add(tp, ((uint64_t)delta * mult) >> CYCLE_CLOCK_SHIFT);
+}
+
+/**
+ * brings the clock up to date, called by the clock timer every CYCLE_CLOCK_UPDATE_PERIOD milliseconds.
+ * the counter is counted forward into CLOCK_MONOTONIC before it wraps, CLOCK_REALTIME is resampled from
+ * the hardware timer, and the counter frequency remeasured every CYCLE_CLOCK_CALIBRATION_PERIOD seconds.
+ */
+static void __cycle_clock_update(TimerHandle_t timer)
+{
+    static const uint64_t nominal = ((uint64_t)NSEC_PER_SEC << CYCLE_CLOCK_SHIFT) / CYCLE_CLOCK_HZ;
+    unsigned long secs = 0;
+    unsigned long usecs = 0;
+    struct timespec monotonic = cycle_clock.monotonic;
+    uint64_t mult = cycle_clock.mult;
+    uint64_t now;
+    uint64_t elapsed;
+    uint64_t measured;
+    uint32_t cycles;
+    uint32_t delta;
+
+    (void)timer;
+
+    get_hw_time(&secs, &usecs);
+    cycles = CYCLE_CLOCK_COUNTER();
+    delta = cycles - cycle_clock.cycles;
+    __timespec_add(&monotonic, ((uint64_t)delta * mult) >> CYCLE_CLOCK_SHIFT);
+
+    now = (uint64_t)secs * 1000000 + usecs;
+    calibration.cycles += delta;
+    elapsed = now - calibration.start;
+    if(now < calibration.start || elapsed >= 2 * CYCLE_CLOCK_CALIBRATION_PERIOD * 1000000ull)
+    {
+        // the hardware timer was set, start over
+        calibration.start = now;
+        calibration.cycles = 0;
+    }
+    else if(elapsed >= CYCLE_CLOCK_CALIBRATION_PERIOD * 1000000ull)
+    {
+        measured = ((elapsed * 1000) << CYCLE_CLOCK_SHIFT) / calibration.cycles;
+        // a measurement far from nominal means the hardware timer was adjusted
+        if(measured > nominal - nominal / 64 && measured < nominal + nominal / 64)
+            mult = measured;
+        calibration.start = now;
+        calibration.cycles = 0;
+    }
+
+    taskENTER_CRITICAL();
+    cycle_clock.sequence++;
+    cycle_clock.cycles = cycles;
+    cycle_clock.mult = mult;
+    cycle_clock.monotonic = monotonic;
+    cycle_clock.realtime.tv_sec = secs + TIMEZONE_OFFSET;
+    cycle_clock.realtime.tv_nsec = usecs * 1000;
+    cycle_clock.sequence++;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * starts the cycle counter clock, called by init_likeposix().
+ * CLOCK_MONOTONIC counts from here.
+ */
+void clock_init()
+{
+#if configSUPPORT_STATIC_ALLOCATION
+    static StaticTimer_t timer_buffer;
+#endif
+    TimerHandle_t timer;
+    unsigned long secs = 0;
+    unsigned long usecs = 0;
+
+    if(cycle_clock.mult)
+        return;
+
+#if configSUPPORT_STATIC_ALLOCATION
+    timer = xTimerCreateStatic("clock", CYCLE_CLOCK_UPDATE_PERIOD/portTICK_RATE_MS, pdTRUE, NULL, __cycle_clock_update, &timer_buffer);
+#else
+    timer = xTimerCreate("clock", CYCLE_CLOCK_UPDATE_PERIOD/portTICK_RATE_MS, pdTRUE, NULL, __cycle_clock_update);
+#endif
+    if(!timer)
+        return;
+
+    CYCLE_CLOCK_ENABLE();
+    get_hw_time(&secs, &usecs);
+
+    taskENTER_CRITICAL();
+    cycle_clock.sequence++;
+    cycle_clock.cycles = CYCLE_CLOCK_COUNTER();
+    cycle_clock.mult = ((uint64_t)NSEC_PER_SEC << CYCLE_CLOCK_SHIFT) / CYCLE_CLOCK_HZ;
+    cycle_clock.monotonic.tv_sec = 0;
+    cycle_clock.monotonic.tv_nsec = 0;
+    cycle_clock.realtime.tv_sec = secs + TIMEZONE_OFFSET;
+    cycle_clock.realtime.tv_nsec = usecs * 1000;
+    cycle_clock.sequence++;
+    taskEXIT_CRITICAL();
+
+    calibration.start = (uint64_t)secs * 1000000 + usecs;
+    calibration.cycles = 0;
+    xTimerStart(timer, 0);
+}
+
+#else
+
+void clock_init()
+{
+}
+
+#endif
+
 unsigned int sleep(unsigned int secs)
 {
 #if USE_FREERTOS
@@ -100,19 +327,31 @@ unsigned int sleep(unsigned int secs)
     return 0;
 }
 
+/**
+ * sleeps for usecs microseconds, see nanosleep().
+ */
 int usleep(useconds_t usecs)
 {
-#if USE_FREERTOS
-    vTaskDelay((usecs/1000)/portTICK_RATE_MS);
-#else
-    delay(usecs/1000);
-#endif
-    return 0;
+    struct timespec request = {
+        .tv_sec = usecs / 1000000,
+        .tv_nsec = (usecs % 1000000) * 1000
+    };
+    return nanosleep(&request, NULL);
 }
 
 int _gettimeofday(struct timeval *tp, struct timezone *tzp)
 {
     (void)tzp;
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+    if(cycle_clock.mult)
+    {
+        struct timespec ts;
+        __cycle_clock_read(&ts, 1);
+        tp->tv_sec = ts.tv_sec;
+        tp->tv_usec = ts.tv_nsec / 1000;
+        return 0;
+    }
+#endif
     get_hw_time((unsigned long*)&tp->tv_sec, (unsigned long*)&tp->tv_usec);
     tp->tv_sec += TIMEZONE_OFFSET;
     return 0;
@@ -121,11 +360,307 @@ int _gettimeofday(struct timeval *tp, struct timezone *tzp)
 time_t _time(time_t* time)
 {
     time_t usec;
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+    if(cycle_clock.mult)
+    {
+        struct timespec ts;
+        __cycle_clock_read(&ts, 1);
+        *time = ts.tv_sec;
+        return *time;
+    }
+#endif
     get_hw_time((unsigned long*)time, (unsigned long*)&usec);
     *time += TIMEZONE_OFFSET;
     return *time;
 }
 
+/**
+ * reads CLOCK_REALTIME or CLOCK_MONOTONIC.
+ *
+ * without ENABLE_LIKEPOSIX_CYCLE_CLOCK, CLOCK_REALTIME is read from the hardware timer, and
+ * CLOCK_MONOTONIC counts FreeRTOS ticks, or follows the hardware timer without FreeRTOS.
+ */
+int clock_gettime(clockid_t clock_id, struct timespec* tp)
+{
+    unsigned long secs = 0;
+    unsigned long usecs = 0;
+
+    if(clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+    if(cycle_clock.mult)
+    {
+        __cycle_clock_read(tp, clock_id == CLOCK_REALTIME);
+        return 0;
+    }
+#endif
+
+#if USE_FREERTOS
+    if(clock_id == CLOCK_MONOTONIC)
+    {
+        TimeOut_t now;
+        uint64_t ticks;
+
+        // the tick count, extended by the number of times it has overflowed
+        vTaskSetTimeOutState(&now);
+        ticks = ((uint64_t)now.xOverflowCount << (sizeof(TickType_t) * 8)) + now.xTimeOnEntering;
+        tp->tv_sec = ticks / configTICK_RATE_HZ;
+        tp->tv_nsec = (ticks % configTICK_RATE_HZ) * (NSEC_PER_SEC / configTICK_RATE_HZ);
+        return 0;
+    }
+#endif
+
+    get_hw_time(&secs, &usecs);
+    tp->tv_sec = secs;
+    tp->tv_nsec = usecs * 1000;
+    if(clock_id == CLOCK_REALTIME)
+        tp->tv_sec += TIMEZONE_OFFSET;
+    return 0;
+}
+
+/**
+ * reports the resolution of CLOCK_REALTIME or CLOCK_MONOTONIC.
+ */
+int clock_getres(clockid_t clock_id, struct timespec* res)
+{
+    if(clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(res)
+    {
+        res->tv_sec = 0;
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+        if(cycle_clock.mult)
+            res->tv_nsec = (cycle_clock.mult >> CYCLE_CLOCK_SHIFT) ? (long)(cycle_clock.mult >> CYCLE_CLOCK_SHIFT) : 1;
+        else
+#endif
+#if USE_FREERTOS
+        if(clock_id == CLOCK_MONOTONIC)
+            res->tv_nsec = NSEC_PER_SEC / configTICK_RATE_HZ;
+        else
+#endif
+            res->tv_nsec = 1000;
+    }
+    return 0;
+}
+
+/**
+ * sleeps until CLOCK_MONOTONIC reaches deadline.
+ *
+ * whole ticks are slept through with vTaskDelay(), which never oversleeps the ticks it is
+ * asked for. with the cycle clock the last part of a tick is spun out on the clock, and the
+ * sleep ends within a few cycles of the deadline. without it the clock only moves on the
+ * tick, so the last part of a tick is slept through too, and the sleep ends on the first
+ * tick after the deadline.
+ */
+static void __sleep_until(const struct timespec* deadline)
+{
+    struct timespec now;
+    int64_t remaining;
+
+    for(;;)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remaining = __timespec_diff(deadline, &now);
+        if(remaining <= 0)
+            break;
+#if USE_FREERTOS
+        remaining /= NSEC_PER_SEC / configTICK_RATE_HZ;
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+        if(!remaining && cycle_clock.mult)
+            continue;
+#endif
+        if(!remaining)
+            remaining = 1;
+        vTaskDelay(remaining < (int64_t)(portMAX_DELAY / 2) ? (TickType_t)remaining : portMAX_DELAY / 2);
+#else
+        if(remaining >= 1000000)
+        {
+            remaining /= 1000000;
+            delay(remaining < 1000000 ? (unsigned int)remaining : 1000000);
+        }
+#endif
+    }
+}
+
+/**
+ * sleeps for, or with TIMER_ABSTIME until, the time given in request on CLOCK_REALTIME or
+ * CLOCK_MONOTONIC. the sleep is precise to the clock's resolution, see __sleep_until().
+ * there are no signals to interrupt the sleep, remain is set to 0 if not NULL.
+ *
+ * @retval  0 on success, or EINVAL if the clock or request is not valid.
+ */
+int clock_nanosleep(clockid_t clock_id, int flags, const struct timespec* request, struct timespec* remain)
+{
+    struct timespec deadline;
+    struct timespec now;
+    int64_t delta;
+
+    if((clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC) ||
+       !request || request->tv_sec < 0 || request->tv_nsec < 0 || request->tv_nsec >= NSEC_PER_SEC)
+        return EINVAL;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if(flags & TIMER_ABSTIME)
+    {
+        // the deadline on CLOCK_MONOTONIC, so that setting the hardware timer doesn't move it
+        clock_gettime(clock_id, &now);
+        delta = __timespec_diff(request, &now);
+        if(delta > 0)
+        {
+            deadline.tv_sec += delta / NSEC_PER_SEC;
+            deadline.tv_nsec += delta % NSEC_PER_SEC;
+        }
+    }
+    else
+    {
+        // the clock reads up to its resolution behind, a relative sleep mustn't end early
+        clock_getres(CLOCK_MONOTONIC, &now);
+        deadline.tv_sec += request->tv_sec;
+        deadline.tv_nsec += request->tv_nsec + now.tv_nsec;
+    }
+    while(deadline.tv_nsec >= NSEC_PER_SEC)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NSEC_PER_SEC;
+    }
+
+    __sleep_until(&deadline);
+
+    if(remain)
+    {
+        remain->tv_sec = 0;
+        remain->tv_nsec = 0;
+    }
+    return 0;
+}
+
+/**
+ * sleeps for the time given in request, see clock_nanosleep().
+ */
+int nanosleep(const struct timespec* request, struct timespec* remain)
+{
+    int err = clock_nanosleep(CLOCK_MONOTONIC, 0, request, remain);
+
+    if(err)
+    {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+#if ENABLE_LIKEPOSIX_CPUTIME
+
+#if ENABLE_LIKEPOSIX_CYCLE_CLOCK
+/**
+ * a run time counter for the FreeRTOS run time stats, CLOCK_MONOTONIC in units of
+ * 1/CPUTIME_COUNTER_HZ seconds. it wraps at 2^32, as the stats expect, and is read
+ * without a lock, so that it may be called from the context switch:
+
+\code
+  #define configGENERATE_RUN_TIME_STATS               1
+  #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+  #define portGET_RUN_TIME_COUNTER_VALUE()            cputime_counter()
+  extern uint32_t cputime_counter(void);
+\endcode
+ */
+uint32_t cputime_counter()
+{
+    struct timespec tp;
+
+    __cycle_clock_read(&tp, 0);
+    return (uint32_t)(((uint64_t)tp.tv_sec * NSEC_PER_SEC + tp.tv_nsec) / (NSEC_PER_SEC / CPUTIME_COUNTER_HZ));
+}
+#endif
+
+/**
+ * @retval  the run time counter of the calling task. only as wide as the kernel keeps it,
+ *          with a 32 bit configRUN_TIME_COUNTER_TYPE it wraps after 2^32 counts, 71.6
+ *          minutes of CPU time at 1 MHz. a task that needs longer totals must make the
+ *          type 64 bits, or add up the differences between calls itself.
+ */
+static uint64_t __task_cputime()
+{
+    TaskStatus_t status;
+
+    // the running task's counter is only brought up to date when it is switched out
+    if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+        taskYIELD();
+
+    vTaskGetInfo(NULL, &status, pdFALSE, eRunning);
+    return status.ulRunTimeCounter;
+}
+
+static clock_t __cputime_to_clock(uint64_t counts)
+{
+    return (clock_t)(counts / CPUTIME_COUNTER_HZ * CLOCKS_PER_SEC +
+                     counts % CPUTIME_COUNTER_HZ * CLOCKS_PER_SEC / CPUTIME_COUNTER_HZ);
+}
+
+/**
+ * @param   buf, if not NULL, receives the CPU time of the calling task in tms_utime,
+ *          in units of CLOCKS_PER_SEC. the other times are 0.
+ * @retval  the time since boot in units of CLOCKS_PER_SEC.
+ */
+clock_t times(struct tms* buf)
+{
+    struct timespec now;
+
+    if(buf)
+    {
+        buf->tms_utime = __cputime_to_clock(__task_cputime());
+        buf->tms_stime = 0;
+        buf->tms_cutime = 0;
+        buf->tms_cstime = 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (clock_t)((uint64_t)now.tv_sec * CLOCKS_PER_SEC + now.tv_nsec / (NSEC_PER_SEC / CLOCKS_PER_SEC));
+}
+
+/**
+ * @retval  the CPU time of the calling task in units of CLOCKS_PER_SEC.
+ */
+clock_t clock()
+{
+    return __cputime_to_clock(__task_cputime());
+}
+
+/**
+ * @param   who is RUSAGE_SELF, for the calling task, or RUSAGE_CHILDREN, which has no usage.
+ * @param   usage receives the CPU time of the calling task in ru_utime, to the resolution of
+ *          the run time counter. the other fields are 0.
+ * @retval  0 on success, or -1 on error with errno set.
+ */
+int getrusage(int who, struct rusage* usage)
+{
+    uint64_t counts = 0;
+
+    if((who != RUSAGE_SELF && who != RUSAGE_CHILDREN) || !usage)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(who == RUSAGE_SELF)
+        counts = __task_cputime();
+
+    memset(usage, 0, sizeof(struct rusage));
+    usage->ru_utime.tv_sec = (time_t)(counts / CPUTIME_COUNTER_HZ);
+    usage->ru_utime.tv_usec = (suseconds_t)(counts % CPUTIME_COUNTER_HZ * 1000000 / CPUTIME_COUNTER_HZ);
+    return 0;
+}
+
+#endif
+
 /**
  * @}
  */
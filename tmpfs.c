@@ -0,0 +1,547 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * @addtogroup syscalls
+ *
+ * RAM backed filesystem.
+ *
+ * A flat directory of up to TMPFS_MAX_FILES files, mounted at TMPFS_DIRECTORY.
+ * File data is held in heap blocks of TMPFS_BLOCK_SIZE bytes, and the total
+ * allocated may not exceed TMPFS_MAX_BYTES. A file that is unlinked while open
+ * keeps its data until the last descriptor on it is closed.
+ *
+ * @file tmpfs.c
+ * @{
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include "syscalls.h"
+#include "semphr.h"
+#include "tmpfs.h"
+#include "cutensils.h"
+
+#if ENABLE_LIKEPOSIX_TMPFS
+
+/**
+ * RAM backed file definition.
+ */
+typedef struct {
+    char name[TMPFS_NAME_LENGTH];   ///< the file name, empty if the file has been unlinked
+    char used;                      ///< set while the node holds a file, named or unlinked
+    int refs;                       ///< the number of open descriptors on the file
+    unsigned int size;              ///< the file size in bytes
+    unsigned int nblocks;           ///< the number of data blocks allocated
+    unsigned int capacity;          ///< the length of the blocks array
+    unsigned char** blocks;         ///< the data blocks
+} tmpfs_node_t;
+
+/**
+ * an open file on the RAM backed filesystem, the file table entry type of the backend.
+ */
+typedef struct {
+    filtab_entry_t entry;   ///< the common entry, must be the first member
+    tmpfs_node_t* node;     ///< the file
+    unsigned int pos;       ///< the file position
+} tmpfs_file_t;
+
+#define TMPFS_DIRECTORY_LENGTH      (sizeof(TMPFS_DIRECTORY) - 1)
+
+#define lock_tmpfs()                (xSemaphoreTake(tmpfs_lock, 2000/portTICK_RATE_MS) == pdTRUE)
+#define unlock_tmpfs()              xSemaphoreGive(tmpfs_lock)
+
+static tmpfs_node_t nodes[TMPFS_MAX_FILES];
+static tmpfs_usage_t usage;
+static SemaphoreHandle_t tmpfs_lock;
+static const vfs_ops_t tmpfs_ops;
+
+/**
+ * initialises the RAM backed filesystem, called by init_likeposix().
+ */
+void tmpfs_init()
+{
+    if(tmpfs_lock == NULL)
+    {
+        tmpfs_lock = xSemaphoreCreateMutex();
+        assert_true(tmpfs_lock);
+        usage.budget = TMPFS_MAX_BYTES;
+    }
+}
+
+/**
+ * @retval the file name part of a path on the RAM backed filesystem,
+ *          or NULL if the path doesnt name a valid file.
+ */
+static const char* __tmpfs_name(const char* path)
+{
+    const char* name;
+
+    if(path[TMPFS_DIRECTORY_LENGTH - 1] == '\0')
+        return NULL;
+
+    name = path + TMPFS_DIRECTORY_LENGTH;
+    if(!name[0] || strchr(name, '/') || strlen(name) >= TMPFS_NAME_LENGTH)
+        return NULL;
+
+    return name;
+}
+
+/**
+ * @retval 1 if path names the mount directory itself, "/tmp" or "/tmp/".
+ */
+static int __tmpfs_is_root(const char* path)
+{
+    return path[TMPFS_DIRECTORY_LENGTH - 1] == '\0' || path[TMPFS_DIRECTORY_LENGTH] == '\0';
+}
+
+static tmpfs_node_t* __tmpfs_find(const char* name)
+{
+    int i;
+    for(i = 0; i < TMPFS_MAX_FILES; i++)
+    {
+        if(nodes[i].used && !strcmp(nodes[i].name, name))
+            return &nodes[i];
+    }
+    return NULL;
+}
+
+/**
+ * allocates zeroed data blocks until the file has at least nblocks.
+ *
+ * @retval 0 on success, -1 if the budget was exceeded or the heap is exhausted.
+ */
+static int __tmpfs_grow(tmpfs_node_t* node, unsigned int nblocks)
+{
+    unsigned char** blocks;
+    unsigned char* block;
+
+    while(node->nblocks < nblocks)
+    {
+        if(usage.used + TMPFS_BLOCK_SIZE > usage.budget)
+            return EOF;
+
+        if(node->nblocks == node->capacity)
+        {
+            blocks = pvPortMalloc((node->capacity ? node->capacity * 2 : 4) * sizeof(unsigned char*));
+            if(!blocks)
+                return EOF;
+            if(node->blocks)
+            {
+                memcpy(blocks, node->blocks, node->nblocks * sizeof(unsigned char*));
+                vPortFree(node->blocks);
+            }
+            node->blocks = blocks;
+            node->capacity = node->capacity ? node->capacity * 2 : 4;
+        }
+
+        block = pvPortMalloc(TMPFS_BLOCK_SIZE);
+        if(!block)
+            return EOF;
+        memset(block, 0, TMPFS_BLOCK_SIZE);
+        node->blocks[node->nblocks++] = block;
+
+        usage.used += TMPFS_BLOCK_SIZE;
+        if(usage.used > usage.peak)
+            usage.peak = usage.used;
+    }
+    return 0;
+}
+
+/**
+ * frees all data held by the file.
+ */
+static void __tmpfs_truncate(tmpfs_node_t* node)
+{
+    while(node->nblocks > 0)
+    {
+        vPortFree(node->blocks[--node->nblocks]);
+        usage.used -= TMPFS_BLOCK_SIZE;
+    }
+    if(node->blocks)
+        vPortFree(node->blocks);
+    node->blocks = NULL;
+    node->capacity = 0;
+    node->size = 0;
+}
+
+static void __tmpfs_delete(tmpfs_node_t* node)
+{
+    __tmpfs_truncate(node);
+    node->name[0] = '\0';
+    node->used = 0;
+    usage.files--;
+}
+
+/**
+ * opens a file on the RAM backed filesystem.
+ *
+ * O_CREAT, O_EXCL, O_TRUNC and O_APPEND are supported.
+ */
+static int tmpfs_open(filtab_entry_t* fte, const char* path, int flags, int length)
+{
+    const char* name = __tmpfs_name(path);
+    tmpfs_file_t* file = (tmpfs_file_t*)fte;
+    tmpfs_node_t* node;
+    int i;
+    int res = EOF;
+    (void)length;
+
+    if(!name)
+        return EOF;
+
+    if(lock_tmpfs())
+    {
+        node = __tmpfs_find(name);
+
+        if(node && (flags & O_CREAT) && (flags & O_EXCL))
+            node = NULL;
+        else if(!node && (flags & O_CREAT))
+        {
+            for(i = 0; i < TMPFS_MAX_FILES; i++)
+            {
+                if(!nodes[i].used)
+                {
+                    node = &nodes[i];
+                    memset(node, 0, sizeof(tmpfs_node_t));
+                    strcpy(node->name, name);
+                    node->used = 1;
+                    usage.files++;
+                    break;
+                }
+            }
+        }
+
+        if(node)
+        {
+            if((flags & O_TRUNC) && (flags & FWRITE))
+                __tmpfs_truncate(node);
+            node->refs++;
+            file->node = node;
+            file->pos = 0;
+            fte->mode = S_IFREG;
+            fte->ops = &tmpfs_ops;
+            res = 0;
+        }
+        unlock_tmpfs();
+    }
+
+    return res;
+}
+
+/**
+ * closes a file, if it was unlinked and this was the last open descriptor the file is deleted.
+ */
+static int tmpfs_close(filtab_entry_t* fte)
+{
+    tmpfs_file_t* file = (tmpfs_file_t*)fte;
+    int res = EOF;
+
+    if(lock_tmpfs())
+    {
+        if(--file->node->refs == 0 && file->node->name[0] == '\0')
+            __tmpfs_delete(file->node);
+        res = 0;
+        unlock_tmpfs();
+    }
+
+    return res;
+}
+
+static int tmpfs_read(filtab_entry_t* fte, char* buffer, int count)
+{
+    tmpfs_file_t* file = (tmpfs_file_t*)fte;
+    tmpfs_node_t* node = file->node;
+    unsigned int offset;
+    unsigned int chunk;
+    int n = EOF;
+
+    if(lock_tmpfs())
+    {
+        n = 0;
+        while(n < count && file->pos < node->size)
+        {
+            offset = file->pos % TMPFS_BLOCK_SIZE;
+            chunk = TMPFS_BLOCK_SIZE - offset;
+            if(chunk > node->size - file->pos)
+                chunk = node->size - file->pos;
+            if(chunk > (unsigned int)(count - n))
+                chunk = count - n;
+
+            memcpy(buffer + n, node->blocks[file->pos / TMPFS_BLOCK_SIZE] + offset, chunk);
+            file->pos += chunk;
+            n += chunk;
+        }
+        unlock_tmpfs();
+    }
+
+    return n;
+}
+
+/**
+ * writes to the file, growing it as required. a write that would take the filesystem
+ * over its budget is cut short.
+ */
+static int tmpfs_write(filtab_entry_t* fte, const char* buffer, int count)
+{
+    tmpfs_file_t* file = (tmpfs_file_t*)fte;
+    tmpfs_node_t* node = file->node;
+    unsigned int offset;
+    unsigned int chunk;
+    int n = EOF;
+
+    if(lock_tmpfs())
+    {
+        n = 0;
+        if(fte->flags & O_APPEND)
+            file->pos = node->size;
+
+        while(n < count)
+        {
+            if(__tmpfs_grow(node, file->pos / TMPFS_BLOCK_SIZE + 1) != 0)
+            {
+                usage.failed++;
+                break;
+            }
+
+            offset = file->pos % TMPFS_BLOCK_SIZE;
+            chunk = TMPFS_BLOCK_SIZE - offset;
+            if(chunk > (unsigned int)(count - n))
+                chunk = count - n;
+
+            memcpy(node->blocks[file->pos / TMPFS_BLOCK_SIZE] + offset, buffer + n, chunk);
+            file->pos += chunk;
+            n += chunk;
+            if(file->pos > node->size)
+                node->size = file->pos;
+        }
+        unlock_tmpfs();
+
+        if(n == 0 && count > 0)
+            n = EOF;
+    }
+
+    return n;
+}
+
+static int tmpfs_lseek(filtab_entry_t* fte, int offset, int whence)
+{
+    tmpfs_file_t* file = (tmpfs_file_t*)fte;
+
+    if(whence == SEEK_CUR)
+        offset += file->pos;
+    else if(whence == SEEK_END)
+        offset += file->node->size;
+
+    if(offset < 0)
+        return EOF;
+
+    file->pos = offset;
+    return offset;
+}
+
+static int tmpfs_fstat(filtab_entry_t* fte, struct stat* st)
+{
+    st->st_size = ((tmpfs_file_t*)fte)->node->size;
+    return 0;
+}
+
+static int tmpfs_fsync(filtab_entry_t* fte)
+{
+    (void)fte;
+    return 0;
+}
+
+static int tmpfs_poll(filtab_entry_t* fte)
+{
+    (void)fte;
+    return VFS_POLLIN|VFS_POLLOUT;
+}
+
+static const vfs_ops_t tmpfs_ops = {
+    .read = tmpfs_read,
+    .write = tmpfs_write,
+    .lseek = tmpfs_lseek,
+    .fstat = tmpfs_fstat,
+    .fsync = tmpfs_fsync,
+    .close = tmpfs_close,
+    .poll = tmpfs_poll,
+};
+
+/**
+ * populates st_size and st_mode for a file or the mount directory itself.
+ */
+static int tmpfs_stat(const char* path, struct stat* st)
+{
+    const char* name = __tmpfs_name(path);
+    tmpfs_node_t* node;
+    int res = EOF;
+
+    if(!name)
+    {
+        if(__tmpfs_is_root(path))
+        {
+            st->st_size = 0;
+            st->st_mode = S_IFDIR;
+            res = 0;
+        }
+    }
+    else if(lock_tmpfs())
+    {
+        node = __tmpfs_find(name);
+        if(node)
+        {
+            st->st_size = node->size;
+            st->st_mode = S_IFREG;
+            res = 0;
+        }
+        unlock_tmpfs();
+    }
+
+    return res;
+}
+
+static int tmpfs_unlink(const char* path)
+{
+    const char* name = __tmpfs_name(path);
+    tmpfs_node_t* node;
+    int res = EOF;
+
+    if(name && lock_tmpfs())
+    {
+        node = __tmpfs_find(name);
+        if(node)
+        {
+            if(node->refs > 0)
+                node->name[0] = '\0';
+            else
+                __tmpfs_delete(node);
+            res = 0;
+        }
+        unlock_tmpfs();
+    }
+
+    return res;
+}
+
+/**
+ * renames a file, replacing newpath if it exists.
+ */
+static int tmpfs_rename(const char* oldpath, const char* newpath)
+{
+    const char* oldname = __tmpfs_name(oldpath);
+    const char* newname = __tmpfs_name(newpath);
+    tmpfs_node_t* node;
+    tmpfs_node_t* existing;
+    int res = EOF;
+
+    if(oldname && newname && lock_tmpfs())
+    {
+        node = __tmpfs_find(oldname);
+        if(node)
+        {
+            existing = __tmpfs_find(newname);
+            if(existing && existing != node)
+            {
+                if(existing->refs > 0)
+                    existing->name[0] = '\0';
+                else
+                    __tmpfs_delete(existing);
+            }
+            strcpy(node->name, newname);
+            res = 0;
+        }
+        unlock_tmpfs();
+    }
+
+    return res;
+}
+
+static int tmpfs_opendir(dir_entry_t* dir, const char* path)
+{
+    dir->index = 0;
+    return __tmpfs_is_root(path) ? 0 : EOF;
+}
+
+static int tmpfs_readdir(dir_entry_t* dir, struct dirent* ent)
+{
+    int res = EOF;
+
+    if(lock_tmpfs())
+    {
+        for(; dir->index < TMPFS_MAX_FILES; dir->index++)
+        {
+            if(nodes[dir->index].used && nodes[dir->index].name[0])
+            {
+                strcpy(ent->d_name, nodes[dir->index].name);
+                dir->index++;
+                res = 0;
+                break;
+            }
+        }
+        unlock_tmpfs();
+    }
+
+    return res;
+}
+
+const vfs_fs_t tmpfs_fs = {
+    .prefix = TMPFS_DIRECTORY,
+    .entry_size = sizeof(tmpfs_file_t),
+    .open = tmpfs_open,
+    .stat = tmpfs_stat,
+    .unlink = tmpfs_unlink,
+    .rename = tmpfs_rename,
+    .mkdir = NULL,
+    .opendir = tmpfs_opendir,
+    .readdir = tmpfs_readdir,
+    .closedir = NULL,
+};
+
+/**
+ * copies the RAM backed filesystem usage counters.
+ */
+void tmpfs_usage(tmpfs_usage_t* u)
+{
+    if(lock_tmpfs())
+    {
+        *u = usage;
+        unlock_tmpfs();
+    }
+}
+
+#endif
+
+/**
+ * @}
+ */
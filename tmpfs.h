@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * @addtogroup syscalls
+ *
+ * @file tmpfs.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_TMPFS_H_
+#define LIKE_POSIX_TMPFS_H_
+
+#include "likeposix_config.h"
+#include "vfs.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * enable the RAM backed filesystem, mounted at TMPFS_DIRECTORY.
+ */
+#ifndef ENABLE_LIKEPOSIX_TMPFS
+#define ENABLE_LIKEPOSIX_TMPFS          0
+#endif
+/**
+ * location where the RAM backed filesystem is mounted.
+ */
+#ifndef TMPFS_DIRECTORY
+#define TMPFS_DIRECTORY                 "/tmp/"
+#endif
+/**
+ * the maximum number of files in the RAM backed filesystem.
+ */
+#ifndef TMPFS_MAX_FILES
+#define TMPFS_MAX_FILES                 8
+#endif
+/**
+ * the maximum number of bytes of file data held by the RAM backed filesystem.
+ */
+#ifndef TMPFS_MAX_BYTES
+#define TMPFS_MAX_BYTES                 (16 * 1024)
+#endif
+/**
+ * file data is allocated from the heap in blocks of this many bytes.
+ */
+#ifndef TMPFS_BLOCK_SIZE
+#define TMPFS_BLOCK_SIZE                256
+#endif
+/**
+ * the maximum length of a file name, including the terminating null.
+ */
+#ifndef TMPFS_NAME_LENGTH
+#define TMPFS_NAME_LENGTH               32
+#endif
+
+#if ENABLE_LIKEPOSIX_TMPFS
+
+/**
+ * RAM backed filesystem usage counters.
+ */
+typedef struct {
+    unsigned int files;     ///< the number of files
+    unsigned int used;      ///< bytes of file data allocated
+    unsigned int peak;      ///< the highest value used has reached
+    unsigned int budget;    ///< bytes of file data that may be allocated, TMPFS_MAX_BYTES
+    unsigned int failed;    ///< the number of writes cut short by the budget or a failed allocation
+} tmpfs_usage_t;
+
+extern const vfs_fs_t tmpfs_fs;
+
+void tmpfs_init();
+void tmpfs_usage(tmpfs_usage_t* usage);
+
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_TMPFS_H_ */
+
+/**
+ * @}
+ */
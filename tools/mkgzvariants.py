@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2015 Michael Stuart.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+# 3. The name of the author may not be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+# SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+# OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+# IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+# OF SUCH DAMAGE.
+#
+# This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+#
+# Author: Michael Stuart <spaceorbot@gmail.com>
+#
+
+
+"""
+Generates pre-compressed <name>.gz siblings for the files in a directory tree,
+base_fs for example, for use with open_encoded().
+
+A variant is only kept if it saves at least --min-saving percent, files that are
+already compressed (jpg, png...) usually don't, and their stale variants are removed.
+Variants are written with a fixed timestamp, so rebuilding an unchanged tree gives
+identical output.
+
+usage: mkgzvariants.py [--min-size N] [--min-saving P] [--clean] base_fs
+"""
+
+import argparse
+import gzip
+import os
+
+
+def main():
+    parser = argparse.ArgumentParser(description="generate gzip variants of the files in a directory tree")
+    parser.add_argument("root", help="directory to process, base_fs for example")
+    parser.add_argument("--min-size", type=int, default=256, help="files smaller than this many bytes are skipped")
+    parser.add_argument("--min-saving", type=int, default=10, help="keep a variant only if it is at least this many percent smaller")
+    parser.add_argument("--clean", action="store_true", help="only remove existing variants")
+    args = parser.parse_args()
+
+    total = 0
+    compressed = 0
+
+    for path, dirs, files in os.walk(args.root):
+        dirs[:] = [d for d in dirs if not d.startswith(".")]
+        for name in sorted(files):
+            full = os.path.join(path, name)
+            if name.startswith(".") or name.endswith(".gz"):
+                continue
+
+            variant = full + ".gz"
+            if os.path.exists(variant):
+                os.remove(variant)
+            if args.clean:
+                continue
+
+            with open(full, "rb") as f:
+                data = f.read()
+            if len(data) < args.min_size:
+                continue
+
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(packed) * 100 > len(data) * (100 - args.min_saving):
+                print("%-48s %8d  kept as is" % (full, len(data)))
+                continue
+
+            with open(variant, "wb") as f:
+                f.write(packed)
+            total += len(data)
+            compressed += len(packed)
+            print("%-48s %8d -> %8d" % (full, len(data), len(packed)))
+
+    if total:
+        print("variants: %d -> %d bytes" % (total, compressed))
+
+
+if __name__ == "__main__":
+    main()
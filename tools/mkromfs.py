@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2015 Michael Stuart.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+# 3. The name of the author may not be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+# SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+# OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+# IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+# OF SUCH DAMAGE.
+#
+# This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+#
+# Author: Michael Stuart <spaceorbot@gmail.com>
+#
+
+"""
+Packs a directory tree, base_fs for example, into a read only filesystem image
+for romfs.c, and writes it out as a C source file that defines romfs_image.
+
+The image layout is described in romfs.h:
+
+    header | directory tables | names | file data
+
+every directory table is a uint32 entry count followed by 16 byte entries,
+sorted by name in strcmp() order. file data is aligned to --align bytes.
+
+usage: mkromfs.py [--align N] [--binary image.bin] [--verify] base_fs romfs_image.c
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+ROMFS_MAGIC = 0x464d4f52
+ROMFS_VERSION = 1
+ROMFS_TYPE_FILE = 1
+ROMFS_TYPE_DIR = 2
+
+HEADER = struct.Struct("<IIII")
+ENTRY = struct.Struct("<IIII")
+COUNT = struct.Struct("<I")
+
+
+def align(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+
+def scan(path):
+    """
+    returns the tree under path as a dict of name -> dict (directory) or bytes (file).
+    hidden files are skipped.
+    """
+    tree = {}
+    for name in os.listdir(path):
+        if name.startswith("."):
+            continue
+        full = os.path.join(path, name)
+        if os.path.isdir(full):
+            tree[name.encode()] = scan(full)
+        elif os.path.isfile(full):
+            with open(full, "rb") as f:
+                tree[name.encode()] = f.read()
+    return tree
+
+
+def build(tree, alignment):
+    # breadth first list of directories, so that each directory table is contiguous
+    dirs = [tree]
+    i = 0
+    while i < len(dirs):
+        dirs.extend(v for k, v in sorted(dirs[i].items()) if isinstance(v, dict))
+        i += 1
+
+    # directory tables
+    offset = HEADER.size
+    dir_offsets = {}
+    for d in dirs:
+        dir_offsets[id(d)] = offset
+        offset += COUNT.size + ENTRY.size * len(d)
+
+    # names
+    names = bytearray()
+    name_offsets = {}
+    for d in dirs:
+        for name in d:
+            if name not in name_offsets:
+                name_offsets[name] = offset + len(names)
+                names += name + b"\0"
+    offset += len(names)
+
+    # file data
+    data = bytearray()
+    file_offsets = {}
+    data_start = align(offset, alignment)
+    for d in dirs:
+        for name, value in sorted(d.items()):
+            if not isinstance(value, dict):
+                data += b"\0" * (align(len(data), alignment) - len(data))
+                file_offsets[id(d), name] = data_start + len(data)
+                data += value
+
+    image = bytearray(HEADER.pack(ROMFS_MAGIC, ROMFS_VERSION, 0, dir_offsets[id(tree)]))
+    for d in dirs:
+        image += COUNT.pack(len(d))
+        for name, value in sorted(d.items()):
+            if isinstance(value, dict):
+                image += ENTRY.pack(name_offsets[name], ROMFS_TYPE_DIR, dir_offsets[id(value)], len(value))
+            else:
+                image += ENTRY.pack(name_offsets[name], ROMFS_TYPE_FILE, file_offsets[id(d), name], len(value))
+    image += names
+    image += b"\0" * (data_start - len(image))
+    image += data
+    image[8:12] = struct.pack("<I", len(image))
+    return bytes(image)
+
+
+def parse(image, offset=None):
+    """
+    reads a directory back out of an image, returns the same structure as scan().
+    """
+    magic, version, size, root = HEADER.unpack_from(image, 0)
+    if magic != ROMFS_MAGIC or version != ROMFS_VERSION or size != len(image):
+        raise ValueError("bad image header")
+    if offset is None:
+        offset = root
+
+    count, = COUNT.unpack_from(image, offset)
+    tree = {}
+    previous = None
+    for i in range(count):
+        name_offset, kind, data, length = ENTRY.unpack_from(image, offset + COUNT.size + i * ENTRY.size)
+        name = image[name_offset:image.index(b"\0", name_offset)]
+        if previous is not None and name <= previous:
+            raise ValueError("directory table not sorted at %r" % name)
+        previous = name
+        if kind == ROMFS_TYPE_DIR:
+            tree[name] = parse(image, data)
+            if len(tree[name]) != length:
+                raise ValueError("bad entry count for %r" % name)
+        elif kind == ROMFS_TYPE_FILE:
+            tree[name] = image[data:data + length]
+        else:
+            raise ValueError("bad entry type for %r" % name)
+    return tree
+
+
+def write_source(image, path, alignment):
+    with open(path, "w") as f:
+        f.write("/* generated by tools/mkromfs.py, do not edit */\n\n")
+        f.write("const unsigned char romfs_image[%d] __attribute__((aligned(%d))) = {\n" % (len(image), max(alignment, 4)))
+        for i in range(0, len(image), 16):
+            f.write("    " + ", ".join("0x%02x" % b for b in image[i:i + 16]) + ",\n")
+        f.write("};\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="pack a directory tree into a like-posix romfs image")
+    parser.add_argument("root", help="directory to pack, base_fs for example")
+    parser.add_argument("output", help="C source file to write")
+    parser.add_argument("--align", type=int, default=4, help="file data alignment in bytes, a power of 2 of at least 4")
+    parser.add_argument("--binary", help="also write the raw image to this file")
+    parser.add_argument("--verify", action="store_true", help="read the image back and compare it with the source tree")
+    args = parser.parse_args()
+
+    if args.align < 4 or args.align & (args.align - 1):
+        parser.error("--align must be a power of 2 of at least 4")
+
+    tree = scan(args.root)
+    image = build(tree, args.align)
+
+    if args.verify and parse(image) != tree:
+        sys.exit("image does not match %s" % args.root)
+
+    write_source(image, args.output, args.align)
+    if args.binary:
+        with open(args.binary, "wb") as f:
+            f.write(image)
+
+    print("%s: %d bytes" % (args.output, len(image)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2015 Michael Stuart.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the like-posix project, <https://github.com/drmetal/like-posix>
+ *
+ * Author: Michael Stuart <spaceorbot@gmail.com>
+ *
+ */
+
+/**
+ * @addtogroup syscalls
+ *
+ * Interface between the system calls and the filesystem/descriptor backends.
+ *
+ * A backend that serves a part of the directory tree provides a vfs_fs_t, and is
+ * mounted with vfs_mount(). open() resolves the path to the mount with the longest
+ * matching prefix, once, and the mount's open function populates the file table entry,
+ * setting fte->ops. From then on read(), write(), lseek() etc make a single indirect
+ * call through fte->ops. Backends that are not path based, such as sockets, just set
+ * fte->ops when they create the entry.
+ *
+ * All ops are called with the file table locked. An op that is NULL is not supported
+ * by the backend, and the system call returns -1. The exception is read() and write() on
+ * sockets, which like the other socket calls translate the descriptor without the lock
+ * and call into lwIP directly, so that a task blocked on a socket doesn't hold up the rest.
+ *
+ * select() and poll() check descriptors with the poll op, and sleep until vfs_notify() is
+ * called. A backend whose descriptors become ready asynchronously calls vfs_notify_entry()
+ * when that happens, which also queues the descriptor's epoll registrations. Device drivers
+ * call vfs_notify_device_from_isr().
+ *
+ * @file vfs.h
+ * @{
+ */
+
+#ifndef LIKE_POSIX_VFS_H_
+#define LIKE_POSIX_VFS_H_
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include "syscalls.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/**
+ * the maximum number of mounted backends, including the FatFs root and /dev.
+ */
+#ifndef VFS_MOUNT_TABLE_LENGTH
+#define VFS_MOUNT_TABLE_LENGTH          4
+#endif
+
+/**
+ * the longest select() and poll() sleep between descriptor checks, in milliseconds, when
+ * the descriptors include sockets and ENABLE_LIKEPOSIX_SOCKET_EVENTS is not set.
+ */
+#ifndef VFS_POLL_INTERVAL
+#define VFS_POLL_INTERVAL               10
+#endif
+/**
+ * the task notification index select(), poll() and epoll_wait() sleep on, with FreeRTOS 10.4 or
+ * later and configTASK_NOTIFICATION_ARRAY_ENTRIES above 1. by default the last one, as index 0
+ * is the one xTaskNotifyGive(), ulTaskNotifyTake() and stream buffers use. with a single
+ * notification value, or set to -1, each wait sleeps on a binary semaphore of its own instead.
+ */
+#ifndef VFS_NOTIFY_INDEX
+#if defined(configTASK_NOTIFICATION_ARRAY_ENTRIES) && configTASK_NOTIFICATION_ARRAY_ENTRIES > 1
+#define VFS_NOTIFY_INDEX                (configTASK_NOTIFICATION_ARRAY_ENTRIES - 1)
+#else
+#define VFS_NOTIFY_INDEX                -1
+#endif
+#endif
+/**
+ * wake select() and poll() on lwIP socket events, rather than checking sockets every
+ * VFS_POLL_INTERVAL milliseconds. requires lwIP 2.1 or later.
+ */
+#ifndef ENABLE_LIKEPOSIX_SOCKET_EVENTS
+#define ENABLE_LIKEPOSIX_SOCKET_EVENTS  0
+#endif
+
+/**
+ * reserve file table entries, in listen(), for the connections accepted on listening sockets.
+ */
+#ifndef ENABLE_LIKEPOSIX_ACCEPT_SLOTS
+#define ENABLE_LIKEPOSIX_ACCEPT_SLOTS   0
+#endif
+/**
+ * the most entries listen() reserves for a listening socket, whatever its backlog.
+ */
+#ifndef ACCEPT_SLOTS_MAX
+#define ACCEPT_SLOTS_MAX                8
+#endif
+
+/**
+ * enable epoll_create(), epoll_ctl() and epoll_wait().
+ */
+#ifndef ENABLE_LIKEPOSIX_EPOLL
+#define ENABLE_LIKEPOSIX_EPOLL          0
+#endif
+/**
+ * the number of descriptors that may be registered with epoll instances, in the static configuration.
+ */
+#ifndef EPOLL_WATCH_TABLE_LENGTH
+#define EPOLL_WATCH_TABLE_LENGTH        FILE_TABLE_LENGTH
+#endif
+
+/**
+ * readiness flags returned by vfs_ops_t.poll, the same values as POLLIN, POLLOUT and POLLERR.
+ */
+#define VFS_POLLIN      0x0001      ///< data may be read without blocking
+#define VFS_POLLOUT     0x0004      ///< data may be written without blocking
+#define VFS_POLLERR     0x0008      ///< an error is pending
+
+typedef struct _filtab_entry_t filtab_entry_t;
+typedef struct _dir_entry_t dir_entry_t;
+typedef struct _epoll_watch_t epoll_watch_t;
+
+/**
+ * descriptor operations, one table per backend.
+ */
+typedef struct {
+    int (*read)(filtab_entry_t* fte, char* buffer, int count);          ///< returns the number of bytes read, or -1 on error
+    int (*write)(filtab_entry_t* fte, const char* buffer, int count);   ///< returns the number of bytes written, or -1 on error
+    int (*lseek)(filtab_entry_t* fte, int offset, int whence);          ///< returns the new position, or -1 on error
+    int (*fstat)(filtab_entry_t* fte, struct stat* st);                 ///< fills in st_size, st_mode is set from fte->mode
+    int (*fsync)(filtab_entry_t* fte);                                  ///< returns 0 on success, or -1 on error
+    int (*close)(filtab_entry_t* fte);                                  ///< releases the backend resources, not the entry itself
+    int (*poll)(filtab_entry_t* fte);                                   ///< returns a combination of VFS_POLLIN, VFS_POLLOUT, VFS_POLLERR
+} vfs_ops_t;
+
+/**
+ * filesystem operations, one per mounted backend.
+ */
+typedef struct {
+    const char* prefix;                                                 ///< path prefix the backend is mounted at, "/tmp/" for example
+    size_t entry_size;                                                  ///< the size of the file table entries open() populates, see filtab_entry_t
+    size_t (*entry_size_of)(const char* path, int flags);              ///< optional, the entry size for one open when it may be smaller than entry_size, flags as open gets them
+    int (*open)(filtab_entry_t* fte, const char* path, int flags, int length);  ///< populates fte, returns 0 on success, or -1 on error
+    int (*stat)(const char* path, struct stat* st);
+    int (*unlink)(const char* path);
+    int (*rename)(const char* oldpath, const char* newpath);
+    int (*mkdir)(const char* path);
+    int (*opendir)(dir_entry_t* dir, const char* path);
+    int (*readdir)(dir_entry_t* dir, struct dirent* ent);               ///< returns 0 if ent was populated, -1 at the end of the directory
+    int (*closedir)(dir_entry_t* dir);
+} vfs_fs_t;
+
+/**
+ * filetable entry definition, the header common to all descriptor types.
+ *
+ * a backend that needs more state per descriptor than ctx holds declares its own entry
+ * type, with a filtab_entry_t as its first member, and sets vfs_fs_t.entry_size to its size.
+ * open() then allocates entries of that size, zeroed, so that a FatFs FIL for example
+ * is only paid for by FatFs descriptors, not by every socket and device.
+ */
+struct _filtab_entry_t {
+    const vfs_ops_t* ops;   ///< descriptor operations, set by the backend
+    int mode;               ///< the type of the descriptor, S_IFREG, S_IFIFO, S_IFSOCK...
+    int flags;              ///< the flags the descriptor was opened with, the access mode converted to FREAD/FWRITE
+    void* ctx;              ///< backend private data, the device for S_IFIFO, the lwIP socket for S_IFSOCK
+#if ENABLE_LIKEPOSIX_EPOLL
+    epoll_watch_t* watches; ///< the epoll registrations on the descriptor
+#endif
+};
+
+/**
+ * directory definition, returned to the user as a DIR.
+ */
+struct _dir_entry_t {
+    DIR dir;                ///< FatFs directory, must be the first member
+    const vfs_fs_t* fs;     ///< the backend the directory belongs to
+    int index;              ///< position in the directory, for backends other than FatFs
+    void* ctx;              ///< backend private data
+};
+
+int vfs_mount(const vfs_fs_t* fs);
+#if USE_FREERTOS
+void vfs_notify();
+void vfs_notify_from_isr(BaseType_t* woken);
+void vfs_notify_entry(filtab_entry_t* fte);
+void vfs_notify_device_from_isr(dev_ioctl_t* device, BaseType_t* woken);
+#endif
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* LIKE_POSIX_VFS_H_ */
+
+/**
+ * @}
+ */